@@ -47,6 +47,7 @@ class FileHeader:
     version: int
     msg_size: int
     timestamp_start: int
+    data_offset: int
     
     def is_valid(self) -> bool:
         return (self.magic == HEADER_MAGIC and 
@@ -90,8 +91,11 @@ def read_header(f) -> Optional[FileHeader]:
         magic=unpacked[0],
         version=unpacked[1],
         msg_size=unpacked[2],
-        timestamp_start=unpacked[3]
+        timestamp_start=unpacked[3],
+        data_offset=unpacked[4] or HEADER_SIZE
     )
+    # O_DIRECT segments pad the header out to a full block.
+    f.seek(header.data_offset)
     return header
 
 
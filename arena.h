@@ -0,0 +1,260 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+// Backing memory for the engine's large tables (order pool, ladders, id
+// indexes). Each block is its own anonymous mapping, so it starts out
+// kernel-zeroed and is only faulted in when first touched: tables whose
+// empty state is all zero bytes need no constructor pass, and untouched
+// capacity costs address space only. Blocks of 2 MB or more ask for
+// explicit huge pages (MAP_HUGETLB, which needs pages reserved in
+// /proc/sys/vm/nr_hugepages) and fall back to transparent huge pages.
+constexpr size_t ARENA_PAGE_SIZE = 4096;
+constexpr size_t ARENA_HUGE_PAGE_SIZE = 2u << 20;
+
+// numa_node >= 0 makes the node the preferred home of every page (mbind
+// MPOL_PREFERRED, so a full node still falls back); -1 leaves placement to
+// first touch.
+struct ArenaConfig {
+    int numa_node = -1;
+    bool huge_pages = true;
+};
+
+struct ArenaRange {
+    void* addr;
+    size_t size;
+    bool hugetlb;
+};
+
+struct ArenaUsage {
+    size_t mapped_bytes = 0;
+    size_t hugetlb_bytes = 0;
+};
+
+inline ArenaUsage summarize_ranges(const std::vector<ArenaRange>& ranges) {
+    ArenaUsage usage;
+    for (const ArenaRange& range : ranges) {
+        usage.mapped_bytes += range.size;
+        if (range.hugetlb) usage.hugetlb_bytes += range.size;
+    }
+    return usage;
+}
+
+// NUMA node of a CPU from sysfs, or -1 (core < 0, no NUMA, not Linux).
+inline int numa_node_of_core(int core) {
+#ifdef __linux__
+    if (core < 0) return -1;
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", core);
+    DIR* dir = ::opendir(path);
+    if (dir == nullptr) return -1;
+    int node = -1;
+    while (dirent* entry = ::readdir(dir)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+            std::sscanf(entry->d_name + 4, "%d", &node) == 1) {
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+#else
+    (void)core;
+    return -1;
+#endif
+}
+
+// Raw mbind so the engine does not link libnuma.
+inline bool arena_bind_node(void* addr, size_t size, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int MPOL_PREFERRED_MODE = 1;
+    constexpr size_t MASK_BITS = 1024;
+    if (node < 0 || static_cast<size_t>(node) >= MASK_BITS) return false;
+    unsigned long mask[MASK_BITS / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    return ::syscall(SYS_mbind, addr, size, MPOL_PREFERRED_MODE, mask, MASK_BITS + 1, 0) == 0;
+#else
+    (void)addr; (void)size; (void)node;
+    return false;
+#endif
+}
+
+// One anonymous mapping; unmapped on destruction. Move-only.
+class ArenaBlock {
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+    bool hugetlb_ = false;
+
+public:
+    ArenaBlock() = default;
+
+    ArenaBlock(size_t bytes, const ArenaConfig& config) {
+        bool huge = config.huge_pages && bytes >= ARENA_HUGE_PAGE_SIZE;
+        size_t page = huge ? ARENA_HUGE_PAGE_SIZE : ARENA_PAGE_SIZE;
+        size_ = (std::max<size_t>(bytes, 1) + page - 1) & ~(page - 1);
+
+        void* addr = MAP_FAILED;
+        if (huge) {
+            addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            hugetlb_ = addr != MAP_FAILED;
+        }
+        if (addr == MAP_FAILED) {
+            addr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED) throw std::bad_alloc();
+            if (huge) ::madvise(addr, size_, MADV_HUGEPAGE);
+        }
+        addr_ = addr;
+        if (config.numa_node >= 0) arena_bind_node(addr_, size_, config.numa_node);
+    }
+
+    ArenaBlock(ArenaBlock&& other) noexcept
+        : addr_(std::exchange(other.addr_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          hugetlb_(other.hugetlb_) {}
+
+    ArenaBlock& operator=(ArenaBlock&& other) noexcept {
+        if (this != &other) {
+            release();
+            addr_ = std::exchange(other.addr_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            hugetlb_ = other.hugetlb_;
+        }
+        return *this;
+    }
+
+    ArenaBlock(const ArenaBlock&) = delete;
+    ArenaBlock& operator=(const ArenaBlock&) = delete;
+
+    ~ArenaBlock() { release(); }
+
+    void release() {
+        if (addr_ != nullptr) ::munmap(addr_, size_);
+        addr_ = nullptr;
+        size_ = 0;
+    }
+
+    void* data() const { return addr_; }
+    size_t size() const { return size_; }
+    bool hugetlb() const { return hugetlb_; }
+    ArenaRange range() const { return ArenaRange{addr_, size_, hugetlb_}; }
+};
+
+// Fixed-count array in one block. Types whose empty state is all zero
+// bytes are used as the kernel hands them over; anything else is default
+// constructed once. resize() only grows, moving the contents to a larger
+// block, and the new tail is zero.
+template<typename T>
+class ArenaArray {
+    static_assert(std::is_trivially_destructible_v<T>, "Arena memory is unmapped without destructors");
+
+    ArenaBlock block_;
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    ArenaConfig config_;
+
+public:
+    ArenaArray() = default;
+
+    ArenaArray(size_t count, const ArenaConfig& config = {})
+        : block_(count * sizeof(T), config),
+          data_(static_cast<T*>(block_.data())),
+          size_(count),
+          config_(config) {
+        if constexpr (!std::is_trivially_default_constructible_v<T>) {
+            std::uninitialized_default_construct_n(data_, count);
+        }
+    }
+
+    ArenaArray(ArenaArray&& other) noexcept
+        : block_(std::move(other.block_)),
+          data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          config_(other.config_) {}
+
+    ArenaArray& operator=(ArenaArray&& other) noexcept {
+        block_ = std::move(other.block_);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        config_ = other.config_;
+        return *this;
+    }
+
+    void resize(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_default_constructible_v<T>,
+                      "Only zero-initialised trivial types can grow");
+        if (count <= size_) return;
+        ArenaBlock bigger(count * sizeof(T), config_);
+        if (size_ > 0) std::memcpy(bigger.data(), data_, size_ * sizeof(T));
+        block_ = std::move(bigger);
+        data_ = static_cast<T*>(block_.data());
+        size_ = count;
+    }
+
+    inline T& operator[](size_t i) { return data_[i]; }
+    inline const T& operator[](size_t i) const { return data_[i]; }
+    inline T* get() { return data_; }
+    inline const T* get() const { return data_; }
+    inline size_t size() const { return size_; }
+    ArenaRange range() const { return block_.range(); }
+};
+
+// Faults ranges in on a background thread with MADV_POPULATE_WRITE
+// (Linux 5.14+), a chunk at a time so the destructor can stop it early.
+// Populating never changes page contents, so it may overlap with the
+// owner writing the same memory; a range unmapped meanwhile just fails.
+class ArenaPrefaulter {
+    static constexpr size_t CHUNK = 32u << 20;
+
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> done_{false};
+    std::atomic<size_t> populated_{0};
+
+public:
+    explicit ArenaPrefaulter(std::vector<ArenaRange> ranges) {
+        thread_ = std::thread([this, ranges = std::move(ranges)]() {
+            for (const ArenaRange& range : ranges) {
+                auto* base = static_cast<uint8_t*>(range.addr);
+                for (size_t off = 0; off < range.size; off += CHUNK) {
+                    if (stop_.load(std::memory_order_relaxed)) break;
+                    size_t len = std::min(CHUNK, range.size - off);
+                    if (::madvise(base + off, len, MADV_POPULATE_WRITE) != 0) break;
+                    populated_.fetch_add(len, std::memory_order_relaxed);
+                }
+            }
+            done_.store(true, std::memory_order_release);
+        });
+    }
+
+    ~ArenaPrefaulter() {
+        stop_.store(true, std::memory_order_relaxed);
+        if (thread_.joinable()) thread_.join();
+    }
+
+    ArenaPrefaulter(const ArenaPrefaulter&) = delete;
+    ArenaPrefaulter& operator=(const ArenaPrefaulter&) = delete;
+
+    bool done() const { return done_.load(std::memory_order_acquire); }
+    size_t populated_bytes() const { return populated_.load(std::memory_order_relaxed); }
+};
+
+#endif
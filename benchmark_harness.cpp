@@ -1,17 +1,31 @@
 
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
 #include <cstring>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
-#include <numeric>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "order_book.h"
+#include "sharded_engine.h"
+#include "replay_reader.h"
+#include "latency_histogram.h"
+#include "workload_generator.h"
+#include "thread_utils.h"
+
+// Matching cost only: no lock, no output ring, no cross diagnostic.
+using BenchBook = BasicOrderBook<BenchmarkBookPolicy>;
+
+struct SplitBenchmarkPolicy : BenchmarkBookPolicy {
+    static constexpr bool SPLIT_ORDERS = true;
+};
+using SplitBenchBook = BasicOrderBook<SplitBenchmarkPolicy>;
 
 #if defined(__x86_64__) || defined(_M_X64)
 #include <x86intrin.h>
@@ -45,6 +59,16 @@ double calibrate_tsc_frequency() { return 1.0; }
 #define USE_RDTSC 0
 #endif
 
+// Benchmark clock: TSC cycles with RDTSCP, nanoseconds otherwise (tsc_freq = 1).
+inline uint64_t read_clock() {
+#if USE_RDTSC
+    return rdtscp();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
 struct LatencyStats {
     double min_ns, max_ns, mean_ns, median_ns;
     double p90_ns, p95_ns, p99_ns, p99_9_ns, p99_99_ns;
@@ -77,93 +101,102 @@ struct LatencyStats {
     }
 };
 
-LatencyStats calculate_stats(std::vector<double>& latencies, double total_ns) {
+LatencyStats stats_from_histogram(const LatencyHistogram& h, double total_ns) {
     LatencyStats s{};
-    s.sample_count = latencies.size();
-    if (latencies.empty()) return s;
-    
-    std::sort(latencies.begin(), latencies.end());
-    size_t n = latencies.size();
-    
-    s.min_ns = latencies.front();
-    s.max_ns = latencies.back();
-    s.mean_ns = std::accumulate(latencies.begin(), latencies.end(), 0.0) / n;
-    
-    auto pct = [&](double p) {
-        double idx = (p / 100.0) * (n - 1);
-        size_t lo = static_cast<size_t>(idx);
-        size_t hi = std::min(lo + 1, n - 1);
-        double f = idx - lo;
-        return latencies[lo] * (1 - f) + latencies[hi] * f;
-    };
-    
-    s.median_ns = pct(50);
-    s.p90_ns = pct(90);
-    s.p95_ns = pct(95);
-    s.p99_ns = pct(99);
-    s.p99_9_ns = pct(99.9);
-    s.p99_99_ns = pct(99.99);
-    
-    double sq_sum = 0;
-    for (double lat : latencies) sq_sum += (lat - s.mean_ns) * (lat - s.mean_ns);
-    s.std_dev_ns = std::sqrt(sq_sum / n);
-    s.throughput_ops = (n / total_ns) * 1e9;
+    s.sample_count = h.count();
+    if (s.sample_count == 0) return s;
+    
+    s.min_ns = static_cast<double>(h.min());
+    s.max_ns = static_cast<double>(h.max());
+    s.mean_ns = h.mean();
+    s.median_ns = static_cast<double>(h.percentile(50));
+    s.p90_ns = static_cast<double>(h.percentile(90));
+    s.p95_ns = static_cast<double>(h.percentile(95));
+    s.p99_ns = static_cast<double>(h.percentile(99));
+    s.p99_9_ns = static_cast<double>(h.percentile(99.9));
+    s.p99_99_ns = static_cast<double>(h.percentile(99.99));
+    s.std_dev_ns = h.std_dev();
+    s.throughput_ops = (s.sample_count / total_ns) * 1e9;
     return s;
 }
 
-struct MessageBuffer {
-    std::vector<uint8_t> data;
-    MsgType type;
-    uint64_t timestamp;
-};
+inline const char* msg_type_name(MsgType type) {
+    switch (type) {
+        case MsgType::ADD_ORDER:       return "ADD_ORDER";
+        case MsgType::ADD_ICEBERG:     return "ADD_ICEBERG";
+        case MsgType::ADD_AON:         return "ADD_AON";
+        case MsgType::CANCEL_ORDER:    return "CANCEL_ORDER";
+        case MsgType::MODIFY_ORDER:    return "MODIFY_ORDER";
+        case MsgType::EXECUTE:         return "EXECUTE";
+        case MsgType::ADD_STOP:        return "ADD_STOP";
+        case MsgType::ADD_STOP_MARKET: return "ADD_STOP_MARKET";
+        case MsgType::HEARTBEAT:       return "HEARTBEAT";
+        case MsgType::RESET:           return "RESET";
+        case MsgType::SNAPSHOT_REQ:    return "SNAPSHOT_REQ";
+        case MsgType::MASS_CANCEL:     return "MASS_CANCEL";
+    }
+    return "OTHER";
+}
 
-std::vector<MessageBuffer> load_binary_file(const std::string& filename) {
-    std::vector<MessageBuffer> messages;
-    
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file) {
-        std::cerr << "Error: Cannot open file: " << filename << "\n";
-        return messages;
+// One histogram per message type, looked up by the MsgType byte so the
+// measured loop does a single indexed load per message.
+class TypeHistograms {
+    std::array<LatencyHistogram*, 256> by_type_{};
+    std::vector<LatencyHistogram> storage_;
+    std::vector<MsgType> types_;
+
+public:
+    TypeHistograms() {
+        types_ = {MsgType::ADD_ORDER, MsgType::ADD_ICEBERG, MsgType::ADD_AON,
+                  MsgType::CANCEL_ORDER, MsgType::MODIFY_ORDER, MsgType::EXECUTE,
+                  MsgType::ADD_STOP, MsgType::ADD_STOP_MARKET, MsgType::MASS_CANCEL};
+        storage_.resize(types_.size() + 1);
+        by_type_.fill(&storage_.back());
+        for (size_t i = 0; i < types_.size(); ++i) {
+            by_type_[static_cast<uint8_t>(types_[i])] = &storage_[i];
+        }
     }
-    
-    size_t file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    std::cout << "Loading " << filename << " (" << file_size << " bytes)...\n";
 
-    std::vector<uint8_t> file_data(file_size);
-    file.read(reinterpret_cast<char*>(file_data.data()), file_size);
-    file.close();
-    
-    size_t offset = 0;
-    size_t msg_count = 0;
-    
-    while (offset + sizeof(MsgHeader) <= file_size) {
-        const MsgHeader* header = reinterpret_cast<const MsgHeader*>(file_data.data() + offset);
-        
-        uint16_t msg_len = header->length;
-        if (msg_len == 0 || offset + msg_len > file_size) {
-            std::cerr << "Warning: Invalid message length at offset " << offset << "\n";
-            break;
+    LatencyHistogram& operator[](MsgType type) { return *by_type_[static_cast<uint8_t>(type)]; }
+
+    void print(const std::string& title) const {
+        auto row = [](const std::string& text) {
+            std::cout << "║ " << std::left << std::setw(64) << text << " ║\n";
+        };
+        char line[96];
+        std::cout << "\n╔══════════════════════════════════════════════════════════════════╗\n";
+        row(title);
+        std::cout << "╠══════════════════════════════════════════════════════════════════╣\n";
+        std::snprintf(line, sizeof(line), "%-16s %10s %8s %8s %8s %9s",
+                      "Type", "Count", "P50", "P99", "P99.9", "Max");
+        row(line);
+        for (size_t i = 0; i <= types_.size(); ++i) {
+            const LatencyHistogram& h = storage_[i];
+            if (h.count() == 0) continue;
+            std::snprintf(line, sizeof(line), "%-16s %10llu %8llu %8llu %8llu %9llu",
+                          i < types_.size() ? msg_type_name(types_[i]) : "OTHER",
+                          static_cast<unsigned long long>(h.count()),
+                          static_cast<unsigned long long>(h.percentile(50)),
+                          static_cast<unsigned long long>(h.percentile(99)),
+                          static_cast<unsigned long long>(h.percentile(99.9)),
+                          static_cast<unsigned long long>(h.max()));
+            row(line);
         }
-        
-        MessageBuffer msg;
-        msg.data.resize(msg_len);
-        std::memcpy(msg.data.data(), file_data.data() + offset, msg_len);
-        msg.type = header->type;
-        msg.timestamp = header->timestamp;
-        
-        messages.push_back(std::move(msg));
-        offset += msg_len;
-        msg_count++;
+        std::cout << "╚══════════════════════════════════════════════════════════════════╝\n";
     }
-    
-    std::cout << "Loaded " << msg_count << " messages\n";
-    
-    size_t add_count = 0, cancel_count = 0, modify_count = 0, execute_count = 0, other_count = 0;
-    for (const auto& msg : messages) {
-        switch (msg.type) {
+};
+
+template<typename Capture>
+void print_message_distribution(const Capture& capture) {
+    std::cout << "Loaded " << capture.message_count() << " messages\n";
+    
+    size_t add_count = 0, iceberg_count = 0, aon_count = 0, cancel_count = 0;
+    size_t modify_count = 0, execute_count = 0, other_count = 0;
+    for (size_t i = 0; i < capture.message_count(); ++i) {
+        switch (capture.message(i)->type) {
             case MsgType::ADD_ORDER: add_count++; break;
+            case MsgType::ADD_ICEBERG: iceberg_count++; break;
+            case MsgType::ADD_AON: aon_count++; break;
             case MsgType::CANCEL_ORDER: cancel_count++; break;
             case MsgType::MODIFY_ORDER: modify_count++; break;
             case MsgType::EXECUTE: execute_count++; break;
@@ -173,42 +206,66 @@ std::vector<MessageBuffer> load_binary_file(const std::string& filename) {
     
     std::cout << "Message distribution:\n";
     std::cout << "  ADD_ORDER:    " << add_count << "\n";
+    if (iceberg_count) std::cout << "  ADD_ICEBERG:  " << iceberg_count << "\n";
+    if (aon_count) std::cout << "  ADD_AON:      " << aon_count << "\n";
     std::cout << "  CANCEL_ORDER: " << cancel_count << "\n";
     std::cout << "  MODIFY_ORDER: " << modify_count << "\n";
     std::cout << "  EXECUTE:      " << execute_count << "\n";
     std::cout << "  Other:        " << other_count << "\n";
-    
-    return messages;
 }
 
-inline void process_message(OptimizedOrderBook& book, const MessageBuffer& msg) {
-    switch (msg.type) {
+template<typename Book>
+inline void process_message(Book& book, const MsgHeader* msg) {
+    switch (msg->type) {
         case MsgType::ADD_ORDER: {
-            const MsgAddOrder* m = reinterpret_cast<const MsgAddOrder*>(msg.data.data());
+            const MsgAddOrder* m = msg_cast<MsgAddOrder>(msg);
             book.add_order_no_lock(m->order_id, m->side == Side::BUY, m->price, m->quantity, 
                                    static_cast<uint32_t>(m->user_id));
             break;
         }
         case MsgType::CANCEL_ORDER: {
-            const MsgCancel* m = reinterpret_cast<const MsgCancel*>(msg.data.data());
+            const MsgCancel* m = msg_cast<MsgCancel>(msg);
             book.cancel_order_no_lock(m->order_id);
             break;
         }
         case MsgType::MODIFY_ORDER: {
-            const MsgModify* m = reinterpret_cast<const MsgModify*>(msg.data.data());
-            book.cancel_order_no_lock(m->order_id);
+            const MsgModify* m = msg_cast<MsgModify>(msg);
+            book.modify_order_no_lock(m->order_id, m->new_price, m->new_quantity);
             break;
         }
         case MsgType::EXECUTE: {
-            const MsgExecute* m = reinterpret_cast<const MsgExecute*>(msg.data.data());
-            book.add_order_no_lock(m->order_id, m->side == Side::BUY, m->price, m->quantity,
-                                   static_cast<uint32_t>(m->user_id));
+            const MsgExecute* m = msg_cast<MsgExecute>(msg);
+            book.match_order_no_lock(m->order_id, m->side == Side::BUY, m->price, m->quantity,
+                                     tif_from_protocol(m->time_in_force),
+                                     static_cast<uint32_t>(m->user_id));
             break;
         }
         case MsgType::ADD_ICEBERG: {
-            const MsgAddIceberg* m = reinterpret_cast<const MsgAddIceberg*>(msg.data.data());
-            book.add_order_no_lock(m->order_id, m->side == Side::BUY, m->price, 
-                                   m->total_quantity, static_cast<uint32_t>(m->user_id));
+            const MsgAddIceberg* m = msg_cast<MsgAddIceberg>(msg);
+            book.add_iceberg_order_no_lock(m->order_id, m->side == Side::BUY, m->price, 
+                                           m->total_quantity, m->visible_quantity,
+                                           static_cast<uint32_t>(m->user_id));
+            break;
+        }
+        case MsgType::ADD_AON: {
+            const MsgAddAON* m = msg_cast<MsgAddAON>(msg);
+            book.match_order_no_lock(m->order_id, m->side == Side::BUY, m->price, m->quantity,
+                                     TimeInForce::AON, static_cast<uint32_t>(m->user_id));
+            break;
+        }
+        case MsgType::ADD_STOP:
+        case MsgType::ADD_STOP_MARKET: {
+            const MsgAddStop* m = msg_cast<MsgAddStop>(msg);
+            book.add_stop_order_no_lock(m->order_id, m->side == Side::BUY, m->trigger_price,
+                                        m->limit_price, m->quantity,
+                                        msg->type == MsgType::ADD_STOP_MARKET || m->is_market,
+                                        static_cast<uint32_t>(m->user_id));
+            break;
+        }
+        case MsgType::MASS_CANCEL: {
+            const MsgMassCancel* m = msg_cast<MsgMassCancel>(msg);
+            book.mass_cancel_no_lock(static_cast<uint32_t>(m->user_id), m->side,
+                                     m->min_price, m->max_price);
             break;
         }
         default:
@@ -217,88 +274,292 @@ inline void process_message(OptimizedOrderBook& book, const MessageBuffer& msg)
     }
 }
 
-LatencyStats run_latency_benchmark(const std::vector<MessageBuffer>& messages, 
+// Closed loop (rate == 0) issues each message as soon as the previous one
+// returns and records service time. Open loop issues message i at
+// t0 + i/rate and records latency from that intended start, so time spent
+// queued behind a slow message is charged to every message it delayed
+// instead of disappearing (coordinated omission).
+template<typename Book, typename Capture>
+LatencyStats run_latency_benchmark(const Capture& capture, 
                                     double tsc_freq,
+                                    TypeHistograms& per_type,
+                                    double rate = 0.0,
                                     size_t warmup_count = 100000) {
     
-    auto book = std::make_unique<OptimizedOrderBook>(2'000'000);
-    book->use_ring_buffer_output(false);
-    book->set_benchmark_mode(true);
+    auto book = std::make_unique<Book>(2'000'000);
     
-    size_t actual_warmup = std::min(warmup_count, messages.size());
+    size_t total = capture.message_count();
+    size_t actual_warmup = std::min(warmup_count, total);
     size_t bench_start = actual_warmup;
-    size_t bench_count = messages.size() - bench_start;
+    size_t bench_count = total - bench_start;
     
     std::cout << "\nRunning latency benchmark:\n";
     std::cout << "  Warmup messages: " << actual_warmup << "\n";
     std::cout << "  Benchmark messages: " << bench_count << "\n";
+    if (rate > 0) {
+        std::cout << "  Open loop at " << std::fixed << std::setprecision(0) << rate << " msgs/sec\n";
+    }
 
     for (size_t i = 0; i < actual_warmup; ++i) {
-        process_message(*book, messages[i]);
+        process_message(*book, capture.message(i));
     }
     
-    std::vector<double> latencies;
-    latencies.reserve(bench_count);
+    LatencyHistogram overall;
+    LatencyHistogram service;
+    const double ns_per_tick = 1.0 / tsc_freq;
+    const double interval_ticks = rate > 0 ? tsc_freq * 1e9 / rate : 0.0;
     
-#if USE_RDTSC
     cpuid_serialize();
-    uint64_t total_start = rdtscp();
-    
-    for (size_t i = bench_start; i < messages.size(); ++i) {
-        uint64_t start = rdtscp();
-        process_message(*book, messages[i]);
-        uint64_t end = rdtscp();
-        latencies.push_back(static_cast<double>(end - start) / tsc_freq);
-    }
-    
-    uint64_t total_end = rdtscp();
-    double total_ns = static_cast<double>(total_end - total_start) / tsc_freq;
-#else
-    auto total_start = std::chrono::high_resolution_clock::now();
-    
-    for (size_t i = bench_start; i < messages.size(); ++i) {
-        auto start = std::chrono::high_resolution_clock::now();
-        process_message(*book, messages[i]);
-        auto end = std::chrono::high_resolution_clock::now();
-        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    uint64_t total_start = read_clock();
+    
+    for (size_t i = bench_start; i < total; ++i) {
+        const MsgHeader* msg = capture.message(i);
+        uint64_t start = read_clock();
+        uint64_t intended = start;
+        if (interval_ticks > 0) {
+            intended = total_start + static_cast<uint64_t>((i - bench_start) * interval_ticks);
+            while (start < intended) {
+                cpu_relax();
+                start = read_clock();
+            }
+        }
+        process_message(*book, msg);
+        uint64_t end = read_clock();
+        
+        uint64_t latency_ns = static_cast<uint64_t>((end - intended) * ns_per_tick);
+        overall.record(latency_ns);
+        per_type[msg->type].record(latency_ns);
+        if (interval_ticks > 0) service.record(static_cast<uint64_t>((end - start) * ns_per_tick));
     }
     
-    auto total_end = std::chrono::high_resolution_clock::now();
-    double total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(total_end - total_start).count();
-#endif
+    uint64_t total_end = read_clock();
+    double total_ns = static_cast<double>(total_end - total_start) * ns_per_tick;
     
     std::cout << "  Final book state:\n";
     std::cout << "    Active orders: " << book->order_count() << "\n";
     std::cout << "    Bid levels: " << book->bid_levels() << "\n";
     std::cout << "    Ask levels: " << book->ask_levels() << "\n";
     std::cout << "    Trades: " << book->trades_executed() << "\n";
+    if (interval_ticks > 0) {
+        std::cout << "    Service time P50/P99/P99.9: " << service.percentile(50) << " / "
+                  << service.percentile(99) << " / " << service.percentile(99.9) << " ns\n";
+    }
+    
+    return stats_from_histogram(overall, total_ns);
+}
+
+// Later runs replay the capture into the same book after a reset, so
+// they measure warm pools and index rather than first-touch page faults.
+// Returns the best run.
+template<typename Book, typename Capture>
+double run_throughput_benchmark(const Capture& capture, size_t runs = 1) {
+    auto book = std::make_unique<Book>(2'000'000);
+    
+    size_t total = capture.message_count();
+    std::cout << "\nRunning pure throughput benchmark (" << total << " messages";
+    if (runs > 1) std::cout << ", " << runs << " runs";
+    std::cout << ")...\n";
+    
+    double best = 0.0;
+    for (size_t run = 0; run < runs; ++run) {
+        if (run > 0) {
+            auto reset_start = std::chrono::high_resolution_clock::now();
+            book->reset_no_lock();
+            auto reset_end = std::chrono::high_resolution_clock::now();
+            std::cout << "  Reset: " << std::fixed << std::setprecision(3)
+                      << std::chrono::duration<double, std::milli>(reset_end - reset_start).count()
+                      << " ms\n";
+        }
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        for (size_t i = 0; i < total; ++i) {
+            process_message(*book, capture.message(i));
+        }
+        
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        double duration_s = std::chrono::duration<double>(end - start).count();
+        double throughput = total / duration_s;
+        best = std::max(best, throughput);
+        
+        std::cout << "  Time: " << std::fixed << std::setprecision(3) << duration_s << " s\n";
+        std::cout << "  Throughput: " << std::setprecision(0) << throughput << " msgs/sec\n";
+        std::cout << "  Throughput: " << std::setprecision(2) << throughput / 1e6 << " M msgs/sec\n";
+    }
     
-    return calculate_stats(latencies, total_ns);
+    return best;
 }
 
-double run_throughput_benchmark(const std::vector<MessageBuffer>& messages) {
-    auto book = std::make_unique<OptimizedOrderBook>(2'000'000);
-    book->use_ring_buffer_output(false);
-    book->set_benchmark_mode(true);
+template<typename Book, typename Capture>
+int run_benchmarks(const Capture& capture, const std::string& label, double tsc_freq,
+                   double rate, size_t warmup, size_t runs) {
+    print_message_distribution(capture);
+
+    TypeHistograms per_type;
+    auto latency_stats = run_latency_benchmark<Book>(capture, tsc_freq, per_type, rate, warmup);
+    latency_stats.print(label + " - Per-Message Latency");
+    per_type.print(label + " - Latency by Message Type (ns)");
     
-    std::cout << "\nRunning pure throughput benchmark (" << messages.size() << " messages)...\n";
+    double throughput = run_throughput_benchmark<Book>(capture, runs);
     
-    auto start = std::chrono::high_resolution_clock::now();
+    std::cout << "\n═══════════════════════════════════════════════════════════════════\n";
+    std::cout << " SUMMARY\n";
+    std::cout << "═══════════════════════════════════════════════════════════════════\n\n";
     
-    for (const auto& msg : messages) {
-        process_message(*book, msg);
-    }
+    std::cout << "TitanLOB - " << label << " Results\n\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "• Messages processed:   " << capture.message_count() << "\n";
+    std::cout << "• Median Latency (P50): " << latency_stats.median_ns << " ns\n";
+    std::cout << "• P99 Latency:          " << latency_stats.p99_ns << " ns\n";
+    std::cout << "• P99.9 Latency:        " << latency_stats.p99_9_ns << " ns\n";
+    std::cout << std::setprecision(2);
+    std::cout << "• Pure Throughput:      " << throughput / 1e6 << " M msgs/sec\n";
     
+    return 0;
+}
+
+// Replays the capture into a ShardedEngine once per symbol, interleaved,
+// so every book sees the same flow. Shard workers start at core 1; one
+// thread per shard drains its output ring as a publisher would. Timed from
+// the first submit until stop() has drained every shard queue.
+template<typename Capture>
+int run_sharded_benchmark(const Capture& capture, size_t num_shards, size_t num_symbols) {
+    ShardedEngine engine(num_shards, 1);
+    for (size_t s = 0; s < num_symbols; ++s) {
+        engine.add_symbol(static_cast<uint16_t>(s), 2'000'000);
+    }
+
+    const size_t total = capture.message_count();
+    std::cout << "\nRunning sharded throughput benchmark (" << num_shards << " shards, "
+              << num_symbols << " symbols, " << total * num_symbols << " messages)...\n";
+
+    std::atomic<bool> draining{true};
+    std::vector<uint64_t> drained(num_shards, 0);
+    std::vector<std::thread> drainers;
+    for (size_t k = 0; k < num_shards; ++k) {
+        drainers.emplace_back([&engine, &draining, &drained, k] {
+            OutputBuffer& output = engine.shard_output(k);
+            OutputMsg batch[256];
+            uint64_t count = 0;
+            while (true) {
+                size_t n = output.pop_batch(batch, 256);
+                if (n > 0) {
+                    count += n;
+                    continue;
+                }
+                if (!draining.load(std::memory_order_acquire)) {
+                    while ((n = output.pop_batch(batch, 256)) > 0) count += n;
+                    break;
+                }
+                cpu_relax();
+            }
+            drained[k] = count;
+        });
+    }
+
+    engine.start();
+    uint8_t buf[MAX_INPUT_MSG_SIZE];
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < total; ++i) {
+        const MsgHeader* msg = capture.message(i);
+        size_t len = msg->length;
+        std::memcpy(buf, msg, std::min(len, sizeof(buf)));
+        for (size_t s = 0; s < num_symbols; ++s) {
+            reinterpret_cast<MsgHeader*>(buf)->symbol_id = static_cast<uint16_t>(s);
+            engine.submit(buf, len);
+        }
+    }
+    engine.stop();
     auto end = std::chrono::high_resolution_clock::now();
-    
+
+    draining.store(false, std::memory_order_release);
+    for (auto& t : drainers) t.join();
+
+    uint64_t output_total = 0, dropped = 0;
+    for (size_t k = 0; k < num_shards; ++k) {
+        std::cout << "  Shard " << k << ": core " << engine.shard_core(k) << ", "
+                  << engine.shard_symbols(k) << " symbols, "
+                  << engine.shard_messages_processed(k) << " messages, "
+                  << drained[k] << " output\n";
+        output_total += drained[k];
+    }
+    for (size_t s = 0; s < num_symbols; ++s) {
+        dropped += engine.book(static_cast<uint16_t>(s))->messages_dropped();
+    }
+
     double duration_s = std::chrono::duration<double>(end - start).count();
-    double throughput = messages.size() / duration_s;
-    
+    double throughput = engine.messages_processed() / duration_s;
     std::cout << "  Time: " << std::fixed << std::setprecision(3) << duration_s << " s\n";
-    std::cout << "  Throughput: " << std::setprecision(0) << throughput << " msgs/sec\n";
+    std::cout << "  Processed: " << engine.messages_processed() << ", rejected "
+              << engine.messages_rejected() << ", queue-full spins " << engine.queue_full_spins() << "\n";
+    std::cout << "  Output drained: " << output_total << ", dropped " << dropped << "\n";
     std::cout << "  Throughput: " << std::setprecision(2) << throughput / 1e6 << " M msgs/sec\n";
-    
-    return throughput;
+    return 0;
+}
+
+// Order-type invariants the synthetic scenarios depend on, checked on a
+// small hand-built book. Returns the number of failed checks.
+template<typename Book>
+int run_checks() {
+    int failures = 0;
+    auto expect = [&failures](bool ok, const char* what) {
+        std::cout << (ok ? "  PASS  " : "  FAIL  ") << what << "\n";
+        if (!ok) ++failures;
+    };
+    const int64_t px = PRICE_OFFSET + 1000;
+
+    std::cout << "\nRunning order-type checks:\n";
+    {
+        // An AON buy of 100 repriced through a 30-lot ask must not trade.
+        Book book(1024);
+        book.add_order_no_lock(1, false, px + 1, 30, 1);
+        book.match_order_no_lock(2, true, px - 1, 100, TimeInForce::AON, 2);
+        book.modify_order_no_lock(2, px + 1, 100);
+        TopOfBook top = book.top_of_book();
+        expect(top.trades_executed == 0 && top.best_ask_volume == 30,
+               "AON modified through the spread keeps all-or-none");
+    }
+    {
+        // An iceberg (100, peak 10) repriced through a 5-lot bid keeps its peak.
+        Book book(1024);
+        book.add_order_no_lock(1, true, px, 5, 1);
+        book.add_iceberg_order_no_lock(2, false, px + 2, 100, 10, 2);
+        book.modify_order_no_lock(2, px, 100);
+        TopOfBook top = book.top_of_book();
+        expect(top.trades_executed == 1 && top.best_ask == px && top.best_ask_volume == 10,
+               "iceberg modified through the spread rests behind its peak");
+    }
+    {
+        // A marketable iceberg (100, peak 10) rests its remainder behind its peak.
+        Book book(1024);
+        book.add_order_no_lock(1, true, px, 5, 1);
+        book.add_iceberg_order_no_lock(2, false, px, 100, 10, 2);
+        TopOfBook top = book.top_of_book();
+        expect(top.trades_executed == 1 && top.best_ask == px && top.best_ask_volume == 10,
+               "marketable iceberg rests behind its peak");
+    }
+    return failures;
+}
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [capture.dat] [options]\n"
+              << "  --scenario NAME   generate flow instead of replaying: balanced, sweep, iceberg, aon\n"
+              << "  --messages N      generated message count (default 2000000)\n"
+              << "  --seed N          generator seed\n"
+              << "  --cancel F        cancel share of generated messages\n"
+              << "  --modify F        modify share of generated messages\n"
+              << "  --aggress F       marketable IOC share of generated messages\n"
+              << "  --iceberg F       iceberg share of generated adds\n"
+              << "  --aon F           all-or-none share of generated adds\n"
+              << "  --write PATH      save the generated flow as a .dat capture\n"
+              << "  --rate R          open-loop issue rate in msgs/sec (0 = closed loop)\n"
+              << "  --warmup N        messages replayed before measuring (default 100000)\n"
+              << "  --runs N          throughput runs on one book, reset in between (default 1)\n"
+              << "  --layout NAME     order pool layout: packed (default) or split hot/cold\n"
+              << "  --check           run the order-type checks and exit\n"
+              << "  --shards N        replay through a ShardedEngine with N shard workers\n"
+              << "  --symbols K       symbols the flow is replicated over with --shards (default 4 per shard)\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -310,16 +571,98 @@ int main(int argc, char* argv[]) {
 )" << std::endl;
 
     std::string filename = "btc_l3.dat";
-    if (argc > 1) {
-        filename = argv[1];
+    bool synthetic = false;
+    Scenario scenario = Scenario::BALANCED;
+    const char* write_path = nullptr;
+    double rate = 0.0;
+    size_t warmup = 100000;
+    size_t runs = 1;
+    size_t messages = 0;
+    uint64_t seed = 0;
+    bool have_seed = false;
+    double cancel = -1, modify = -1, aggress = -1, iceberg = -1, aon = -1;
+    bool split_layout = false;
+    bool check = false;
+    size_t shards = 0;
+    size_t symbols = 0;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            filename = arg;
+            continue;
+        }
+        if (arg == "--check") {
+            check = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--scenario") {
+            if (!parse_scenario(value, scenario)) {
+                std::cerr << "Unknown scenario: " << value << "\n";
+                return 1;
+            }
+            synthetic = true;
+        } else if (arg == "--messages") {
+            messages = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(value, nullptr, 10);
+            have_seed = true;
+        } else if (arg == "--cancel") {
+            cancel = std::atof(value);
+        } else if (arg == "--modify") {
+            modify = std::atof(value);
+        } else if (arg == "--aggress") {
+            aggress = std::atof(value);
+        } else if (arg == "--iceberg") {
+            iceberg = std::atof(value);
+        } else if (arg == "--aon") {
+            aon = std::atof(value);
+        } else if (arg == "--write") {
+            write_path = value;
+        } else if (arg == "--rate") {
+            rate = std::atof(value);
+        } else if (arg == "--warmup") {
+            warmup = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--runs") {
+            runs = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+        } else if (arg == "--shards") {
+            shards = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--symbols") {
+            symbols = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--layout") {
+            std::string layout = value;
+            if (layout != "packed" && layout != "split") {
+                std::cerr << "Unknown layout: " << layout << "\n";
+                return 1;
+            }
+            split_layout = layout == "split";
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
     }
     
     std::cout << "System Configuration:\n";
-    std::cout << "  Order struct size:    " << sizeof(Order) << " bytes\n";
+    if (split_layout) {
+        std::cout << "  Order layout:         split, " << sizeof(OrderHot) << " B hot + "
+                  << sizeof(OrderCold) << " B cold\n";
+    } else {
+        std::cout << "  Order layout:         packed, " << sizeof(Order) << " B\n";
+    }
     std::cout << "  PriceLevel size:      " << sizeof(PriceLevel) << " bytes\n";
-    std::cout << "  MAX_PRICE_LEVELS:     " << MAX_PRICE_LEVELS << " (~$" << MAX_PRICE_LEVELS/100 << " range in cents)\n";
-    std::cout << "  Price array memory:   " << (sizeof(PriceLevel) * MAX_PRICE_LEVELS * 2 / 1024 / 1024) << " MB (heap allocated)\n";
-    std::cout << "  Bitmap memory:        " << (BITMAP_WORDS * 8 * 2 / 1024 / 1024) << " MB\n";
+    std::cout << "  LADDER_LEVELS:        " << LADDER_LEVELS << " (~$" << LADDER_LEVELS/100 << " window in cents)\n";
+    std::cout << "  Price array memory:   " << (sizeof(PriceLevel) * LADDER_LEVELS * 2 / 1024) << " KB (heap allocated)\n";
+    std::cout << "  Bitmap memory:        " << (sizeof(LevelBitmap) * 2 / 1024) << " KB (3-level summary)\n";
     
 #if USE_RDTSC
     std::cout << "  Timer:                RDTSCP (high precision)\n";
@@ -332,30 +675,57 @@ int main(int argc, char* argv[]) {
 #endif
     
     std::cout << "\n";
-    
-    auto messages = load_binary_file(filename);
-    if (messages.empty()) {
-        std::cerr << "No messages loaded. Exiting.\n";
-        return 1;
+
+    if (shards) {
+        if (symbols == 0) symbols = shards * 4;
+        symbols = std::min<size_t>(symbols, MAX_SYMBOLS);
     }
 
-    auto latency_stats = run_latency_benchmark(messages, tsc_freq);
-    latency_stats.print("BTC L3 Message Replay - Per-Message Latency");
-    
-    double throughput = run_throughput_benchmark(messages);
-    
-    std::cout << "\n═══════════════════════════════════════════════════════════════════\n";
-    std::cout << " SUMMARY\n";
-    std::cout << "═══════════════════════════════════════════════════════════════════\n\n";
+    if (check) {
+        int failures = split_layout ? run_checks<SplitBenchBook>() : run_checks<BenchBook>();
+        if (failures) {
+            std::cout << "\n" << failures << " check(s) failed\n";
+            return 1;
+        }
+        std::cout << "\nAll checks passed\n";
+        return 0;
+    }
     
-    std::cout << "TitanLOB - BTC L3 Data Replay Results\n\n";
-    std::cout << std::fixed << std::setprecision(1);
-    std::cout << "• Messages processed:   " << messages.size() << "\n";
-    std::cout << "• Median Latency (P50): " << latency_stats.median_ns << " ns\n";
-    std::cout << "• P99 Latency:          " << latency_stats.p99_ns << " ns\n";
-    std::cout << "• P99.9 Latency:        " << latency_stats.p99_9_ns << " ns\n";
-    std::cout << std::setprecision(2);
-    std::cout << "• Pure Throughput:      " << throughput / 1e6 << " M msgs/sec\n";
+    if (synthetic) {
+        WorkloadConfig cfg = WorkloadConfig::preset(scenario);
+        if (messages) cfg.message_count = messages;
+        if (have_seed) cfg.seed = seed;
+        if (cancel >= 0) cfg.cancel_ratio = cancel;
+        if (modify >= 0) cfg.modify_ratio = modify;
+        if (aggress >= 0) cfg.aggress_ratio = aggress;
+        if (iceberg >= 0) cfg.iceberg_ratio = iceberg;
+        if (aon >= 0) cfg.aon_ratio = aon;
+        
+        std::cout << "Generating " << cfg.message_count << " messages (scenario "
+                  << scenario_name(scenario) << ", seed " << cfg.seed << ")\n";
+        WorkloadCapture capture = WorkloadGenerator(cfg).generate();
+        if (write_path) {
+            if (capture.write(write_path)) {
+                std::cout << "Wrote " << write_path << " (" << capture.size() << " bytes)\n";
+            } else {
+                std::cerr << "Failed to write " << write_path << "\n";
+            }
+        }
+        if (shards) return run_sharded_benchmark(capture, shards, symbols);
+        std::string label = std::string("Synthetic ") + scenario_name(scenario);
+        return split_layout
+            ? run_benchmarks<SplitBenchBook>(capture, label, tsc_freq, rate, warmup, runs)
+            : run_benchmarks<BenchBook>(capture, label, tsc_freq, rate, warmup, runs);
+    }
     
-    return 0;
+    ReplayReader capture(filename.c_str());
+    std::cout << "Mapped " << filename << " (" << capture.size() << " bytes)\n";
+    if (capture.message_count() == 0) {
+        std::cerr << "No messages loaded. Exiting.\n";
+        return 1;
+    }
+    if (shards) return run_sharded_benchmark(capture, shards, symbols);
+    return split_layout
+        ? run_benchmarks<SplitBenchBook>(capture, "BTC L3 Message Replay", tsc_freq, rate, warmup, runs)
+        : run_benchmarks<BenchBook>(capture, "BTC L3 Message Replay", tsc_freq, rate, warmup, runs);
 }
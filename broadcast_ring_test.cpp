@@ -0,0 +1,178 @@
+// Stress test for BroadcastRing: one producer mixing claim/publish and
+// try_push, three consumers that read every element (one through
+// peek/consume, one deliberately slow), one that leaves a quarter of the
+// way through and one that joins once it has gone. Every consumer checks
+// that it sees a gapless, untorn sequence. Meant to be run under
+// ThreadSanitizer:
+//
+//   g++ -std=c++20 -O1 -g -fsanitize=thread -o broadcast_ring_test broadcast_ring_test.cpp -lpthread
+//   ./broadcast_ring_test [messages]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+#include "thread_utils.h"
+
+struct Item {
+    uint64_t seq;
+    uint64_t check;
+};
+
+// Small enough that the producer wraps constantly and waits on the slow
+// consumer.
+using TestRing = BroadcastRing<Item, 1024, 8>;
+
+struct ConsumerResult {
+    std::string name;
+    uint64_t first = UINT64_MAX;
+    uint64_t last = UINT64_MAX;
+    uint64_t count = 0;
+    uint64_t errors = 0;
+
+    void see(const Item& item) {
+        if (item.check != ~item.seq) ++errors;
+        if (count > 0 && item.seq != last + 1) ++errors;
+        if (count == 0) first = item.seq;
+        last = item.seq;
+        ++count;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    const uint64_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500'000;
+    if (total < 4) {
+        std::cerr << "Need at least 4 messages\n";
+        return 1;
+    }
+
+    auto ring = std::make_unique<TestRing>();
+    std::atomic<bool> leaver_gone{false};
+    std::atomic<bool> late_joined{false};
+
+    const int peek_id = ring->add_consumer();
+    const int batch_id = ring->add_consumer();
+    const int slow_id = ring->add_consumer();
+    const int leaver_id = ring->add_consumer();
+
+    ConsumerResult peek_result{"peek/consume"};
+    ConsumerResult batch_result{"pop_batch"};
+    ConsumerResult slow_result{"slow pop_batch"};
+    ConsumerResult leaver_result{"leaves at 1/4"};
+    ConsumerResult late_result{"joins late"};
+
+    std::thread producer([&] {
+        uint64_t seq = 0;
+        while (seq < total) {
+            if (seq == total / 2) {
+                // Hold here until the late consumer is in, so it is known
+                // to join before the second half is published.
+                while (!late_joined.load(std::memory_order_acquire)) cpu_relax();
+            }
+            if (seq % 3 == 0) {
+                if (!ring->try_push(Item{seq, ~seq})) {
+                    cpu_relax();
+                    continue;
+                }
+                ++seq;
+                continue;
+            }
+            size_t n = 0;
+            uint64_t limit = seq < total / 2 ? total / 2 : total;
+            Item* dst = ring->claim(std::min<uint64_t>(64, limit - seq), n);
+            if (n == 0) {
+                cpu_relax();
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i, ++seq) dst[i] = Item{seq, ~seq};
+            ring->publish(n);
+        }
+    });
+
+    auto read_all = [&](int id, ConsumerResult& result, bool slow) {
+        Item batch[128];
+        while (result.last != total - 1) {
+            size_t n = ring->pop_batch(id, batch, 128);
+            if (n == 0) {
+                cpu_relax();
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i) result.see(batch[i]);
+            if (slow && (result.count & 4095) < n) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    };
+
+    std::vector<std::thread> consumers;
+    consumers.emplace_back([&] {
+        while (peek_result.last != total - 1) {
+            size_t n = 0;
+            const Item* span = ring->peek(peek_id, n);
+            if (n == 0) {
+                cpu_relax();
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i) peek_result.see(span[i]);
+            ring->consume(peek_id, n);
+        }
+    });
+    consumers.emplace_back([&] { read_all(batch_id, batch_result, false); });
+    consumers.emplace_back([&] { read_all(slow_id, slow_result, true); });
+    consumers.emplace_back([&] {
+        Item item;
+        while (leaver_result.count < total / 4) {
+            if (ring->pop_batch(leaver_id, &item, 1) == 0) {
+                cpu_relax();
+                continue;
+            }
+            leaver_result.see(item);
+        }
+        ring->remove_consumer(leaver_id);
+        leaver_gone.store(true, std::memory_order_release);
+    });
+    consumers.emplace_back([&] {
+        // add_consumer must not race remove_consumer.
+        while (!leaver_gone.load(std::memory_order_acquire)) cpu_relax();
+        const int late_id = ring->add_consumer();
+        late_joined.store(true, std::memory_order_release);
+        read_all(late_id, late_result, false);
+    });
+
+    producer.join();
+    for (auto& t : consumers) t.join();
+
+    int failures = 0;
+    auto report = [&failures](const ConsumerResult& r, bool ok) {
+        std::cout << (ok ? "  PASS  " : "  FAIL  ") << r.name << ": " << r.count
+                  << " items [" << r.first << ", " << r.last << "], "
+                  << r.errors << " errors\n";
+        if (!ok) ++failures;
+    };
+    auto complete = [total](const ConsumerResult& r) {
+        return r.errors == 0 && r.first == 0 && r.last == total - 1 && r.count == total;
+    };
+
+    std::cout << "BroadcastRing stress: " << total << " items, ring of "
+              << TestRing::capacity() << "\n";
+    report(peek_result, complete(peek_result));
+    report(batch_result, complete(batch_result));
+    report(slow_result, complete(slow_result));
+    report(leaver_result, leaver_result.errors == 0 && leaver_result.first == 0 &&
+                          leaver_result.count == total / 4);
+    report(late_result, late_result.errors == 0 && late_result.first >= total / 4 &&
+                        late_result.last == total - 1);
+
+    if (failures) {
+        std::cout << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All checks passed\n";
+    return 0;
+}
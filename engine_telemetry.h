@@ -0,0 +1,236 @@
+#ifndef ENGINE_TELEMETRY_H
+#define ENGINE_TELEMETRY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+// Always-on hot-path telemetry for OptimizedOrderBook. The matching thread
+// is the only writer; readers (the dashboard broadcaster) load the same
+// values concurrently and may see a slightly stale but never torn figure.
+// -DDISABLE_TELEMETRY compiles all of it out; -DTELEMETRY_SAMPLE_SHIFT=n
+// times one message in 2^n (default 64).
+
+#ifdef DISABLE_TELEMETRY
+constexpr bool TELEMETRY_ENABLED = false;
+#else
+constexpr bool TELEMETRY_ENABLED = true;
+#endif
+
+#ifndef TELEMETRY_SAMPLE_SHIFT
+#define TELEMETRY_SAMPLE_SHIFT 6
+#endif
+
+// Book operations as seen by the public entry points. ADD_AON and EXECUTE
+// both arrive as MATCH.
+enum class BookOp : uint8_t {
+    ADD,
+    ADD_ICEBERG,
+    CANCEL,
+    MODIFY,
+    MATCH,
+    ADD_STOP,
+    MASS_CANCEL,
+    RESET,
+    COUNT
+};
+
+inline const char* book_op_name(BookOp op) {
+    switch (op) {
+        case BookOp::ADD:         return "add";
+        case BookOp::ADD_ICEBERG: return "add_iceberg";
+        case BookOp::CANCEL:      return "cancel";
+        case BookOp::MODIFY:      return "modify";
+        case BookOp::MATCH:       return "match";
+        case BookOp::ADD_STOP:    return "add_stop";
+        case BookOp::MASS_CANCEL: return "mass_cancel";
+        case BookOp::RESET:       return "reset";
+        case BookOp::COUNT:       break;
+    }
+    return "unknown";
+}
+
+// TSC on x86 (converted by the reader via telemetry_ticks_per_ns), steady
+// clock nanoseconds elsewhere.
+inline uint64_t telemetry_ticks() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Measured the first time it is asked for (about 20 ms); call it once at
+// startup rather than on the first stats frame.
+inline double telemetry_ticks_per_ns() {
+#if defined(__x86_64__) || defined(_M_X64)
+    static const double ratio = [] {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = __rdtsc();
+        while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(20)) {}
+        uint64_t c1 = __rdtsc();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        return static_cast<double>(c1 - c0) / ns;
+    }();
+    return ratio;
+#else
+    return 1.0;
+#endif
+}
+
+// Single-writer counter: a relaxed load and store, no locked RMW.
+class TelemetryCounter {
+    std::atomic<uint64_t> value_{0};
+
+public:
+    inline void add(uint64_t n = 1) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    inline void set(uint64_t v) { value_.store(v, std::memory_order_relaxed); }
+    inline void raise_to(uint64_t v) {
+        if (v > value_.load(std::memory_order_relaxed)) value_.store(v, std::memory_order_relaxed);
+    }
+    inline uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+};
+
+// Log-linear histogram in the same layout as LatencyHistogram, coarser
+// (values within 1/8) so a full set of them stays a few KB per operation.
+class TelemetryHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 4;
+    static constexpr uint32_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr uint32_t MAX_VALUE_BITS = 40;
+    static constexpr size_t BUCKET_COUNT =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+private:
+    TelemetryCounter counts_[BUCKET_COUNT];
+    TelemetryCounter total_;
+    TelemetryCounter max_;
+
+    static inline size_t index_for(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) return static_cast<size_t>(value);
+        uint32_t msb = 63u - static_cast<uint32_t>(__builtin_clzll(value));
+        if (msb >= MAX_VALUE_BITS) [[unlikely]] return BUCKET_COUNT - 1;
+        uint32_t shift = msb - (SUB_BUCKET_BITS - 1);
+        return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF
+             + static_cast<size_t>((value >> shift) - SUB_BUCKET_HALF);
+    }
+
+    static inline uint64_t highest_at(size_t index) {
+        if (index < SUB_BUCKET_COUNT) return index;
+        size_t rel = index - SUB_BUCKET_COUNT;
+        uint32_t shift = static_cast<uint32_t>(rel / SUB_BUCKET_HALF) + 1;
+        uint64_t mantissa = SUB_BUCKET_HALF + rel % SUB_BUCKET_HALF;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+public:
+    inline void record(uint64_t value) {
+        counts_[index_for(value)].add();
+        total_.add();
+        max_.raise_to(value);
+    }
+
+    uint64_t count() const { return total_.load(); }
+    uint64_t max() const { return max_.load(); }
+
+    // Counts may move while this walks them; the result is approximate in
+    // the same way the live figures are.
+    uint64_t percentile(double p) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) total += counts_[i].load();
+        if (total == 0) return 0;
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts_[i].load();
+            if (seen >= target) return std::min(highest_at(i), max());
+        }
+        return max();
+    }
+};
+
+class EngineTelemetry {
+public:
+    static constexpr size_t OP_COUNT = static_cast<size_t>(BookOp::COUNT);
+    static constexpr uint64_t SAMPLE_MASK = (1ULL << TELEMETRY_SAMPLE_SHIFT) - 1;
+    static constexpr size_t SWEEP_BUCKETS = 17;     // 0..15 levels exact, last is 16+
+
+private:
+    // Writer-only sampling state, on its own line so readers never share it.
+    struct alignas(64) SampleState {
+        uint64_t sequence = 0;
+        uint64_t start = 0;
+        BookOp op = BookOp::ADD;
+        bool active = false;
+    } sample_;
+
+public:
+    alignas(64) TelemetryCounter op_count[OP_COUNT];
+    TelemetryCounter levels_swept[SWEEP_BUCKETS];
+    TelemetryCounter max_levels_swept;
+    TelemetryCounter pool_used;
+    TelemetryCounter pool_high_water;
+    TelemetryCounter pool_capacity;
+    TelemetryCounter output_ring_used;
+    TelemetryCounter output_ring_high_water;
+
+    // Sampled per-operation latency in telemetry_ticks().
+    alignas(64) TelemetryHistogram op_latency[OP_COUNT];
+    // Price ticks between an emptied best level and the next one found in
+    // the bitmap; long jumps mean a thin book and a wider search.
+    TelemetryHistogram rescan_distance;
+
+    inline void begin(BookOp op) {
+        op_count[static_cast<size_t>(op)].add();
+        if ((sample_.sequence++ & SAMPLE_MASK) == 0) [[unlikely]] {
+            sample_.op = op;
+            sample_.active = true;
+            sample_.start = telemetry_ticks();
+        }
+    }
+
+    inline bool sampling() const { return sample_.active; }
+
+    inline void end_sample() {
+        op_latency[static_cast<size_t>(sample_.op)].record(telemetry_ticks() - sample_.start);
+        sample_.active = false;
+    }
+
+    inline void note_match(uint32_t levels) {
+        levels_swept[std::min<size_t>(levels, SWEEP_BUCKETS - 1)].add();
+        max_levels_swept.raise_to(levels);
+    }
+
+    inline void note_rescan(int64_t distance) {
+        rescan_distance.record(static_cast<uint64_t>(distance));
+    }
+
+    inline void note_pool(size_t used, size_t capacity) {
+        pool_used.set(used);
+        pool_high_water.raise_to(used);
+        pool_capacity.set(capacity);
+    }
+
+    inline void note_output_ring(size_t used) {
+        output_ring_used.set(used);
+        output_ring_high_water.raise_to(used);
+    }
+
+    uint64_t total_ops() const {
+        uint64_t total = 0;
+        for (const TelemetryCounter& c : op_count) total += c.load();
+        return total;
+    }
+};
+
+#endif
@@ -5,9 +5,13 @@
 #include <cstring>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <vector>
 #include <iostream>
 #include "protocol.h"
+#include "ring_buffer.h"
 #include "order_book.h"
+#include "thread_utils.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -19,211 +23,424 @@
     #define close_socket closesocket
 #else
     #include <sys/socket.h>
+    #include <sys/select.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <arpa/inet.h>
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <cerrno>
     typedef int socket_t;
     #define INVALID_SOCKET_VALUE -1
     #define SOCKET_ERROR_VALUE -1
     #define close_socket close
 #endif
 
+#ifdef __linux__
+    #include <sys/epoll.h>
+#endif
+
+#if defined(__linux__) && defined(GATEWAY_IO_URING)
+    #include "io_uring_raw.h"
+#endif
+
+// Single-threaded event-driven ingest. One loop (epoll on Linux, io_uring
+// when built with -DGATEWAY_IO_URING, select elsewhere) reads large chunks
+// into a per-connection buffer, frames every complete message in the chunk
+// and pushes them into an SPSC queue. A matching thread drains the queue in
+// batches and applies each batch under one book lock.
 class TcpGateway {
 private:
+    static constexpr size_t CONN_BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t MAX_CONNECTIONS = 64;
+    static constexpr size_t INGEST_QUEUE_SIZE = 1 << 16;
+    static constexpr size_t MATCH_BATCH = 64;
+    static constexpr int POLL_TIMEOUT_MS = 100;
+
+    using IngestQueue = RingBuffer<InputSlot, INGEST_QUEUE_SIZE>;
+
+    // Bytes [head, tail) are received but not yet framed. The unread tail is
+    // moved to the front only when less than one maximum-size message of
+    // space remains, so most reads never memmove.
+    struct Connection {
+        socket_t fd = INVALID_SOCKET_VALUE;
+        std::unique_ptr<uint8_t[]> buffer;
+        size_t head = 0;
+        size_t tail = 0;
+
+        Connection() : buffer(std::make_unique<uint8_t[]>(CONN_BUFFER_SIZE)) {}
+
+        inline uint8_t* write_ptr() { return buffer.get() + tail; }
+        inline size_t write_space() const { return CONN_BUFFER_SIZE - tail; }
+
+        inline void compact() {
+            if (head == tail) {
+                head = tail = 0;
+            } else if (CONN_BUFFER_SIZE - tail < MAX_INPUT_MSG_SIZE) {
+                std::memmove(buffer.get(), buffer.get() + head, tail - head);
+                tail -= head;
+                head = 0;
+            }
+        }
+    };
+
     uint16_t port_;
     std::atomic<bool> running_;
     std::thread listener_thread_;
+    std::thread match_thread_;
     OptimizedOrderBook& order_book_;
-    
-    static constexpr size_t MAX_MESSAGE_SIZE = 1024;
-    
-    bool recv_exact(socket_t client_socket, uint8_t* buffer, size_t num_bytes) {
-        size_t total_received = 0;
-        
-        while (total_received < num_bytes) {
-            int bytes_received = recv(client_socket, 
-                                     reinterpret_cast<char*>(buffer + total_received),
-                                     static_cast<int>(num_bytes - total_received), 
-                                     0);
-            
-            if (bytes_received <= 0) {
-                if (bytes_received == 0) {
-                    std::cerr << "[Gateway] Client disconnected\n";
-                } else {
-                    std::cerr << "[Gateway] Recv error\n";
-                }
+
+    std::unique_ptr<IngestQueue> ingest_queue_;
+    std::vector<Connection> connections_;
+
+    std::atomic<uint64_t> messages_received_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+    std::atomic<uint64_t> recv_calls_{0};
+    std::atomic<uint64_t> messages_applied_{0};
+    std::atomic<uint64_t> framing_errors_{0};
+
+    static inline void set_non_blocking(socket_t fd) {
+#ifdef _WIN32
+        u_long mode = 1;
+        ioctlsocket(fd, FIONBIO, &mode);
+#else
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+    }
+
+    static inline bool would_block() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+    // Frames every complete message in [head, tail). Returns false on a
+    // corrupt length, after which the stream cannot be resynchronised.
+    bool frame_messages(Connection& conn) {
+        const uint8_t* base = conn.buffer.get();
+        uint64_t framed = 0;
+
+        while (conn.tail - conn.head >= sizeof(MsgHeader)) {
+            const MsgHeader* header = reinterpret_cast<const MsgHeader*>(base + conn.head);
+            uint16_t total_length = header->length;
+
+            if (total_length < sizeof(MsgHeader) || total_length > MAX_INPUT_MSG_SIZE ||
+                total_length < message_size(header->type)) [[unlikely]] {
+                std::cerr << "[Gateway] Invalid message length: " << total_length << "\n";
+                framing_errors_.fetch_add(1, std::memory_order_relaxed);
                 return false;
             }
-            
-            total_received += bytes_received;
+            if (conn.tail - conn.head < total_length) break;
+
+            InputSlot slot;
+            slot.length = total_length;
+            std::memcpy(slot.data, base + conn.head, total_length);
+            while (!ingest_queue_->try_push(slot)) {
+                cpu_relax();
+            }
+
+            conn.head += total_length;
+            ++framed;
         }
-        
+
+        conn.compact();
+        messages_received_.fetch_add(framed, std::memory_order_relaxed);
         return true;
     }
-    
-    void handle_client(socket_t client_socket) {
-        std::cout << "[Gateway] Client connected\n";
-        
-        alignas(8) uint8_t message_buffer[MAX_MESSAGE_SIZE];
-        
-        while (running_.load(std::memory_order_relaxed)) {
-            if (!recv_exact(client_socket, message_buffer, sizeof(MsgHeader))) {
-                break;
-            }
-            
-            const MsgHeader* header = reinterpret_cast<const MsgHeader*>(message_buffer);
-            uint16_t total_length = header->length;
-            
-            if (total_length < sizeof(MsgHeader) || total_length > MAX_MESSAGE_SIZE) {
-                std::cerr << "[Gateway] Invalid message length: " << total_length << "\n";
-                break;
-            }
-            
-            size_t remaining_bytes = total_length - sizeof(MsgHeader);
-            if (remaining_bytes > 0) {
-                if (!recv_exact(client_socket, message_buffer + sizeof(MsgHeader), remaining_bytes)) {
-                    break;
-                }
+
+    // Called after `bytes` new bytes landed at conn.write_ptr().
+    bool on_data(Connection& conn, size_t bytes) {
+        conn.tail += bytes;
+        recv_calls_.fetch_add(1, std::memory_order_relaxed);
+        bytes_received_.fetch_add(bytes, std::memory_order_relaxed);
+        return frame_messages(conn);
+    }
+
+    Connection* open_connection(socket_t client_socket) {
+        for (auto& conn : connections_) {
+            if (conn.fd == INVALID_SOCKET_VALUE) {
+                conn.fd = client_socket;
+                conn.head = conn.tail = 0;
+                int flag = 1;
+                setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY,
+                           reinterpret_cast<const char*>(&flag), sizeof(flag));
+                std::cout << "[Gateway] Client connected\n";
+                return &conn;
             }
-            
-            process_message(header);
         }
-        
+        std::cerr << "[Gateway] Connection limit reached\n";
         close_socket(client_socket);
+        return nullptr;
+    }
+
+    void close_connection(Connection& conn) {
+        close_socket(conn.fd);
+        conn.fd = INVALID_SOCKET_VALUE;
+        conn.head = conn.tail = 0;
         std::cout << "[Gateway] Client disconnected\n";
     }
-    
-    void process_message(const MsgHeader* header) {
-        switch (header->type) {
-            case MsgType::ADD_ORDER: {
-                const auto* msg = msg_cast<MsgAddOrder>(header);
-                order_book_.add_order(msg->order_id, side_to_bool(msg->side), 
-                                     msg->price, msg->quantity, 
-                                     static_cast<uint32_t>(msg->user_id));
-                break;
-            }
-            
-            case MsgType::ADD_ICEBERG: {
-                const auto* msg = msg_cast<MsgAddIceberg>(header);
-                order_book_.add_order(msg->order_id, side_to_bool(msg->side),
-                                     msg->price, msg->visible_quantity,
-                                     static_cast<uint32_t>(msg->user_id));
-                break;
-            }
-            
-            case MsgType::ADD_AON: {
-                const auto* msg = msg_cast<MsgAddAON>(header);
-                order_book_.add_order(msg->order_id, side_to_bool(msg->side),
-                                     msg->price, msg->quantity,
-                                     static_cast<uint32_t>(msg->user_id));
-                break;
-            }
-            
-            case MsgType::CANCEL_ORDER: {
-                const auto* msg = msg_cast<MsgCancel>(header);
-                order_book_.cancel_order(msg->order_id);
-                break;
-            }
-            
-            case MsgType::MODIFY_ORDER: {
-                const auto* msg = msg_cast<MsgModify>(header);
-                order_book_.cancel_order(msg->order_id);
-                break;
-            }
-            
-            case MsgType::EXECUTE: {
-                const auto* msg = msg_cast<MsgExecute>(header);
-                order_book_.match_order(msg->order_id, side_to_bool(msg->side),
-                                       msg->price, msg->quantity,
-                                       tif_from_protocol(msg->time_in_force));
-                break;
+
+    // Drains the socket until it would block; false if the peer went away.
+    bool read_available(Connection& conn) {
+        while (true) {
+            int bytes_received = recv(conn.fd, reinterpret_cast<char*>(conn.write_ptr()),
+                                      static_cast<int>(conn.write_space()), 0);
+            if (bytes_received > 0) {
+                if (!on_data(conn, static_cast<size_t>(bytes_received))) return false;
+                continue;
             }
-            
-            case MsgType::HEARTBEAT:
-                break;
-                
-            case MsgType::RESET:
-                break;
-                
-            default:
-                std::cerr << "[Gateway] Unknown message type: " 
-                         << static_cast<int>(header->type) << "\n";
-                break;
+            if (bytes_received < 0 && would_block()) return true;
+            if (bytes_received < 0) std::cerr << "[Gateway] Recv error\n";
+            return false;
         }
     }
-    
-    void listener_loop() {
-#ifdef _WIN32
-        WSADATA wsaData;
-        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-            std::cerr << "[Gateway] WSAStartup failed\n";
-            return;
+
+    void match_loop() {
+        InputSlot batch[MATCH_BATCH];
+
+        while (true) {
+            size_t n = ingest_queue_->pop_batch(batch, MATCH_BATCH);
+            if (n == 0) {
+                if (!running_.load(std::memory_order_acquire)) break;
+                cpu_relax();
+                continue;
+            }
+            order_book_.process_messages(batch, n);
+            messages_applied_.fetch_add(n, std::memory_order_relaxed);
         }
-#endif
-        
+    }
+
+    socket_t open_listen_socket() {
         socket_t listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         if (listen_socket == INVALID_SOCKET_VALUE) {
             std::cerr << "[Gateway] Failed to create socket\n";
-#ifdef _WIN32
-            WSACleanup();
-#endif
-            return;
+            return INVALID_SOCKET_VALUE;
         }
-        
+
         int opt = 1;
-        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, 
+        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR,
                    reinterpret_cast<const char*>(&opt), sizeof(opt));
-        
+
         sockaddr_in server_addr;
         std::memset(&server_addr, 0, sizeof(server_addr));
         server_addr.sin_family = AF_INET;
         server_addr.sin_addr.s_addr = INADDR_ANY;
         server_addr.sin_port = htons(port_);
-        
-        if (bind(listen_socket, reinterpret_cast<sockaddr*>(&server_addr), 
+
+        if (bind(listen_socket, reinterpret_cast<sockaddr*>(&server_addr),
                  sizeof(server_addr)) == SOCKET_ERROR_VALUE) {
             std::cerr << "[Gateway] Bind failed on port " << port_ << "\n";
             close_socket(listen_socket);
-#ifdef _WIN32
-            WSACleanup();
-#endif
-            return;
+            return INVALID_SOCKET_VALUE;
         }
-        
+
         if (listen(listen_socket, SOMAXCONN) == SOCKET_ERROR_VALUE) {
             std::cerr << "[Gateway] Listen failed\n";
             close_socket(listen_socket);
-#ifdef _WIN32
-            WSACleanup();
-#endif
-            return;
+            return INVALID_SOCKET_VALUE;
         }
-        
+
         std::cout << "[Gateway] Listening on port " << port_ << "\n";
-        
-        while (running_.load(std::memory_order_relaxed)) {
+        return listen_socket;
+    }
+
+    void accept_pending(socket_t listen_socket) {
+        while (true) {
             sockaddr_in client_addr;
             socklen_t client_len = sizeof(client_addr);
-            socket_t client_socket = accept(listen_socket, 
+            socket_t client_socket = accept(listen_socket,
                                            reinterpret_cast<sockaddr*>(&client_addr),
                                            &client_len);
-            
             if (client_socket == INVALID_SOCKET_VALUE) {
-                if (running_.load(std::memory_order_relaxed)) {
+                if (!would_block() && running_.load(std::memory_order_relaxed)) {
                     std::cerr << "[Gateway] Accept failed\n";
                 }
-                continue;
+                return;
+            }
+            set_non_blocking(client_socket);
+            if (Connection* conn = open_connection(client_socket)) {
+                on_connection_opened(*conn);
             }
-            
-            handle_client(client_socket);
         }
-        
-        close_socket(listen_socket);
-        
+    }
+
+#if defined(__linux__) && !defined(GATEWAY_IO_URING)
+    int epoll_fd_ = -1;
+
+    void on_connection_opened(Connection& conn) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = &conn;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, conn.fd, &ev);
+    }
+
+    void event_loop(socket_t listen_socket) {
+        epoll_fd_ = epoll_create1(0);
+        if (epoll_fd_ < 0) {
+            std::cerr << "[Gateway] epoll_create1 failed\n";
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_socket, &ev);
+
+        epoll_event events[MAX_CONNECTIONS + 1];
+        while (running_.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epoll_fd_, events, MAX_CONNECTIONS + 1, POLL_TIMEOUT_MS);
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.ptr == nullptr) {
+                    accept_pending(listen_socket);
+                    continue;
+                }
+                Connection& conn = *static_cast<Connection*>(events[i].data.ptr);
+                if (!read_available(conn)) {
+                    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+                    close_connection(conn);
+                }
+            }
+        }
+
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+#elif defined(__linux__) && defined(GATEWAY_IO_URING)
+    // Minimal raw io_uring: one ACCEPT and one RECV per connection are kept
+    // in flight; each RECV completion carries as many messages as the kernel
+    // had queued for that socket.
+    static constexpr unsigned URING_ENTRIES = 256;
+    static constexpr uint64_t ACCEPT_TAG = ~uint64_t{0};
+    static constexpr uint64_t TIMEOUT_TAG = ~uint64_t{0} - 1;
+
+    RawUring ring_;
+    __kernel_timespec uring_timeout_{0, POLL_TIMEOUT_MS * 1'000'000LL};
+
+    void uring_prep_accept(socket_t listen_socket) {
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listen_socket;
+        sqe->user_data = ACCEPT_TAG;
+    }
+
+    void uring_prep_recv(Connection& conn) {
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = conn.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(conn.write_ptr());
+        sqe->len = static_cast<uint32_t>(conn.write_space());
+        sqe->user_data = static_cast<uint64_t>(&conn - connections_.data());
+    }
+
+    void uring_prep_timeout() {
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = reinterpret_cast<uint64_t>(&uring_timeout_);
+        sqe->len = 1;
+        sqe->user_data = TIMEOUT_TAG;
+    }
+
+    void on_connection_opened(Connection& conn) { uring_prep_recv(conn); }
+
+    void event_loop(socket_t listen_socket) {
+        if (!ring_.init(URING_ENTRIES)) {
+            std::cerr << "[Gateway] io_uring_setup failed\n";
+            return;
+        }
+
+        uring_prep_accept(listen_socket);
+        uring_prep_timeout();
+
+        while (running_.load(std::memory_order_relaxed)) {
+            if (!ring_.enter(1)) {
+                std::cerr << "[Gateway] io_uring_enter failed\n";
+                break;
+            }
+
+            ring_.for_each_cqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == TIMEOUT_TAG) {
+                    uring_prep_timeout();
+                } else if (cqe.user_data == ACCEPT_TAG) {
+                    if (cqe.res >= 0) {
+                        if (Connection* conn = open_connection(cqe.res)) {
+                            on_connection_opened(*conn);
+                        }
+                    }
+                    uring_prep_accept(listen_socket);
+                } else {
+                    Connection& conn = connections_[cqe.user_data];
+                    if (cqe.res > 0 && on_data(conn, static_cast<size_t>(cqe.res))) {
+                        uring_prep_recv(conn);
+                    } else {
+                        close_connection(conn);
+                    }
+                }
+            });
+        }
+
+        ring_.destroy();
+    }
+#else
+    void on_connection_opened(Connection&) {}
+
+    void event_loop(socket_t listen_socket) {
+        while (running_.load(std::memory_order_relaxed)) {
+            fd_set read_fds;
+            FD_ZERO(&read_fds);
+            FD_SET(listen_socket, &read_fds);
+            socket_t max_fd = listen_socket;
+            for (auto& conn : connections_) {
+                if (conn.fd == INVALID_SOCKET_VALUE) continue;
+                FD_SET(conn.fd, &read_fds);
+                if (conn.fd > max_fd) max_fd = conn.fd;
+            }
+
+            timeval tv{0, POLL_TIMEOUT_MS * 1000};
+            int ready = select(static_cast<int>(max_fd + 1), &read_fds, nullptr, nullptr, &tv);
+            if (ready <= 0) continue;
+
+            if (FD_ISSET(listen_socket, &read_fds)) {
+                accept_pending(listen_socket);
+            }
+            for (auto& conn : connections_) {
+                if (conn.fd == INVALID_SOCKET_VALUE || !FD_ISSET(conn.fd, &read_fds)) continue;
+                if (!read_available(conn)) {
+                    close_connection(conn);
+                }
+            }
+        }
+    }
+#endif
+
+    void listener_loop() {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            std::cerr << "[Gateway] WSAStartup failed\n";
+            return;
+        }
+#endif
+
+        socket_t listen_socket = open_listen_socket();
+        if (listen_socket != INVALID_SOCKET_VALUE) {
+#ifndef GATEWAY_IO_URING
+            set_non_blocking(listen_socket);
+#endif
+            event_loop(listen_socket);
+
+            for (auto& conn : connections_) {
+                if (conn.fd != INVALID_SOCKET_VALUE) close_connection(conn);
+            }
+            close_socket(listen_socket);
+        }
+
 #ifdef _WIN32
         WSACleanup();
 #endif
-        
+
         std::cout << "[Gateway] Listener stopped\n";
     }
 
@@ -232,50 +449,69 @@ public:
         : port_(port)
         , running_(false)
         , order_book_(order_book)
+        , ingest_queue_(std::make_unique<IngestQueue>())
+        , connections_(MAX_CONNECTIONS)
     {
     }
-    
+
     ~TcpGateway() {
         stop();
     }
-    
+
     TcpGateway(const TcpGateway&) = delete;
     TcpGateway& operator=(const TcpGateway&) = delete;
-    
+
     void start() {
         if (running_.load(std::memory_order_relaxed)) {
             std::cerr << "[Gateway] Already running\n";
             return;
         }
-        
-        running_.store(true, std::memory_order_relaxed);
+
+        running_.store(true, std::memory_order_release);
+        match_thread_ = std::thread(&TcpGateway::match_loop, this);
         listener_thread_ = std::thread(&TcpGateway::listener_loop, this);
-        
+
         std::cout << "[Gateway] Started\n";
     }
-    
+
+    // The listener wakes at least every POLL_TIMEOUT_MS, so both threads are
+    // joined; messages already framed are applied before the matcher exits.
     void stop() {
         if (!running_.load(std::memory_order_relaxed)) {
             return;
         }
-        
+
         std::cout << "[Gateway] Stopping...\n";
-        running_.store(false, std::memory_order_relaxed);
-        
+        running_.store(false, std::memory_order_release);
+
         if (listener_thread_.joinable()) {
-            listener_thread_.detach(); 
+            listener_thread_.join();
         }
-        
+        if (match_thread_.joinable()) {
+            match_thread_.join();
+        }
+
         std::cout << "[Gateway] Stopped\n";
     }
-    
+
     bool is_running() const {
         return running_.load(std::memory_order_relaxed);
     }
-    
+
     uint16_t get_port() const {
         return port_;
     }
+
+    uint64_t messages_received() const { return messages_received_.load(std::memory_order_relaxed); }
+    uint64_t messages_applied() const { return messages_applied_.load(std::memory_order_relaxed); }
+    uint64_t bytes_received() const { return bytes_received_.load(std::memory_order_relaxed); }
+    uint64_t recv_calls() const { return recv_calls_.load(std::memory_order_relaxed); }
+    uint64_t framing_errors() const { return framing_errors_.load(std::memory_order_relaxed); }
+
+    double messages_per_recv() const {
+        uint64_t calls = recv_calls();
+        return calls ? static_cast<double>(messages_received()) / calls : 0.0;
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
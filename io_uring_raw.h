@@ -0,0 +1,106 @@
+#ifndef IO_URING_RAW_H
+#define IO_URING_RAW_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Minimal io_uring over the raw syscalls, so no liburing is needed. One
+// thread owns the ring: it takes SQEs with get_sqe(), hands them to the
+// kernel with enter() and drains completions with for_each_cqe().
+struct RawUring {
+    int fd = -1;
+    io_uring_params params{};
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pending = 0;
+
+    bool init(unsigned entries) {
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+
+        auto* sq = static_cast<uint8_t*>(sq_ptr);
+        auto* cq = static_cast<uint8_t*>(cq_ptr);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void destroy() {
+        if (fd < 0) return;
+        munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+        munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(fd);
+        fd = -1;
+    }
+
+    io_uring_sqe* get_sqe() {
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++pending;
+        return sqe;
+    }
+
+    // Submits everything queued since the last call and waits for at
+    // least `min_complete` completions. Returns false on a ring error.
+    bool enter(unsigned min_complete) {
+        unsigned to_submit = pending;
+        pending = 0;
+        unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0) >= 0 ||
+               errno == EINTR;
+    }
+
+    template<typename Fn>
+    unsigned for_each_cqe(Fn&& fn) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned seen = tail - head;
+        for (; head != tail; ++head) {
+            fn(cqes[head & *cq_mask]);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return seen;
+    }
+};
+
+#endif
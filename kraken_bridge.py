@@ -5,9 +5,9 @@ Kraken L3 → TitanLOB TCP Bridge
 Pipes live Kraken WebSocket L3 data directly into the C++ Gateway on port 9000.
 
 This bridges:
-    Kraken 'add'    → MsgAddOrder (44 bytes)
-    Kraken 'modify' → MsgModify   (35 bytes)  
-    Kraken 'delete' → MsgCancel   (19 bytes)
+    Kraken 'add'    → MsgAddOrder (46 bytes)
+    Kraken 'modify' → MsgModify   (37 bytes)  
+    Kraken 'delete' → MsgCancel   (21 bytes)
 
 Requirements:
     pip install websocket-client
@@ -54,17 +54,20 @@ SIDE_BUY  = ord('B')
 SIDE_SELL = ord('S')  
 
 
+SYMBOL_ID = 0
 
-ADD_ORDER_FMT = '<BHQ QQ B qq'
-ADD_ORDER_SIZE = 44
 
 
-CANCEL_FMT = '<BHQ Q'
-CANCEL_SIZE = 19
+ADD_ORDER_FMT = '<BHQH QQ B qq'
+ADD_ORDER_SIZE = 46
 
 
-MODIFY_FMT = '<BHQ Q qq'
-MODIFY_SIZE = 35
+CANCEL_FMT = '<BHQH Q'
+CANCEL_SIZE = 21
+
+
+MODIFY_FMT = '<BHQH Q qq'
+MODIFY_SIZE = 37
 
 
 
@@ -111,12 +114,13 @@ def iso_to_nanos(iso_str: str) -> int:
 
 
 def pack_add_order(timestamp: int, order_id: int, side: int, price: int, quantity: int) -> bytes:
-    """Pack MsgAddOrder (44 bytes)."""
+    """Pack MsgAddOrder (46 bytes)."""
     return struct.pack(
         ADD_ORDER_FMT,
         MSG_ADD_ORDER,      
         ADD_ORDER_SIZE,     
         timestamp,          
+        SYMBOL_ID,          
         order_id,           
         0,                  
         side,               
@@ -125,22 +129,24 @@ def pack_add_order(timestamp: int, order_id: int, side: int, price: int, quantit
     )
 
 def pack_cancel(timestamp: int, order_id: int) -> bytes:
-    """Pack MsgCancel (19 bytes)."""
+    """Pack MsgCancel (21 bytes)."""
     return struct.pack(
         CANCEL_FMT,
         MSG_CANCEL_ORDER,   
         CANCEL_SIZE,        
         timestamp,          
+        SYMBOL_ID,          
         order_id            
     )
 
 def pack_modify(timestamp: int, order_id: int, new_price: int, new_quantity: int) -> bytes:
-    """Pack MsgModify (35 bytes)."""
+    """Pack MsgModify (37 bytes)."""
     return struct.pack(
         MODIFY_FMT,
         MSG_MODIFY_ORDER,   
         MODIFY_SIZE,        
         timestamp,          
+        SYMBOL_ID,          
         order_id,           
         new_price,          
         new_quantity        
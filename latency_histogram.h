@@ -0,0 +1,115 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Log-linear (HDR-style) latency histogram over integer nanoseconds.
+// Values below 2^SUB_BUCKET_BITS are counted exactly; above that each
+// power-of-two range is split into 2^(SUB_BUCKET_BITS-1) linear buckets,
+// so any recorded value is reported within 1/128 of its true magnitude.
+// Recording is a couple of shifts and an increment on a fixed array: no
+// allocation, no sort, and millions of samples cost ~30 KB.
+class LatencyHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 8;
+    static constexpr uint32_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr uint32_t MAX_VALUE_BITS = 36;      // ~68 s; larger values clamp
+    static constexpr size_t BUCKET_COUNT =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+    static constexpr uint64_t MAX_TRACKABLE = (1ULL << MAX_VALUE_BITS) - 1;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+    double sum_ = 0.0;
+
+    static inline size_t index_for(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) return static_cast<size_t>(value);
+        uint32_t msb = 63u - static_cast<uint32_t>(__builtin_clzll(value));
+        uint32_t shift = msb - (SUB_BUCKET_BITS - 1);
+        uint64_t mantissa = value >> shift;
+        return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF
+             + static_cast<size_t>(mantissa - SUB_BUCKET_HALF);
+    }
+
+    static inline uint64_t lowest_at(size_t index) {
+        if (index < SUB_BUCKET_COUNT) return index;
+        size_t rel = index - SUB_BUCKET_COUNT;
+        uint32_t shift = static_cast<uint32_t>(rel / SUB_BUCKET_HALF) + 1;
+        uint64_t mantissa = SUB_BUCKET_HALF + rel % SUB_BUCKET_HALF;
+        return mantissa << shift;
+    }
+
+    static inline uint64_t highest_at(size_t index) {
+        if (index < SUB_BUCKET_COUNT) return index;
+        uint32_t shift = static_cast<uint32_t>((index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF) + 1;
+        return lowest_at(index) + (1ULL << shift) - 1;
+    }
+
+public:
+    inline void record(uint64_t value, uint64_t count = 1) {
+        if (value > MAX_TRACKABLE) [[unlikely]] value = MAX_TRACKABLE;
+        counts_[index_for(value)] += count;
+        total_count_ += count;
+        sum_ += static_cast<double>(value) * static_cast<double>(count);
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+
+    inline void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) counts_[i] += other.counts_[i];
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    inline void reset() {
+        counts_.fill(0);
+        total_count_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+        sum_ = 0.0;
+    }
+
+    uint64_t count() const { return total_count_; }
+    uint64_t min() const { return total_count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_count_ ? sum_ / static_cast<double>(total_count_) : 0.0; }
+
+    // Highest value equivalent to the sample at percentile p (0..100),
+    // clamped to the observed min/max.
+    uint64_t percentile(double p) const {
+        if (total_count_ == 0) return 0;
+        p = std::clamp(p, 0.0, 100.0);
+        uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total_count_)));
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts_[i];
+            if (seen >= target) return std::clamp(highest_at(i), min(), max_);
+        }
+        return max_;
+    }
+
+    double std_dev() const {
+        if (total_count_ == 0) return 0.0;
+        double m = mean();
+        double sq_sum = 0.0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            if (counts_[i] == 0) continue;
+            double mid = 0.5 * static_cast<double>(lowest_at(i) + highest_at(i));
+            sq_sum += (mid - m) * (mid - m) * static_cast<double>(counts_[i]);
+        }
+        return std::sqrt(sq_sum / static_cast<double>(total_count_));
+    }
+};
+
+#endif
@@ -3,15 +3,25 @@
 
 #include <cstdint>
 #include <cstring>
+#include <cstdio>
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <iostream>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include "output_msg.h"
 
+#if defined(__linux__) && defined(LOGGER_IO_URING)
+    #include "io_uring_raw.h"
+#endif
+
 namespace deepflow {
 
 #pragma pack(push, 1)
@@ -20,7 +30,9 @@ struct FileHeader {
     uint32_t version;
     uint32_t msg_size;
     uint64_t timestamp_start;
-    uint64_t reserved[4];
+    uint64_t data_offset;
+    uint64_t segment_index;
+    uint64_t reserved[2];
     
     static constexpr uint64_t MAGIC = 0x574F4C46504545ULL;
     static constexpr uint32_t VERSION = 1;
@@ -37,6 +49,11 @@ struct FileHeader {
     bool is_valid() const {
         return magic == MAGIC && version == VERSION && msg_size == sizeof(OutputMsg);
     }
+    
+    // Files written before data_offset existed have zero there.
+    uint64_t first_message_offset() const {
+        return data_offset ? data_offset : sizeof(FileHeader);
+    }
 };
 #pragma pack(pop)
 
@@ -44,85 +61,221 @@ static_assert(sizeof(FileHeader) == 56, "FileHeader must be 56 bytes");
 
 constexpr size_t BUFFER_CAPACITY = 65536;
 constexpr size_t BUFFER_SIZE_BYTES = BUFFER_CAPACITY * sizeof(OutputMsg);
+constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+static_assert(BUFFER_SIZE_BYTES % DIRECT_IO_ALIGNMENT == 0, "Buffers must be whole O_DIRECT blocks");
 
 struct MessageBuffer {
-    std::unique_ptr<OutputMsg[]> data;
+    struct AlignedFree {
+        void operator()(OutputMsg* p) const {
+            ::operator delete[](p, std::align_val_t{DIRECT_IO_ALIGNMENT});
+        }
+    };
+    std::unique_ptr<OutputMsg[], AlignedFree> data;
     size_t count = 0;
     
-    MessageBuffer() : data(std::make_unique<OutputMsg[]>(BUFFER_CAPACITY)), count(0) {}
+    MessageBuffer()
+        : data(static_cast<OutputMsg*>(
+              ::operator new[](BUFFER_SIZE_BYTES, std::align_val_t{DIRECT_IO_ALIGNMENT}))),
+          count(0) {}
     
     void reset() { count = 0; }
     bool is_full() const { return count >= BUFFER_CAPACITY; }
     size_t remaining() const { return BUFFER_CAPACITY - count; }
 };
 
+struct LoggerConfig {
+    std::string path;
+    // 0 writes one file at `path`. Otherwise segments `path.000000`,
+    // `path.000001`, ... are preallocated to this size and rotated when
+    // full; each starts with its own FileHeader.
+    uint64_t segment_bytes = 0;
+    // Buffers that may be filling or in flight at once. When all of them
+    // are waiting on disk, log() drops and counts instead of blocking.
+    size_t buffer_count = 8;
+    // O_DIRECT with block-aligned writes; falls back to buffered I/O if the
+    // filesystem refuses it.
+    bool direct_io = false;
+};
+
+struct LogCompletion {
+    uint64_t tag;
+    int64_t result;
+};
+
+// Where flushed buffers go. submit() queues one write at an explicit file
+// offset and reap() reports finished writes by tag. Only the flush thread
+// calls into a backend.
+class LogBackend {
+public:
+    virtual ~LogBackend() = default;
+    virtual bool submit(int fd, const void* data, size_t len, uint64_t offset, uint64_t tag) = 0;
+    // Collects up to `max` completions, blocking until at least
+    // `min_complete` are available.
+    virtual size_t reap(size_t min_complete, LogCompletion* out, size_t max) = 0;
+    virtual size_t in_flight() const = 0;
+};
+
+// Synchronous pwrite: the write is finished by the time submit() returns.
+class PwriteBackend : public LogBackend {
+    std::vector<LogCompletion> done_;
+
+public:
+    bool submit(int fd, const void* data, size_t len, uint64_t offset, uint64_t tag) override {
+        const char* p = static_cast<const char*>(data);
+        size_t written = 0;
+        while (written < len) {
+            ssize_t n = ::pwrite(fd, p + written, len - written, static_cast<off_t>(offset + written));
+            if (n <= 0) break;
+            written += static_cast<size_t>(n);
+        }
+        done_.push_back(LogCompletion{tag, written == len ? static_cast<int64_t>(len) : -1});
+        return true;
+    }
+
+    size_t reap(size_t, LogCompletion* out, size_t max) override {
+        size_t n = std::min(max, done_.size());
+        std::memcpy(out, done_.data(), n * sizeof(LogCompletion));
+        done_.erase(done_.begin(), done_.begin() + static_cast<std::ptrdiff_t>(n));
+        return n;
+    }
+
+    size_t in_flight() const override { return done_.size(); }
+};
+
+#if defined(__linux__) && defined(LOGGER_IO_URING)
+// Asynchronous writes through io_uring; every in-flight buffer is one SQE.
+class UringBackend : public LogBackend {
+    RawUring ring_;
+    size_t in_flight_ = 0;
+
+public:
+    explicit UringBackend(unsigned entries) {
+        if (!ring_.init(entries)) {
+            std::cerr << "[Logger] io_uring_setup failed" << std::endl;
+        }
+    }
+    ~UringBackend() override { ring_.destroy(); }
+
+    bool ok() const { return ring_.fd >= 0; }
+
+    bool submit(int fd, const void* data, size_t len, uint64_t offset, uint64_t tag) override {
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->off = offset;
+        sqe->user_data = tag;
+        ++in_flight_;
+        return ring_.enter(0);
+    }
+
+    size_t reap(size_t min_complete, LogCompletion* out, size_t max) override {
+        if (min_complete > 0 && !ring_.enter(static_cast<unsigned>(min_complete))) return 0;
+        size_t n = 0;
+        // Never more than `max` are in flight, so one pass fits in `out`.
+        ring_.for_each_cqe([&](const io_uring_cqe& cqe) {
+            if (n < max) out[n++] = LogCompletion{cqe.user_data, cqe.res};
+        });
+        in_flight_ -= n;
+        return n;
+    }
+
+    size_t in_flight() const override { return in_flight_; }
+};
+#endif
+
+// Asynchronous binary logger. The producer (usually the matching thread)
+// fills one of N aligned buffers and hands it to a flush thread, which
+// writes it through a LogBackend into preallocated, size-rotated segments.
+// The producer never waits on disk: with every buffer in flight, messages
+// are dropped and counted.
 class BinaryLogger {
 private:
-    MessageBuffer buffer_a_;
-    MessageBuffer buffer_b_;
-    MessageBuffer* write_buffer_;
-    MessageBuffer* flush_buffer_;
+    LoggerConfig config_;
+    std::vector<MessageBuffer> buffers_;
+    std::unique_ptr<LogBackend> backend_;
+    
+    // Producer side.
+    MessageBuffer* write_buffer_ = nullptr;
+    uint64_t write_seq_ = 0;
     
-    std::atomic<bool> flush_pending_{false};
+    // Buffers handed off by the producer / fully written by the flusher.
+    alignas(64) std::atomic<uint64_t> handed_off_{0};
+    alignas(64) std::atomic<uint64_t> recycled_{0};
+    alignas(64) std::atomic<uint64_t> wake_seq_{0};
     std::atomic<bool> running_{false};
     std::thread flush_thread_;
     
+    // Flush-thread side.
     int fd_ = -1;
+    bool direct_ = false;
+    uint64_t segment_index_ = 0;
+    uint64_t segment_offset_ = 0;
+    uint64_t segment_end_ = 0;
+    std::vector<uint8_t> completed_;
+    std::vector<LogCompletion> reaped_;
     
     std::atomic<uint64_t> messages_logged_{0};
+    std::atomic<uint64_t> messages_dropped_{0};
     std::atomic<uint64_t> bytes_written_{0};
     std::atomic<uint64_t> flushes_completed_{0};
+    std::atomic<uint64_t> write_errors_{0};
+    std::atomic<uint64_t> segments_opened_{0};
     
 public:
-    explicit BinaryLogger(const char* filename) {
-        fd_ = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd_ < 0) {
-            fd_ = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        }
-        
-        FileHeader header = FileHeader::create();
-        if (fd_ >= 0) {
-            ::write(fd_, &header, sizeof(header));
-        }
-        
-        write_buffer_ = &buffer_a_;
-        flush_buffer_ = &buffer_b_;
+    explicit BinaryLogger(const char* filename) : BinaryLogger(LoggerConfig{filename}) {}
+    
+    explicit BinaryLogger(LoggerConfig config, std::unique_ptr<LogBackend> backend = nullptr)
+        : config_(std::move(config)),
+          buffers_(std::max<size_t>(config_.buffer_count, 2)),
+          backend_(std::move(backend)),
+          completed_(buffers_.size(), 0),
+          reaped_(buffers_.size()) {
+        if (!backend_) backend_ = make_default_backend();
+        open_segment();
+        acquire_buffer();
         
         running_ = true;
         flush_thread_ = std::thread(&BinaryLogger::flush_thread_func, this);
     }
     
     ~BinaryLogger() {
-        if (write_buffer_->count > 0) {
-            flush_sync();
+        if (write_buffer_ != nullptr && write_buffer_->count > 0) {
+            hand_off();
         }
         
-        running_ = false;
-        flush_pending_ = true;
+        running_.store(false, std::memory_order_release);
+        wake_flusher();
         if (flush_thread_.joinable()) {
             flush_thread_.join();
         }
-        
-        if (fd_ >= 0) {
-            ::fsync(fd_);
-            ::close(fd_);
-        }
+        close_segment();
     }
     
     BinaryLogger(const BinaryLogger&) = delete;
     BinaryLogger& operator=(const BinaryLogger&) = delete;
     
     void log(const OutputMsg& msg) noexcept {
+        if (write_buffer_ == nullptr && !acquire_buffer()) [[unlikely]] {
+            messages_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
         write_buffer_->data[write_buffer_->count++] = msg;
         messages_logged_.fetch_add(1, std::memory_order_relaxed);
         
         if (write_buffer_->is_full()) [[unlikely]] {
-            trigger_flush();
+            hand_off();
         }
     }
     
     void log_batch(const OutputMsg* msgs, size_t count) noexcept {
         while (count > 0) {
+            if (write_buffer_ == nullptr && !acquire_buffer()) [[unlikely]] {
+                messages_dropped_.fetch_add(count, std::memory_order_relaxed);
+                return;
+            }
             size_t space = write_buffer_->remaining();
             size_t to_copy = (count < space) ? count : space;
             
@@ -133,7 +286,7 @@ public:
             messages_logged_.fetch_add(to_copy, std::memory_order_relaxed);
             
             if (write_buffer_->is_full()) [[unlikely]] {
-                trigger_flush();
+                hand_off();
             }
         }
     }
@@ -142,6 +295,10 @@ public:
         return messages_logged_.load(std::memory_order_relaxed); 
     }
     
+    uint64_t messages_dropped() const { 
+        return messages_dropped_.load(std::memory_order_relaxed); 
+    }
+    
     uint64_t bytes_written() const { 
         return bytes_written_.load(std::memory_order_relaxed); 
     }
@@ -150,60 +307,177 @@ public:
         return flushes_completed_.load(std::memory_order_relaxed); 
     }
     
+    uint64_t write_errors() const { 
+        return write_errors_.load(std::memory_order_relaxed); 
+    }
+    
+    uint64_t segments_opened() const { 
+        return segments_opened_.load(std::memory_order_relaxed); 
+    }
+    
     size_t buffer_usage() const {
-        return write_buffer_->count;
+        return write_buffer_ ? write_buffer_->count : 0;
     }
     
 private:
-    void trigger_flush() {
-        while (flush_pending_.load(std::memory_order_acquire)) {
-            std::this_thread::yield();
+    std::unique_ptr<LogBackend> make_default_backend() {
+#if defined(__linux__) && defined(LOGGER_IO_URING)
+        auto uring = std::make_unique<UringBackend>(static_cast<unsigned>(buffers_.size()));
+        if (uring->ok()) return uring;
+#endif
+        return std::make_unique<PwriteBackend>();
+    }
+    
+    bool acquire_buffer() {
+        if (write_seq_ - recycled_.load(std::memory_order_acquire) >= buffers_.size()) {
+            return false;
+        }
+        write_buffer_ = &buffers_[write_seq_ % buffers_.size()];
+        write_buffer_->reset();
+        return true;
+    }
+    
+    void hand_off() {
+        handed_off_.store(++write_seq_, std::memory_order_release);
+        wake_flusher();
+        write_buffer_ = nullptr;
+        acquire_buffer();
+    }
+    
+    void wake_flusher() {
+        wake_seq_.fetch_add(1, std::memory_order_release);
+        wake_seq_.notify_one();
+    }
+    
+    std::string segment_path() const {
+        if (config_.segment_bytes == 0) return config_.path;
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".%06llu",
+                      static_cast<unsigned long long>(segment_index_));
+        return config_.path + suffix;
+    }
+    
+    uint64_t data_offset() const {
+        return direct_ ? DIRECT_IO_ALIGNMENT : sizeof(FileHeader);
+    }
+    
+    void open_segment() {
+        std::string path = segment_path();
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        direct_ = false;
+#ifdef O_DIRECT
+        if (config_.direct_io) {
+            fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            direct_ = fd_ >= 0;
+        }
+#endif
+        if (!direct_) fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0) {
+            std::cerr << "[Logger] Cannot open " << path << std::endl;
+            return;
+        }
+        if (config_.segment_bytes > 0) {
+            ::posix_fallocate(fd_, 0, static_cast<off_t>(config_.segment_bytes));
         }
         
-        std::swap(write_buffer_, flush_buffer_);
-        
-        flush_pending_.store(true, std::memory_order_release);
+        FileHeader header = FileHeader::create();
+        header.data_offset = data_offset();
+        header.segment_index = segment_index_;
+        // The header block goes through the same fd, so it obeys the same
+        // alignment as the data: a whole block under O_DIRECT.
+        alignas(DIRECT_IO_ALIGNMENT) static thread_local uint8_t block[DIRECT_IO_ALIGNMENT];
+        std::memset(block, 0, sizeof(block));
+        std::memcpy(block, &header, sizeof(header));
+        size_t len = static_cast<size_t>(header.data_offset);
+        if (::pwrite(fd_, block, len, 0) != static_cast<ssize_t>(len)) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        segment_offset_ = segment_end_ = len;
+        segments_opened_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    void close_segment() {
+        if (fd_ < 0) return;
+        // Drops the preallocated tail and any O_DIRECT padding.
+        if (::ftruncate(fd_, static_cast<off_t>(segment_end_)) != 0) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        ::fdatasync(fd_);
+        ::close(fd_);
+        fd_ = -1;
     }
     
-    void flush_sync() {
-        if (write_buffer_->count == 0) return;
+    void submit_buffer(uint64_t seq) {
+        MessageBuffer& buffer = buffers_[seq % buffers_.size()];
+        size_t bytes = buffer.count * sizeof(OutputMsg);
+        size_t len = bytes;
+        if (direct_ && len % DIRECT_IO_ALIGNMENT != 0) {
+            // Only the final, partial buffer gets here; pad it to a block.
+            len = (len + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+            std::memset(reinterpret_cast<uint8_t*>(buffer.data.get()) + bytes, 0, len - bytes);
+        }
         
-        while (flush_pending_.load(std::memory_order_acquire)) {
-            std::this_thread::yield();
+        if (config_.segment_bytes > 0 && segment_offset_ > data_offset() &&
+            segment_offset_ + len > config_.segment_bytes) {
+            // Writes in flight still target this fd; let them land first.
+            while (backend_->in_flight() > 0) reap(1);
+            close_segment();
+            ++segment_index_;
+            open_segment();
         }
         
-        size_t bytes = write_buffer_->count * sizeof(OutputMsg);
-        if (fd_ >= 0) {
-            ::write(fd_, write_buffer_->data.get(), bytes);
-            bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+        if (fd_ < 0 || !backend_->submit(fd_, buffer.data.get(), len, segment_offset_, seq)) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            complete(seq);
+            return;
+        }
+        segment_offset_ += len;
+        segment_end_ = segment_offset_ - (len - bytes);
+        bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    
+    // Buffers are recycled in order, so a write that finishes early waits
+    // for the ones before it.
+    void complete(uint64_t seq) {
+        completed_[seq % completed_.size()] = 1;
+        uint64_t r = recycled_.load(std::memory_order_relaxed);
+        while (r < write_seq_limit() && completed_[r % completed_.size()]) {
+            completed_[r % completed_.size()] = 0;
+            ++r;
+        }
+        recycled_.store(r, std::memory_order_release);
+        flushes_completed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    uint64_t write_seq_limit() const { return handed_off_.load(std::memory_order_acquire); }
+    
+    void reap(size_t min_complete) {
+        size_t n = backend_->reap(min_complete, reaped_.data(), reaped_.size());
+        for (size_t i = 0; i < n; ++i) {
+            if (reaped_[i].result < 0) write_errors_.fetch_add(1, std::memory_order_relaxed);
+            complete(reaped_[i].tag);
         }
-        write_buffer_->reset();
     }
     
     void flush_thread_func() {
-        while (running_.load(std::memory_order_relaxed)) {
-            if (!flush_pending_.load(std::memory_order_acquire)) {
-                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        uint64_t next_submit = 0;
+        while (true) {
+            uint64_t wake = wake_seq_.load(std::memory_order_acquire);
+            uint64_t ready = handed_off_.load(std::memory_order_acquire);
+            bool submitted = next_submit < ready;
+            while (next_submit < ready) submit_buffer(next_submit++);
+            
+            if (backend_->in_flight() > 0) {
+                // New buffers arriving meanwhile are picked up on the next
+                // completion.
+                reap(submitted ? 0 : 1);
                 continue;
             }
-            
-            if (flush_buffer_->count > 0 && fd_ >= 0) {
-                size_t bytes = flush_buffer_->count * sizeof(OutputMsg);
-                ssize_t written = ::write(fd_, flush_buffer_->data.get(), bytes);
-                if (written > 0) {
-                    bytes_written_.fetch_add(static_cast<size_t>(written), std::memory_order_relaxed);
-                }
-                flush_buffer_->reset();
-                flushes_completed_.fetch_add(1, std::memory_order_relaxed);
+            if (!running_.load(std::memory_order_acquire) &&
+                next_submit == handed_off_.load(std::memory_order_acquire)) {
+                break;
             }
-            
-            flush_pending_.store(false, std::memory_order_release);
-        }
-        
-        if (flush_buffer_->count > 0 && fd_ >= 0) {
-            size_t bytes = flush_buffer_->count * sizeof(OutputMsg);
-            ::write(fd_, flush_buffer_->data.get(), bytes);
-            bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+            if (!submitted) wake_seq_.wait(wake, std::memory_order_acquire);
         }
     }
 };
@@ -222,6 +496,8 @@ public:
             if (n != sizeof(header_) || !header_.is_valid()) {
                 ::close(fd_);
                 fd_ = -1;
+            } else {
+                ::lseek(fd_, static_cast<off_t>(header_.first_message_offset()), SEEK_SET);
             }
         }
     }
@@ -258,7 +534,7 @@ public:
     
     void rewind() {
         if (fd_ >= 0) {
-            ::lseek(fd_, sizeof(FileHeader), SEEK_SET);
+            ::lseek(fd_, static_cast<off_t>(header_.first_message_offset()), SEEK_SET);
             messages_read_ = 0;
         }
     }
@@ -9,21 +9,97 @@
 #include <fcntl.h>
 #include <cstring>
 #include <arpa/inet.h>
-#include <fstream>
 #include <chrono>
 #include <memory>
 
 #include "protocol.h"
 #include "order_book.h"
 #include "titan_ws_server.h"
+#include "thread_utils.h"
+#include "ring_buffer.h"
+#include "replay_reader.h"
+#include "output_publisher.h"
+#include "market_data_feed.h"
 
 #define BRIDGE_PORT 9000
 #define DASHBOARD_PORT 8080
 #define BROADCAST_INTERVAL_MS 50
+#define STATS_INTERVAL_MS 1000
+#define SNAPSHOT_DEPTH 10
+#define REPLAY_CHUNK_BYTES (64 * 1024)
+
+// -DWS_BINARY_BOOK sends book frames as binary snapshots and deltas (see
+// DashBookHeader) instead of JSON; a full snapshot every DASH_SNAPSHOT_EVERY
+// frames bounds how long a dashboard that lost a delta stays stale.
+#define DASH_SNAPSHOT_EVERY 20
+
+// Each snapshot supersedes the last, so a slow dashboard only ever holds
+// the newest one of each kind in its send queue.
+constexpr uint8_t WS_CONFLATE_BOOK = 1;
+constexpr uint8_t WS_CONFLATE_STATS = 2;
+
+// Replay and the pipelined live mode touch the book from one thread only,
+// so it is built without locks; plain live mode keeps them for the
+// broadcaster's snapshots.
+#if defined(REPLAY_MODE) || defined(PIPELINE)
+using EngineBook = BasicOrderBook<SingleThreadBookPolicy>;
+#else
+using EngineBook = OptimizedOrderBook;
+#endif
+
+// Live-mode tuning. -DBUSY_POLL spins on recv instead of sleeping when the
+// socket is empty; -DMATCH_CORE=n pins the ingest+match thread to core n;
+// -DSO_BUSY_POLL_US=n enables kernel busy polling on the bridge socket.
+#ifndef MATCH_CORE
+#define MATCH_CORE -1
+#endif
+#ifndef SO_BUSY_POLL_US
+#define SO_BUSY_POLL_US 0
+#endif
+#define IDLE_SLEEP_US 100
+
+// -DPIPELINE splits live mode into stages: the recv thread (-DINGEST_CORE=n)
+// only frames bridge messages into an SPSC ring of InputSlots, and a
+// matching thread (MATCH_CORE) applies them in batches and hands depth
+// snapshots to the broadcaster on request, so nothing else reads the book.
+#ifndef INGEST_CORE
+#define INGEST_CORE -1
+#endif
+#define PIPELINE_QUEUE_SIZE (1 << 16)
+#define PIPELINE_BATCH 64
+
+// Engine output is drained by a publisher thread (-DPUBLISHER_CORE=n pins
+// it) and fanned out to the dashboard and, with -DLOG_FILE=\"path\", to a
+// binary log.
+#ifndef PUBLISHER_CORE
+#define PUBLISHER_CORE -1
+#endif
+
+// Book tables are arena-mapped on huge pages where available
+// (-DARENA_NO_HUGEPAGES keeps 4 KB pages) and prefer MATCH_CORE's NUMA
+// node. -DARENA_PREFAULT faults them in on a background thread at startup
+// instead of on first touch.
+#ifdef ARENA_NO_HUGEPAGES
+#define ARENA_HUGE_PAGES false
+#else
+#define ARENA_HUGE_PAGES true
+#endif
+
+// -DMD_FEED_GROUP=\"239.1.1.1\" also publishes the sequenced binary feed
+// to that group, with gap recovery over TCP on MD_RECOVERY_PORT.
+#ifndef MD_FEED_PORT
+#define MD_FEED_PORT 15000
+#endif
+#ifndef MD_RECOVERY_PORT
+#define MD_RECOVERY_PORT 15001
+#endif
 
 std::atomic<bool> running(true);
 void signal_handler(int) { running = false; }
 
+std::atomic<bool> bridge_connected(false);
+std::atomic<uint64_t> live_msg_count(0);
+
 int setup_tcp_server() {
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) { perror("Socket creation failed"); exit(1); }
@@ -51,12 +127,69 @@ int setup_tcp_server() {
     return sockfd;
 }
 
-std::string build_book_snapshot(OptimizedOrderBook& book) {
-    JsonBuilder json;
+// Displayed depth, captured by whichever thread may read the book and
+// encoded by the broadcaster.
+struct BookView {
+    DepthLevel levels[2][SNAPSHOT_DEPTH];
+    size_t counts[2];
+    TopOfBook top;
+};
+
+void capture_book(const EngineBook& book, BookView& view) {
+    view.counts[0] = book.get_depth(Side::BUY, SNAPSHOT_DEPTH, view.levels[0]);
+    view.counts[1] = book.get_depth(Side::SELL, SNAPSHOT_DEPTH, view.levels[1]);
+    view.top = book.top_of_book();
+}
 
-    auto bids = book.get_bids_snapshot();
-    auto asks = book.get_asks_snapshot();
-    
+#ifdef PIPELINE
+// Copies each complete message in buf[0, len) into its own InputSlot, with
+// process_batch's contract: stops at an incomplete or malformed message and
+// returns the bytes consumed. Slots are published a batch at a time; while
+// the matcher is behind this spins rather than drop input.
+template<typename Ring>
+size_t frame_into(Ring& ring, const uint8_t* buf, size_t len, size_t* messages) {
+    InputSlot slots[PIPELINE_BATCH];
+    size_t pending = 0;
+    size_t offset = 0;
+    size_t total = 0;
+
+    auto publish = [&] {
+        size_t pushed = 0;
+        while (pushed < pending) {
+            pushed += ring.push_batch(slots + pushed, pending - pushed);
+            if (pushed < pending) cpu_relax();
+        }
+        total += pending;
+        pending = 0;
+    };
+
+    while (offset + sizeof(MsgHeader) <= len) {
+        const MsgHeader* header = reinterpret_cast<const MsgHeader*>(buf + offset);
+        uint16_t length = header->length;
+        if (length < sizeof(MsgHeader) || length > MAX_INPUT_MSG_SIZE ||
+            length > len - offset || length < message_size(header->type)) break;
+
+        InputSlot& slot = slots[pending++];
+        slot.length = length;
+        std::memcpy(slot.data, buf + offset, length);
+        offset += length;
+        if (pending == PIPELINE_BATCH) publish();
+    }
+    publish();
+
+    *messages = total;
+    return offset;
+}
+#endif
+
+std::string_view build_book_snapshot(const BookView& view, JsonBuilder& json) {
+    const DepthLevel* bids = view.levels[0];
+    const DepthLevel* asks = view.levels[1];
+    size_t bid_count = view.counts[0];
+    size_t ask_count = view.counts[1];
+    const TopOfBook& top = view.top;
+
+    json.clear();
     json.begin_object();
 
     json.key("type").value("book_snapshot");
@@ -66,170 +199,303 @@ std::string build_book_snapshot(OptimizedOrderBook& book) {
         ).count()
     ));
 
-    json.key("best_bid").value(book.get_best_bid());
-    json.key("best_ask").value(book.get_best_ask());
+    json.key("best_bid").value(top.best_bid >= 0 ? top.best_bid : int64_t{0});
+    json.key("best_ask").value(top.best_ask);
 
-    json.key("bid_levels").value(static_cast<int64_t>(book.bid_levels()));
-    json.key("ask_levels").value(static_cast<int64_t>(book.ask_levels()));
-    json.key("order_count").value(static_cast<int64_t>(book.order_count()));
-    json.key("trades_executed").value(static_cast<int64_t>(book.trades_executed()));
+    json.key("bid_levels").value(static_cast<int64_t>(top.bid_levels));
+    json.key("ask_levels").value(static_cast<int64_t>(top.ask_levels));
+    json.key("order_count").value(static_cast<int64_t>(top.order_count));
+    json.key("trades_executed").value(static_cast<int64_t>(top.trades_executed));
 
     json.key("bids").begin_array();
-    int count = 0;
-    for (const auto& [price, volume] : bids) {
-        if (count++ >= 10) break;
+    for (size_t i = 0; i < bid_count; ++i) {
         json.array_item().begin_array();
-        json.array_item().value(price);
-        json.array_item().value(volume);
+        json.array_item().value(bids[i].price);
+        json.array_item().value(bids[i].volume);
         json.end_array();
     }
     json.end_array();
 
     json.key("asks").begin_array();
-    count = 0;
-    for (const auto& [price, volume] : asks) {
-        if (count++ >= 10) break;
+    for (size_t i = 0; i < ask_count; ++i) {
         json.array_item().begin_array();
-        json.array_item().value(price);
-        json.array_item().value(volume);
+        json.array_item().value(asks[i].price);
+        json.array_item().value(asks[i].volume);
         json.end_array();
     }
     json.end_array();
     
     json.end_object();
     
-    return json.str();
+    return json.view();
 }
 
-void dispatch_message(OptimizedOrderBook& book, const uint8_t* buffer, size_t len) {
-    if (len < sizeof(MsgHeader)) return;
-    
-    const MsgHeader* header = reinterpret_cast<const MsgHeader*>(buffer);
-    
-    switch (header->type) {
-        case MsgType::ADD_ORDER: {
-            if (len < sizeof(MsgAddOrder)) return;
-            const MsgAddOrder* msg = msg_cast<MsgAddOrder>(buffer);
-            book.add_order(
-                msg->order_id,
-                msg->side == Side::BUY,
-                msg->price,
-                msg->quantity,
-                static_cast<uint32_t>(msg->user_id)
-            );
-            break;
-        }
-        case MsgType::CANCEL_ORDER: {
-            if (len < sizeof(MsgCancel)) return;
-            const MsgCancel* msg = msg_cast<MsgCancel>(buffer);
-            book.cancel_order(msg->order_id);
-            break;
+#ifdef WS_BINARY_BOOK
+// Book frames as DashBookHeader + DashLevel records (protocol.h). Deltas
+// are merged against the previous frame's depth, which both sides keep in
+// best-first order. A snapshot goes out every DASH_SNAPSHOT_EVERY frames
+// and whenever a dashboard connects; the dashboard ignores deltas until it
+// holds one.
+class DashBookEncoder {
+    static constexpr size_t MAX_LEVELS = 4 * SNAPSHOT_DEPTH;
+
+    alignas(8) uint8_t buffer_[sizeof(DashBookHeader) + MAX_LEVELS * sizeof(DashLevel)];
+    DepthLevel prev_[2][SNAPSHOT_DEPTH];
+    size_t prev_count_[2] = {0, 0};
+    uint64_t sequence_ = 0;
+    size_t since_snapshot_ = 0;
+    size_t last_clients_ = 0;
+
+    static bool better(size_t side, int64_t a, int64_t b) { return side == 0 ? a > b : a < b; }
+
+    size_t delta(size_t side, const DepthLevel* cur, size_t count, DashLevel* out) {
+        const DepthLevel* prev = prev_[side];
+        size_t prev_count = prev_count_[side];
+        size_t i = 0, j = 0, n = 0;
+        while (i < prev_count || j < count) {
+            if (j == count || (i < prev_count && better(side, prev[i].price, cur[j].price))) {
+                out[n++] = {prev[i++].price, 0};
+            } else if (i == prev_count || better(side, cur[j].price, prev[i].price)) {
+                out[n++] = {cur[j].price, cur[j].volume};
+                ++j;
+            } else {
+                if (prev[i].volume != cur[j].volume) out[n++] = {cur[j].price, cur[j].volume};
+                ++i;
+                ++j;
+            }
         }
-        case MsgType::MODIFY_ORDER: {
-            if (len < sizeof(MsgModify)) return;
-            const MsgModify* msg = msg_cast<MsgModify>(buffer);
+        return n;
+    }
 
-            book.cancel_order(msg->order_id);
-            break;
+public:
+    std::string_view encode(const BookView& view, size_t clients, bool& snapshot) {
+        const auto& levels = view.levels;
+        const size_t* counts = view.counts;
+        const TopOfBook& top = view.top;
+
+        snapshot = sequence_ == 0 || clients > last_clients_ || ++since_snapshot_ >= DASH_SNAPSHOT_EVERY;
+        if (snapshot) since_snapshot_ = 0;
+        last_clients_ = clients;
+
+        DashLevel* out = reinterpret_cast<DashLevel*>(buffer_ + sizeof(DashBookHeader));
+        size_t written[2];
+        for (size_t side = 0; side < 2; ++side) {
+            if (snapshot) {
+                for (size_t i = 0; i < counts[side]; ++i) {
+                    out[i] = {levels[side][i].price, levels[side][i].volume};
+                }
+                written[side] = counts[side];
+            } else {
+                written[side] = delta(side, levels[side], counts[side], out);
+            }
+            out += written[side];
+            std::memcpy(prev_[side], levels[side], counts[side] * sizeof(DepthLevel));
+            prev_count_[side] = counts[side];
         }
-        case MsgType::HEARTBEAT:
 
-            break;
-        case MsgType::RESET:
+        DashBookHeader& header = *reinterpret_cast<DashBookHeader*>(buffer_);
+        header = {};
+        header.kind = snapshot ? DashFrameKind::SNAPSHOT : DashFrameKind::DELTA;
+        header.bid_count = static_cast<uint16_t>(written[0]);
+        header.ask_count = static_cast<uint16_t>(written[1]);
+        header.sequence = ++sequence_;
+        header.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        header.best_bid = top.best_bid >= 0 ? top.best_bid : 0;
+        header.best_ask = top.best_ask;
+        header.order_count = top.order_count;
+        header.bid_levels = top.bid_levels;
+        header.ask_levels = top.ask_levels;
+        header.trades_executed = top.trades_executed;
+
+        size_t bytes = reinterpret_cast<uint8_t*>(out) - buffer_;
+        return {reinterpret_cast<const char*>(buffer_), bytes};
+    }
+};
+#endif
 
-            break;
-        default:
+// Per-thread scratch for dashboard frames, reused every tick.
+struct DashFrames {
+    BookView view;
+    JsonBuilder json;
+#ifdef WS_BINARY_BOOK
+    DashBookEncoder book;
+#endif
+};
+
+// Only snapshots are conflated: a delta replaced in a client's queue would
+// leave a hole the dashboard cannot detect past.
+void broadcast_book(TitanWebSocketServer& ws, DashFrames& frames) {
+#ifdef WS_BINARY_BOOK
+    bool snapshot = false;
+    std::string_view frame = frames.book.encode(frames.view, ws.client_count(), snapshot);
+    ws.broadcast_binary(frame, snapshot ? WS_CONFLATE_BOOK : TitanWebSocketServer::NO_CONFLATION);
+#else
+    ws.broadcast(build_book_snapshot(frames.view, frames.json), WS_CONFLATE_BOOK);
+#endif
+}
 
-            break;
+// Engine telemetry as an "engine_stats" frame. Reads only the telemetry
+// counters, so it never contends with matching for the book lock.
+std::string_view build_stats_frame(const EngineBook& book, JsonBuilder& json) {
+    const EngineTelemetry& t = book.telemetry();
+    const double ns_per_tick = 1.0 / telemetry_ticks_per_ns();
+    auto ns = [&](uint64_t ticks) { return static_cast<int64_t>(ticks * ns_per_tick); };
+    TopOfBook top = book.top_of_book();
+
+    json.clear();
+    json.begin_object();
+    json.key("type").value("engine_stats");
+    json.key("timestamp").value(static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count()
+    ));
+    json.key("messages_processed").value(top.messages_processed);
+    json.key("trades_executed").value(top.trades_executed);
+    json.key("messages_dropped").value(top.messages_dropped);
+    json.key("sample_every").value(EngineTelemetry::SAMPLE_MASK + 1);
+
+    json.key("ops").begin_object();
+    for (size_t i = 0; i < EngineTelemetry::OP_COUNT; ++i) {
+        const TelemetryHistogram& h = t.op_latency[i];
+        json.key(book_op_name(static_cast<BookOp>(i))).begin_object();
+        json.key("count").value(t.op_count[i].load());
+        json.key("sampled").value(h.count());
+        json.key("p50_ns").value(ns(h.percentile(50)));
+        json.key("p99_ns").value(ns(h.percentile(99)));
+        json.key("p999_ns").value(ns(h.percentile(99.9)));
+        json.key("max_ns").value(ns(h.max()));
+        json.end_object();
     }
-}
+    json.end_object();
 
-void dispatch_message_no_lock(OptimizedOrderBook& book, const uint8_t* buffer, size_t len) {
-    if (len < sizeof(MsgHeader)) return;
-    
-    const MsgHeader* header = reinterpret_cast<const MsgHeader*>(buffer);
-    
-    switch (header->type) {
-        case MsgType::ADD_ORDER: {
-            if (len < sizeof(MsgAddOrder)) return;
-            const MsgAddOrder* msg = msg_cast<MsgAddOrder>(buffer);
-            book.add_order_no_lock(
-                msg->order_id,
-                msg->side == Side::BUY,
-                msg->price,
-                msg->quantity,
-                static_cast<uint32_t>(msg->user_id)
-            );
-            break;
-        }
-        case MsgType::CANCEL_ORDER: {
-            if (len < sizeof(MsgCancel)) return;
-            const MsgCancel* msg = msg_cast<MsgCancel>(buffer);
-            book.cancel_order_no_lock(msg->order_id);
-            break;
-        }
-        default:
-            break;
+    json.key("levels_swept").begin_array();
+    for (size_t i = 0; i < EngineTelemetry::SWEEP_BUCKETS; ++i) {
+        json.array_item().value(t.levels_swept[i].load());
     }
+    json.end_array();
+    json.key("max_levels_swept").value(t.max_levels_swept.load());
+
+    json.key("rescan_ticks").begin_object();
+    json.key("count").value(t.rescan_distance.count());
+    json.key("p50").value(t.rescan_distance.percentile(50));
+    json.key("p99").value(t.rescan_distance.percentile(99));
+    json.key("max").value(t.rescan_distance.max());
+    json.end_object();
+
+    json.key("pool").begin_object();
+    json.key("used").value(t.pool_used.load());
+    json.key("high_water").value(t.pool_high_water.load());
+    json.key("capacity").value(t.pool_capacity.load());
+    json.end_object();
+
+    json.key("output_ring").begin_object();
+    json.key("used").value(t.output_ring_used.load());
+    json.key("high_water").value(t.output_ring_high_water.load());
+    json.key("capacity").value(static_cast<uint64_t>(OutputBuffer::capacity()));
+    json.end_object();
+
+    json.end_object();
+    return json.view();
 }
 
 int main() {
     signal(SIGINT, signal_handler);
 
-    std::cout << "[TITAN] Allocating order book on heap..." << std::endl;
-    auto book = std::make_unique<OptimizedOrderBook>(33554432);
-    std::cout << "[TITAN] Order book allocated successfully." << std::endl;
+    std::cout << "[TITAN] Mapping order book..." << std::endl;
+    ArenaConfig arena;
+    arena.numa_node = numa_node_of_core(MATCH_CORE);
+    arena.huge_pages = ARENA_HUGE_PAGES;
+    auto book = std::make_unique<EngineBook>(33554432, PRICE_OFFSET, nullptr,
+                                             OrderIndexMode::DIRECT, arena);
+    ArenaUsage usage = book->arena_usage();
+    std::cout << "[TITAN] Order book mapped: " << (usage.mapped_bytes >> 20) << " MB, "
+              << (usage.hugetlb_bytes >> 20) << " MB on explicit huge pages";
+    if (arena.numa_node >= 0) std::cout << ", NUMA node " << arena.numa_node;
+    std::cout << std::endl;
+#ifdef ARENA_PREFAULT
+    book->prefault_async();
+    std::cout << "[TITAN] Prefaulting book tables in the background" << std::endl;
+#endif
+    if (EngineBook::policy_type::TELEMETRY) telemetry_ticks_per_ns();
 
     TitanWebSocketServer ws_server(DASHBOARD_PORT);
     ws_server.start();
     std::cout << "[TITAN] Dashboard WebSocket server started on port " << DASHBOARD_PORT << std::endl;
 
+    WebSocketTradeSink trade_sink(ws_server, BROADCAST_INTERVAL_MS);
+#ifdef LOG_FILE
+    deepflow::BinaryLogger logger(LOG_FILE);
+    LoggerSink log_sink(logger);
+#endif
+#ifdef MD_FEED_GROUP
+    MarketDataFeed md_feed(MD_FEED_GROUP, MD_FEED_PORT, MD_RECOVERY_PORT);
+    md_feed.start();
+#endif
+#ifdef BUSY_POLL
+    OutputPublisher publisher(*book, PUBLISHER_CORE, 0);
+#else
+    OutputPublisher publisher(*book, PUBLISHER_CORE, IDLE_SLEEP_US);
+#endif
+    publisher.add_sink(trade_sink);
+#ifdef LOG_FILE
+    publisher.add_sink(log_sink);
+    std::cout << "[TITAN] Logging engine output to " << LOG_FILE << std::endl;
+#endif
+#ifdef MD_FEED_GROUP
+    publisher.add_sink(md_feed);
+    std::cout << "[TITAN] Market data feed on " << MD_FEED_GROUP << ":" << MD_FEED_PORT
+              << ", recovery on port " << MD_RECOVERY_PORT << std::endl;
+#endif
+    publisher.start();
+
 #ifdef REPLAY_MODE
 
     std::cout << "[TITAN] Starting Replay Mode: " << REPLAY_MODE << std::endl;
-    std::ifstream file(REPLAY_MODE, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) { 
+    ReplayReader capture(REPLAY_MODE, false);
+    if (!capture.is_open()) { 
         std::cerr << "File not found: " << REPLAY_MODE << std::endl; 
         return 1; 
     }
     
-    std::streamsize file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    std::vector<uint8_t> data(file_size);
-    file.read(reinterpret_cast<char*>(data.data()), file_size);
-    file.close();
-    
-    std::cout << "[TITAN] Loaded " << file_size << " bytes. Parsing messages..." << std::endl;
+    std::cout << "[TITAN] Mapped " << capture.size() << " bytes. Parsing messages..." << std::endl;
 
     auto start = std::chrono::high_resolution_clock::now();
     auto last_broadcast = start;
+    auto last_stats = start;
+    DashFrames frames;
     
     size_t offset = 0;
     size_t msg_count = 0;
     
-    while (offset < data.size() && running) {
+    while (running && offset < capture.size()) {
 
-        if (offset + sizeof(MsgHeader) > data.size()) break;
-        
-        const MsgHeader* header = reinterpret_cast<const MsgHeader*>(data.data() + offset);
-        uint16_t msg_len = header->length;
-        
-        if (msg_len == 0 || offset + msg_len > data.size()) break;
-        
-        dispatch_message_no_lock(*book, data.data() + offset, msg_len);
+        size_t chunk = std::min<size_t>(REPLAY_CHUNK_BYTES, capture.size() - offset);
+        size_t applied = 0;
+        size_t consumed = book->process_batch_no_lock(capture.data() + offset, chunk, &applied);
+        if (consumed == 0) {
+            std::cerr << "[TITAN] Malformed message at offset " << offset << std::endl;
+            break;
+        }
         
-        offset += msg_len;
-        msg_count++;
+        offset += consumed;
+        msg_count += applied;
 
         auto now = std::chrono::high_resolution_clock::now();
         if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_broadcast).count() >= BROADCAST_INTERVAL_MS) {
-            std::string json = build_book_snapshot(*book);
-            ws_server.broadcast(json);
+            capture_book(*book, frames.view);
+            broadcast_book(ws_server, frames);
             last_broadcast = now;
         }
+        if (EngineBook::policy_type::TELEMETRY &&
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - last_stats).count() >= STATS_INTERVAL_MS) {
+            ws_server.broadcast(build_stats_frame(*book, frames.json), WS_CONFLATE_STATS);
+            last_stats = now;
+        }
     }
     
+    book->flush_output_buffer();
     auto end = std::chrono::high_resolution_clock::now();
     double ms = std::chrono::duration<double, std::milli>(end - start).count();
     
@@ -238,6 +504,96 @@ int main() {
 
 #else
 
+#ifdef PIPELINE
+    using IngestRing = RingBuffer<InputSlot, PIPELINE_QUEUE_SIZE>;
+    auto ingest = std::make_unique<IngestRing>();
+    auto views = std::make_unique<RingBuffer<BookView, 2>>();
+    std::atomic<bool> view_requested(false);
+
+    // Sole owner of the book. A requested snapshot is taken between
+    // batches, so it always reflects whole messages.
+    std::thread matcher([&]() {
+        if (MATCH_CORE >= 0 && !pin_thread_to_core(MATCH_CORE)) {
+            std::cerr << "[TITAN] Failed to pin matcher to core " << MATCH_CORE << std::endl;
+        }
+        InputSlot batch[PIPELINE_BATCH];
+        BookView view;
+        while (true) {
+            size_t n = ingest->pop_batch(batch, PIPELINE_BATCH);
+            if (n > 0) book->process_messages(batch, n);
+            if (view_requested.load(std::memory_order_acquire)) [[unlikely]] {
+                capture_book(*book, view);
+                if (views->try_push(view)) view_requested.store(false, std::memory_order_relaxed);
+            }
+            if (n == 0) {
+                if (!running.load(std::memory_order_acquire)) break;
+                cpu_relax();
+            }
+        }
+    });
+#endif
+
+    // Snapshots and dashboard I/O run here so they never stall matching;
+    // the book getters take the shared lock against the locking dispatch,
+    // or in pipeline mode the matcher captures the depth for us.
+    std::thread broadcaster([&]() {
+        auto next = std::chrono::steady_clock::now();
+        auto next_stats = next;
+        uint64_t last_count = 0;
+        DashFrames frames;
+        while (running) {
+            next += std::chrono::milliseconds(BROADCAST_INTERVAL_MS);
+            std::this_thread::sleep_until(next);
+
+#ifdef PIPELINE
+            view_requested.store(true, std::memory_order_release);
+            bool have_view = false;
+            while (running && !(have_view = views->try_pop(frames.view))) {
+                std::this_thread::sleep_for(std::chrono::microseconds(IDLE_SLEEP_US));
+            }
+            if (!have_view) break;
+#else
+            capture_book(*book, frames.view);
+#endif
+            broadcast_book(ws_server, frames);
+            if (EngineBook::policy_type::TELEMETRY && next >= next_stats) {
+                ws_server.broadcast(build_stats_frame(*book, frames.json), WS_CONFLATE_STATS);
+                next_stats = next + std::chrono::milliseconds(STATS_INTERVAL_MS);
+            }
+
+            uint64_t count = live_msg_count.load(std::memory_order_relaxed);
+            if (bridge_connected && count != last_count) {
+                std::cout << "\r[TITAN] Orders: " << count
+                          << " | Bid: " << book->get_best_bid()
+                          << " | Ask: " << book->get_best_ask()
+                          << " | WS Clients: " << ws_server.client_count() << std::flush;
+                last_count = count;
+            }
+        }
+    });
+
+#ifdef PIPELINE
+    std::cout << "[TITAN] Pipeline mode: ingest -> match -> publish on separate threads" << std::endl;
+    if (INGEST_CORE >= 0) {
+        if (pin_thread_to_core(INGEST_CORE)) {
+            std::cout << "[TITAN] Ingest thread pinned to core " << INGEST_CORE << std::endl;
+        } else {
+            std::cerr << "[TITAN] Failed to pin to core " << INGEST_CORE << std::endl;
+        }
+    }
+#else
+    if (MATCH_CORE >= 0) {
+        if (pin_thread_to_core(MATCH_CORE)) {
+            std::cout << "[TITAN] Ingest/match thread pinned to core " << MATCH_CORE << std::endl;
+        } else {
+            std::cerr << "[TITAN] Failed to pin to core " << MATCH_CORE << std::endl;
+        }
+    }
+#endif
+#ifdef BUSY_POLL
+    std::cout << "[TITAN] Busy-poll mode: recv loop never sleeps" << std::endl;
+#endif
+
     int server_fd = setup_tcp_server();
 
     int flags = fcntl(server_fd, F_GETFL, 0);
@@ -250,7 +606,6 @@ int main() {
         socklen_t client_len = sizeof(client_addr);
         int client_fd = -1;
 
-        auto last_broadcast = std::chrono::steady_clock::now();
         while (running && client_fd < 0) {
             client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
             
@@ -259,14 +614,6 @@ int main() {
                     perror("Accept failed");
                     break;
                 }
-
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_broadcast).count() >= BROADCAST_INTERVAL_MS) {
-                    std::string json = build_book_snapshot(*book);
-                    ws_server.broadcast(json);
-                    last_broadcast = now;
-                }
-                
                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
             }
         }
@@ -275,6 +622,14 @@ int main() {
 
         int flag = 1;
         setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+#ifdef SO_BUSY_POLL
+        if (SO_BUSY_POLL_US > 0) {
+            int busy_poll_us = SO_BUSY_POLL_US;
+            if (setsockopt(client_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+                perror("[TITAN] SO_BUSY_POLL");
+            }
+        }
+#endif
 
         flags = fcntl(client_fd, F_GETFL, 0);
         fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
@@ -286,8 +641,8 @@ int main() {
         uint8_t buffer[4096];
         size_t buffer_used = 0;
         uint64_t msg_count = 0;
-        
-        last_broadcast = std::chrono::steady_clock::now();
+        live_msg_count.store(0, std::memory_order_relaxed);
+        bridge_connected = true;
         
         while (running) {
 
@@ -299,22 +654,26 @@ int main() {
 
                 size_t offset = 0;
                 while (offset + sizeof(MsgHeader) <= buffer_used) {
+                    size_t applied = 0;
+#ifdef PIPELINE
+                    offset += frame_into(*ingest, buffer + offset, buffer_used - offset, &applied);
+#else
+                    offset += book->process_batch(buffer + offset, buffer_used - offset, &applied);
+#endif
+                    msg_count += applied;
+                    if (offset + sizeof(MsgHeader) > buffer_used) break;
+
+                    // process_batch stopped short: either the next message is
+                    // still arriving, or it is malformed and we resync by a byte.
                     const MsgHeader* header = reinterpret_cast<const MsgHeader*>(buffer + offset);
                     uint16_t msg_len = header->length;
+                    if (msg_len >= sizeof(MsgHeader) && msg_len <= 256 &&
+                        msg_len >= message_size(header->type) && offset + msg_len > buffer_used) break;
 
-                    if (msg_len < sizeof(MsgHeader) || msg_len > 256) {
-                        std::cerr << "[TITAN] Invalid message length: " << msg_len << std::endl;
-                        offset++;
-                        continue;
-                    }
-
-                    if (offset + msg_len > buffer_used) break;
-
-                    dispatch_message(*book, buffer + offset, msg_len);
-                    
-                    offset += msg_len;
-                    msg_count++;
+                    std::cerr << "[TITAN] Invalid message length: " << msg_len << std::endl;
+                    offset++;
                 }
+                live_msg_count.store(msg_count, std::memory_order_relaxed);
 
                 if (offset > 0) {
                     buffer_used -= offset;
@@ -332,33 +691,32 @@ int main() {
                     perror("\n[TITAN] Recv error");
                     break;
                 }
+#ifdef BUSY_POLL
+                cpu_relax();
+#else
+                std::this_thread::sleep_for(std::chrono::microseconds(IDLE_SLEEP_US));
+#endif
             }
-
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_broadcast).count() >= BROADCAST_INTERVAL_MS) {
-                std::string json = build_book_snapshot(*book);
-                ws_server.broadcast(json);
-                last_broadcast = now;
-
-                if (msg_count % 5000 < 100) {
-                    std::cout << "\r[TITAN] Orders: " << msg_count 
-                              << " | Bid: " << book->get_best_bid() 
-                              << " | Ask: " << book->get_best_ask()
-                              << " | WS Clients: " << ws_server.client_count() << std::flush;
-                }
-            }
-
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
         }
         
+        bridge_connected = false;
         close(client_fd);
         std::cout << "[TITAN] Processed " << msg_count << " messages from bridge." << std::endl;
     }
     
     close(server_fd);
+    broadcaster.join();
+#ifdef PIPELINE
+    matcher.join();
 #endif
+#endif
+
+    publisher.stop();
+    std::cout << "\n[TITAN] Publisher: " << publisher.messages_published() << " messages, max lag "
+              << publisher.max_lag() << ", dropped " << publisher.messages_dropped()
+              << ", trades dropped from WebSocket frames " << trade_sink.trades_dropped() << std::endl;
 
-    std::cout << "\n[TITAN] Stopping WebSocket server..." << std::endl;
+    std::cout << "[TITAN] Stopping WebSocket server..." << std::endl;
     ws_server.stop();
     std::cout << "[TITAN] Shutting down." << std::endl;
     return 0;
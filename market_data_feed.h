@@ -0,0 +1,454 @@
+#ifndef MARKET_DATA_FEED_H
+#define MARKET_DATA_FEED_H
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "output_msg.h"
+#include "output_publisher.h"
+
+constexpr size_t FEED_DATAGRAM_BYTES = 1472;
+constexpr size_t FEED_SENDMMSG_BATCH = 32;
+constexpr size_t FEED_HISTORY_MESSAGES = 1 << 18;
+constexpr size_t FEED_MAX_RETRANSMIT = 1 << 16;
+constexpr size_t FEED_MAX_CLIENTS = 8;
+constexpr int FEED_HEARTBEAT_MS = 1000;
+constexpr int FEED_SEND_TIMEOUT_MS = 1000;
+
+// Encodes one engine message as its packed wire struct. Returns the bytes
+// written, or 0 for a type the feed does not carry.
+inline size_t encode_feed_message(const OutputMsg& msg, uint8_t* dst) {
+    switch (msg.type) {
+        case OutMsgType::TRADE: {
+            OutTrade out{{msg.type, sizeof(OutTrade), msg.timestamp},
+                         msg.trade.buy_order_id, msg.trade.sell_order_id,
+                         msg.trade.price, msg.trade.quantity};
+            std::memcpy(dst, &out, sizeof(out));
+            return sizeof(out);
+        }
+        case OutMsgType::ORDER_ACCEPTED: {
+            OutOrderAccepted out{{msg.type, sizeof(OutOrderAccepted), msg.timestamp},
+                                 msg.accepted.order_id, msg.accepted.side,
+                                 msg.accepted.price, msg.accepted.quantity};
+            std::memcpy(dst, &out, sizeof(out));
+            return sizeof(out);
+        }
+        case OutMsgType::ORDER_CANCELLED: {
+            OutOrderCancelled out{{msg.type, sizeof(OutOrderCancelled), msg.timestamp},
+                                  msg.cancelled.order_id, msg.cancelled.cancelled_qty};
+            std::memcpy(dst, &out, sizeof(out));
+            return sizeof(out);
+        }
+        case OutMsgType::BOOK_UPDATE: {
+            OutBookUpdate out{{msg.type, sizeof(OutBookUpdate), msg.timestamp},
+                              msg.book_update.side, msg.book_update.price,
+                              msg.book_update.visible_volume, msg.book_update.order_count};
+            std::memcpy(dst, &out, sizeof(out));
+            return sizeof(out);
+        }
+        default:
+            return 0;
+    }
+}
+
+// Sequenced binary market data. Engine output is encoded into the packed
+// Out* structs and packed into MTU-sized datagrams, sent to a UDP
+// (multicast or unicast) destination with one sendmmsg per batch of
+// datagrams. A recovery thread serves TCP clients: resends from the last
+// FEED_HISTORY_MESSAGES messages, or a level snapshot rebuilt from the
+// BOOK_UPDATEs already published, tagged with the sequence it reflects.
+class MarketDataFeed : public OutputSink {
+    struct HistorySlot {
+        uint8_t length;
+        uint8_t bytes[sizeof(OutTrade) + 4];
+    };
+    static_assert(sizeof(OutTrade) >= sizeof(OutOrderAccepted) &&
+                  sizeof(OutTrade) >= sizeof(OutBookUpdate), "HistorySlot sized by OutTrade");
+
+    struct LevelImage {
+        int64_t visible_volume;
+        uint32_t order_count;
+    };
+
+    struct Client {
+        int fd = -1;
+        uint8_t request[sizeof(FeedRequest)];
+        size_t received = 0;
+    };
+
+    int udp_fd_ = -1;
+    sockaddr_in dest_{};
+
+    // Datagrams being assembled for the next sendmmsg; [0, packet_count_)
+    // are complete, packet_count_ is the one being filled.
+    std::unique_ptr<uint8_t[]> packets_;
+    mmsghdr headers_[FEED_SENDMMSG_BATCH] = {};
+    iovec iov_[FEED_SENDMMSG_BATCH] = {};
+    size_t packet_count_ = 0;
+    size_t fill_bytes_ = 0;
+    uint16_t fill_messages_ = 0;
+    uint64_t fill_sequence_ = 0;
+    std::chrono::steady_clock::time_point last_send_{};
+
+    // Written by the publisher thread, read by the recovery thread.
+    std::mutex state_mutex_;
+    uint64_t next_sequence_ = 1;
+    std::vector<HistorySlot> history_;
+    std::map<int64_t, LevelImage> bid_image_;
+    std::map<int64_t, LevelImage> ask_image_;
+    uint64_t last_timestamp_ = 0;
+
+    uint16_t recovery_port_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread recovery_thread_;
+
+    uint64_t datagrams_sent_ = 0;
+    uint64_t send_errors_ = 0;
+    std::atomic<uint64_t> retransmit_requests_{0};
+    std::atomic<uint64_t> snapshot_requests_{0};
+
+public:
+    // ttl and interface only apply to a multicast group; interface_addr
+    // picks the outgoing interface by its IPv4 address.
+    MarketDataFeed(const char* group, uint16_t port, uint16_t recovery_port,
+                   int ttl = 1, const char* interface_addr = nullptr)
+        : packets_(std::make_unique<uint8_t[]>(FEED_SENDMMSG_BATCH * FEED_DATAGRAM_BYTES)),
+          history_(FEED_HISTORY_MESSAGES),
+          recovery_port_(recovery_port) {
+        udp_fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        dest_.sin_family = AF_INET;
+        dest_.sin_port = htons(port);
+        if (udp_fd_ < 0 || inet_pton(AF_INET, group, &dest_.sin_addr) != 1) {
+            std::cerr << "[Feed] UDP setup failed for " << group << std::endl;
+            if (udp_fd_ >= 0) ::close(udp_fd_);
+            udp_fd_ = -1;
+        } else if (IN_MULTICAST(ntohl(dest_.sin_addr.s_addr))) {
+            unsigned char mc_ttl = static_cast<unsigned char>(ttl);
+            unsigned char loop = 1;
+            setsockopt(udp_fd_, IPPROTO_IP, IP_MULTICAST_TTL, &mc_ttl, sizeof(mc_ttl));
+            setsockopt(udp_fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+            if (interface_addr) {
+                in_addr iface{};
+                if (inet_pton(AF_INET, interface_addr, &iface) != 1 ||
+                    setsockopt(udp_fd_, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0) {
+                    std::cerr << "[Feed] Cannot use interface " << interface_addr << std::endl;
+                }
+            }
+        }
+        if (udp_fd_ >= 0) {
+            int sndbuf = 4 << 20;
+            setsockopt(udp_fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        }
+
+        for (size_t i = 0; i < FEED_SENDMMSG_BATCH; ++i) {
+            iov_[i].iov_base = packets_.get() + i * FEED_DATAGRAM_BYTES;
+            headers_[i].msg_hdr.msg_name = &dest_;
+            headers_[i].msg_hdr.msg_namelen = sizeof(dest_);
+            headers_[i].msg_hdr.msg_iov = &iov_[i];
+            headers_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    ~MarketDataFeed() override {
+        stop();
+        if (udp_fd_ >= 0) ::close(udp_fd_);
+    }
+
+    MarketDataFeed(const MarketDataFeed&) = delete;
+    MarketDataFeed& operator=(const MarketDataFeed&) = delete;
+
+    // Opens the recovery listener and starts its thread.
+    bool start() {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) return false;
+        int opt = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(recovery_port_);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(listen_fd_, static_cast<int>(FEED_MAX_CLIENTS)) < 0) {
+            std::cerr << "[Feed] Recovery port " << recovery_port_ << " unavailable" << std::endl;
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        running_ = true;
+        recovery_thread_ = std::thread(&MarketDataFeed::recovery_loop, this);
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) return;
+        if (recovery_thread_.joinable()) recovery_thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    void on_messages(const OutputMsg* msgs, size_t count) override {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            for (size_t i = 0; i < count; ++i) {
+                const OutputMsg& msg = msgs[i];
+                uint64_t sequence = next_sequence_;
+                HistorySlot& slot = history_[sequence & (FEED_HISTORY_MESSAGES - 1)];
+                size_t length = encode_feed_message(msg, slot.bytes);
+                if (length == 0) continue;
+                slot.length = static_cast<uint8_t>(length);
+                ++next_sequence_;
+                last_timestamp_ = msg.timestamp;
+                if (msg.type == OutMsgType::BOOK_UPDATE) apply_to_image(msg);
+                append(slot.bytes, length, sequence);
+            }
+        }
+        flush();
+    }
+
+    // Keeps receivers' gap detection alive on a quiet feed.
+    void on_idle() override {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_send_ < std::chrono::milliseconds(FEED_HEARTBEAT_MS)) return;
+        FeedPacketHeader header{sizeof(FeedPacketHeader), FeedPacketKind::HEARTBEAT, 0, current_sequence()};
+        send_datagram(&header, sizeof(header));
+        last_send_ = now;
+    }
+
+    uint64_t datagrams_sent() const { return datagrams_sent_; }
+    uint64_t send_errors() const { return send_errors_; }
+    uint64_t retransmit_requests() const { return retransmit_requests_.load(std::memory_order_relaxed); }
+    uint64_t snapshot_requests() const { return snapshot_requests_.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t current_sequence() {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        return next_sequence_;
+    }
+
+    void apply_to_image(const OutputMsg& msg) {
+        auto& image = msg.book_update.side == Side::BUY ? bid_image_ : ask_image_;
+        if (msg.book_update.order_count == 0) {
+            image.erase(msg.book_update.price);
+        } else {
+            image[msg.book_update.price] = LevelImage{msg.book_update.visible_volume,
+                                                      msg.book_update.order_count};
+        }
+    }
+
+    // --- publisher thread: datagram assembly ---
+
+    uint8_t* fill_packet() { return packets_.get() + packet_count_ * FEED_DATAGRAM_BYTES; }
+
+    void append(const uint8_t* bytes, size_t length, uint64_t sequence) {
+        if (fill_messages_ > 0 && fill_bytes_ + length > FEED_DATAGRAM_BYTES) close_packet();
+        if (fill_messages_ == 0) {
+            fill_bytes_ = sizeof(FeedPacketHeader);
+            fill_sequence_ = sequence;
+        }
+        std::memcpy(fill_packet() + fill_bytes_, bytes, length);
+        fill_bytes_ += length;
+        ++fill_messages_;
+    }
+
+    void close_packet() {
+        FeedPacketHeader header{static_cast<uint16_t>(fill_bytes_), FeedPacketKind::LIVE,
+                                fill_messages_, fill_sequence_};
+        std::memcpy(fill_packet(), &header, sizeof(header));
+        iov_[packet_count_].iov_len = fill_bytes_;
+        fill_messages_ = 0;
+        if (++packet_count_ == FEED_SENDMMSG_BATCH) send_packets();
+    }
+
+    void flush() {
+        if (fill_messages_ > 0) close_packet();
+        if (packet_count_ > 0) send_packets();
+    }
+
+    void send_packets() {
+        size_t sent = 0;
+        while (udp_fd_ >= 0 && sent < packet_count_) {
+            int n = ::sendmmsg(udp_fd_, headers_ + sent, static_cast<unsigned>(packet_count_ - sent),
+                               MSG_DONTWAIT);
+            if (n <= 0) {
+                send_errors_ += packet_count_ - sent;
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        datagrams_sent_ += sent;
+        packet_count_ = 0;
+        last_send_ = std::chrono::steady_clock::now();
+    }
+
+    void send_datagram(const void* data, size_t length) {
+        if (udp_fd_ < 0) return;
+        ssize_t sent = ::sendto(udp_fd_, data, length, MSG_DONTWAIT,
+                                reinterpret_cast<const sockaddr*>(&dest_), sizeof(dest_));
+        if (sent < 0) ++send_errors_; else ++datagrams_sent_;
+    }
+
+    // --- recovery thread ---
+
+    void recovery_loop() {
+        Client clients[FEED_MAX_CLIENTS];
+        pollfd fds[FEED_MAX_CLIENTS + 1];
+        while (running_.load(std::memory_order_relaxed)) {
+            size_t nfds = 0;
+            fds[nfds++] = pollfd{listen_fd_, POLLIN, 0};
+            for (const Client& client : clients) {
+                if (client.fd >= 0) fds[nfds++] = pollfd{client.fd, POLLIN, 0};
+            }
+            if (::poll(fds, nfds, 100) <= 0) continue;
+
+            if (fds[0].revents & POLLIN) accept_client(clients);
+            for (size_t i = 1; i < nfds; ++i) {
+                if (fds[i].revents == 0) continue;
+                for (Client& client : clients) {
+                    if (client.fd == fds[i].fd && !read_request(client)) {
+                        ::close(client.fd);
+                        client = Client{};
+                    }
+                }
+            }
+        }
+        for (Client& client : clients) {
+            if (client.fd >= 0) ::close(client.fd);
+        }
+    }
+
+    void accept_client(Client* clients) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) return;
+        for (size_t i = 0; i < FEED_MAX_CLIENTS; ++i) {
+            if (clients[i].fd >= 0) continue;
+            int flag = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+            timeval tv{FEED_SEND_TIMEOUT_MS / 1000, (FEED_SEND_TIMEOUT_MS % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            clients[i].fd = fd;
+            return;
+        }
+        ::close(fd);
+    }
+
+    // False when the client should be dropped.
+    bool read_request(Client& client) {
+        ssize_t n = ::recv(client.fd, client.request + client.received,
+                           sizeof(FeedRequest) - client.received, MSG_DONTWAIT);
+        if (n <= 0) return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        client.received += static_cast<size_t>(n);
+        if (client.received < sizeof(FeedRequest)) return true;
+        client.received = 0;
+
+        FeedRequest request;
+        std::memcpy(&request, client.request, sizeof(request));
+        switch (request.kind) {
+            case FeedPacketKind::RETRANSMIT:
+                retransmit_requests_.fetch_add(1, std::memory_order_relaxed);
+                return serve_retransmit(client.fd, request.first_sequence, request.count);
+            case FeedPacketKind::SNAPSHOT:
+                snapshot_requests_.fetch_add(1, std::memory_order_relaxed);
+                return serve_snapshot(client.fd);
+            default:
+                return false;
+        }
+    }
+
+    static bool send_all(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool send_empty(int fd, FeedPacketKind kind, uint64_t sequence) {
+        FeedPacketHeader header{sizeof(FeedPacketHeader), kind, 0, sequence};
+        return send_all(fd, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    }
+
+    // Copies one packet's worth of history per lock hold, so a long resend
+    // never stalls the publisher for more than a memcpy of one datagram.
+    bool serve_retransmit(int fd, uint64_t first, uint32_t count) {
+        uint64_t end = first + std::min<uint64_t>(count, FEED_MAX_RETRANSMIT);
+        uint8_t packet[FEED_DATAGRAM_BYTES];
+        while (first < end) {
+            size_t bytes = sizeof(FeedPacketHeader);
+            uint16_t messages = 0;
+            {
+                std::lock_guard<std::mutex> lock(state_mutex_);
+                uint64_t oldest = next_sequence_ > FEED_HISTORY_MESSAGES
+                    ? next_sequence_ - FEED_HISTORY_MESSAGES : 1;
+                if (first < oldest) {
+                    return send_empty(fd, FeedPacketKind::UNAVAILABLE, oldest);
+                }
+                end = std::min(end, next_sequence_);
+                while (first + messages < end) {
+                    const HistorySlot& slot = history_[(first + messages) & (FEED_HISTORY_MESSAGES - 1)];
+                    if (bytes + slot.length > FEED_DATAGRAM_BYTES) break;
+                    std::memcpy(packet + bytes, slot.bytes, slot.length);
+                    bytes += slot.length;
+                    ++messages;
+                }
+            }
+            if (messages == 0) break;
+            FeedPacketHeader header{static_cast<uint16_t>(bytes), FeedPacketKind::RETRANSMIT, messages, first};
+            std::memcpy(packet, &header, sizeof(header));
+            if (!send_all(fd, packet, bytes)) return false;
+            first += messages;
+        }
+        return true;
+    }
+
+    bool serve_snapshot(int fd) {
+        std::vector<OutBookUpdate> levels;
+        uint64_t sequence;
+        uint64_t timestamp;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            sequence = next_sequence_ - 1;
+            timestamp = last_timestamp_;
+            levels.reserve(bid_image_.size() + ask_image_.size());
+            for (const auto& [price, level] : bid_image_) {
+                levels.push_back(OutBookUpdate{{OutMsgType::BOOK_UPDATE, sizeof(OutBookUpdate), timestamp},
+                                               Side::BUY, price, level.visible_volume, level.order_count});
+            }
+            for (const auto& [price, level] : ask_image_) {
+                levels.push_back(OutBookUpdate{{OutMsgType::BOOK_UPDATE, sizeof(OutBookUpdate), timestamp},
+                                               Side::SELL, price, level.visible_volume, level.order_count});
+            }
+        }
+
+        constexpr size_t PER_PACKET = (FEED_DATAGRAM_BYTES - sizeof(FeedPacketHeader)) / sizeof(OutBookUpdate);
+        uint8_t packet[FEED_DATAGRAM_BYTES];
+        for (size_t i = 0; i < levels.size(); i += PER_PACKET) {
+            uint16_t messages = static_cast<uint16_t>(std::min(PER_PACKET, levels.size() - i));
+            size_t bytes = sizeof(FeedPacketHeader) + messages * sizeof(OutBookUpdate);
+            FeedPacketHeader header{static_cast<uint16_t>(bytes), FeedPacketKind::SNAPSHOT, messages, sequence};
+            std::memcpy(packet, &header, sizeof(header));
+            std::memcpy(packet + sizeof(header), &levels[i], messages * sizeof(OutBookUpdate));
+            if (!send_all(fd, packet, bytes)) return false;
+        }
+        return send_empty(fd, FeedPacketKind::SNAPSHOT_END, sequence);
+    }
+};
+
+#endif
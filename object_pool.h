@@ -2,75 +2,184 @@
 #define OBJECT_POOL_H
 
 #include <vector>
+#include <memory>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
+#include <type_traits>
+#include "arena.h"
 
 constexpr uint32_t NULL_INDEX = UINT32_MAX;
 
+// Slots live in fixed 64K-object segments that are never moved, so growth
+// costs one segment allocation instead of copying the pool. An index is
+// segment << POOL_SEGMENT_SHIFT | offset. Freed slots form an intrusive
+// LIFO list threaded through their first four bytes, so the most recently
+// freed (still cached) slot is reused first; slots are not cleared on
+// free and allocate() callers must initialise every field. Segments are
+// arena mappings: the initial reserve() maps them as one block and each
+// later growth maps one segment, so capacity that is never used is never
+// faulted in.
+constexpr uint32_t POOL_SEGMENT_SHIFT = 16;
+constexpr uint32_t POOL_SEGMENT_SIZE = 1u << POOL_SEGMENT_SHIFT;
+constexpr uint32_t POOL_SEGMENT_MASK = POOL_SEGMENT_SIZE - 1;
+
 template<typename T>
 class ObjectPool {
+    static_assert(std::is_trivially_copyable_v<T>, "Pool slots are reused without construction");
+    static_assert(sizeof(T) >= sizeof(uint32_t), "Slot must hold a free-list link");
+
 private:
-    std::vector<T> pool_;
-    std::vector<uint32_t> free_indices_;
+    std::vector<T*> segments_;
+    std::vector<ArenaBlock> blocks_;
+    uint32_t free_head_ = NULL_INDEX;
+    size_t free_count_ = 0;
+    size_t next_fresh_ = 0;
     size_t initial_capacity_;
+    ArenaConfig arena_;
     
+    inline T& slot(uint32_t idx) {
+        return segments_[idx >> POOL_SEGMENT_SHIFT][idx & POOL_SEGMENT_MASK];
+    }
+
+    inline const T& slot(uint32_t idx) const {
+        return segments_[idx >> POOL_SEGMENT_SHIFT][idx & POOL_SEGMENT_MASK];
+    }
+
 public:
-    explicit ObjectPool(size_t capacity = 1'000'000) 
-        : initial_capacity_(capacity) 
+    explicit ObjectPool(size_t capacity = 1'000'000, const ArenaConfig& arena = {})
+        : initial_capacity_(capacity),
+          arena_(arena)
     {
-        pool_.resize(capacity);
-        free_indices_.reserve(capacity);
-        
-        for (size_t i = capacity; i > 0; --i) {
-            free_indices_.push_back(static_cast<uint32_t>(i - 1));
-        }
+        reserve(capacity);
     }
     
     uint32_t allocate() {
-        if (free_indices_.empty()) {
-            grow();
+        if (free_head_ != NULL_INDEX) [[likely]] {
+            uint32_t idx = free_head_;
+            std::memcpy(&free_head_, &slot(idx), sizeof(uint32_t));
+            --free_count_;
+            return idx;
         }
         
-        uint32_t idx = free_indices_.back();
-        free_indices_.pop_back();
-        return idx;
+        if (next_fresh_ == capacity()) [[unlikely]] {
+            grow();
+        }
+        return static_cast<uint32_t>(next_fresh_++);
     }
     
     void free(uint32_t idx) {
-        pool_[idx] = T{};
-        free_indices_.push_back(idx);
+        std::memcpy(&slot(idx), &free_head_, sizeof(uint32_t));
+        free_head_ = idx;
+        ++free_count_;
     }
     
     T& operator[](uint32_t idx) {
-        return pool_[idx];
+        return slot(idx);
     }
     
     const T& operator[](uint32_t idx) const {
-        return pool_[idx];
+        return slot(idx);
     }
     
-    size_t capacity() const { return pool_.size(); }
-    size_t free_count() const { return free_indices_.size(); }
-    size_t used_count() const { return pool_.size() - free_indices_.size(); }
+    // Pre-allocates segments so that `capacity` slots exist; lets callers
+    // move growth out of the matching path.
+    void reserve(size_t capacity) {
+        size_t needed = (capacity + POOL_SEGMENT_SIZE - 1) >> POOL_SEGMENT_SHIFT;
+        if (needed > (size_t{NULL_INDEX} >> POOL_SEGMENT_SHIFT)) {
+            throw std::length_error("ObjectPool capacity exceeds 32-bit index space");
+        }
+        if (segments_.size() >= needed) return;
+        size_t count = needed - segments_.size();
+        blocks_.emplace_back(count * POOL_SEGMENT_SIZE * sizeof(T), arena_);
+        T* base = static_cast<T*>(blocks_.back().data());
+        for (size_t i = 0; i < count; ++i) {
+            segments_.push_back(base + i * POOL_SEGMENT_SIZE);
+        }
+    }
+
+    size_t capacity() const { return segments_.size() << POOL_SEGMENT_SHIFT; }
+    size_t free_count() const { return capacity() - next_fresh_ + free_count_; }
+    size_t used_count() const { return next_fresh_ - free_count_; }
+    size_t segment_count() const { return segments_.size(); }
+    
+    void append_ranges(std::vector<ArenaRange>& out) const {
+        for (const ArenaBlock& block : blocks_) out.push_back(block.range());
+    }
     
     void reset() {
-        free_indices_.clear();
-        for (size_t i = pool_.size(); i > 0; --i) {
-            free_indices_.push_back(static_cast<uint32_t>(i - 1));
-        }
+        free_head_ = NULL_INDEX;
+        free_count_ = 0;
+        next_fresh_ = 0;
     }
     
 private:
     void grow() {
-        size_t old_size = pool_.size();
-        size_t new_size = old_size * 2;
-        
-        pool_.resize(new_size);
-        
-        for (size_t i = new_size; i > old_size; --i) {
-            free_indices_.push_back(static_cast<uint32_t>(i - 1));
+        reserve(capacity() + POOL_SEGMENT_SIZE);
+    }
+};
+
+// Two slot arrays sharing one index space, for records split into a hot
+// part and a cold part read less often. Allocation, segments and the free
+// list (threaded through the hot slot) are those of ObjectPool<Hot>; cold
+// segments are added in step with it.
+template<typename Hot, typename Cold>
+class SplitObjectPool {
+    static_assert(std::is_trivially_copyable_v<Cold>, "Pool slots are reused without construction");
+
+private:
+    ObjectPool<Hot> hot_;
+    std::vector<Cold*> cold_segments_;
+    std::vector<ArenaBlock> cold_blocks_;
+    ArenaConfig arena_;
+
+    void sync_cold() {
+        if (cold_segments_.size() >= hot_.segment_count()) return;
+        size_t count = hot_.segment_count() - cold_segments_.size();
+        cold_blocks_.emplace_back(count * POOL_SEGMENT_SIZE * sizeof(Cold), arena_);
+        Cold* base = static_cast<Cold*>(cold_blocks_.back().data());
+        for (size_t i = 0; i < count; ++i) {
+            cold_segments_.push_back(base + i * POOL_SEGMENT_SIZE);
         }
     }
+
+public:
+    explicit SplitObjectPool(size_t capacity = 1'000'000, const ArenaConfig& arena = {})
+        : hot_(capacity, arena), arena_(arena) { sync_cold(); }
+
+    uint32_t allocate() {
+        uint32_t idx = hot_.allocate();
+        if (cold_segments_.size() < hot_.segment_count()) [[unlikely]] sync_cold();
+        return idx;
+    }
+
+    void free(uint32_t idx) { hot_.free(idx); }
+
+    Hot& hot(uint32_t idx) { return hot_[idx]; }
+    const Hot& hot(uint32_t idx) const { return hot_[idx]; }
+    Cold& cold(uint32_t idx) {
+        return cold_segments_[idx >> POOL_SEGMENT_SHIFT][idx & POOL_SEGMENT_MASK];
+    }
+    const Cold& cold(uint32_t idx) const {
+        return cold_segments_[idx >> POOL_SEGMENT_SHIFT][idx & POOL_SEGMENT_MASK];
+    }
+
+    void reserve(size_t capacity) {
+        hot_.reserve(capacity);
+        sync_cold();
+    }
+
+    size_t capacity() const { return hot_.capacity(); }
+    size_t free_count() const { return hot_.free_count(); }
+    size_t used_count() const { return hot_.used_count(); }
+    size_t segment_count() const { return hot_.segment_count(); }
+
+    void append_ranges(std::vector<ArenaRange>& out) const {
+        hot_.append_ranges(out);
+        for (const ArenaBlock& block : cold_blocks_) out.push_back(block.range());
+    }
+
+    void reset() { hot_.reset(); }
 };
 
 template<typename T, typename LevelT>
@@ -12,18 +12,36 @@
 #include <memory>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "protocol.h"
 #include "object_pool.h"
+#include "order_id_map.h"
 #include "ring_buffer.h"
 #include "output_msg.h"
+#include "engine_telemetry.h"
+#include "arena.h"
 
 constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
 constexpr size_t BATCH_SIZE = 64;
+constexpr size_t MAX_DIRTY_LEVELS = 32;
+// Batched input: messages decoded per pass, and the spacing in messages
+// between the two prefetch stages (see prefetch_early).
+constexpr size_t BATCH_DECODE = 256;
+constexpr size_t PREFETCH_STAGE_GAP = 4;
 
 constexpr int64_t PRICE_OFFSET = 0;
-constexpr size_t MAX_PRICE_LEVELS = 33554432;
+constexpr size_t LADDER_LEVELS = 1 << 16;
+constexpr int64_t RECENTRE_MARGIN = LADDER_LEVELS / 8;
+constexpr int64_t MAX_BOOK_PRICE = INT64_MAX - static_cast<int64_t>(LADDER_LEVELS);
 
-constexpr size_t BITMAP_WORDS = MAX_PRICE_LEVELS / 64;
+constexpr size_t BITMAP_WORDS = LADDER_LEVELS / 64;
 
 using OutputBuffer = RingBuffer<OutputMsg, OUTPUT_BUFFER_SIZE>;
 
@@ -49,36 +67,201 @@ struct alignas(64) Order {
     int64_t peak_size;
     uint32_t next;
     uint32_t prev;
+    uint32_t user_next;
+    uint32_t user_prev;
     uint32_t user_id_low;
     uint8_t flags;
-    uint8_t _pad[7];
+    uint8_t _pad[3];
     
     inline bool is_iceberg() const { return peak_size > 0; }
     inline int64_t total_quantity() const { return quantity + hidden_quantity; }
     inline bool is_buy() const { return flags & 0x01; }
     inline bool is_aon() const { return flags & 0x02; }
+    inline bool is_stop() const { return flags & 0x04; }
+    inline bool is_stop_market() const { return flags & 0x08; }
+    inline bool has_reserve() const { return flags & 0x10; }
     inline void set_buy(bool v) { if (v) flags |= 0x01; else flags &= ~0x01; }
     inline void set_aon(bool v) { if (v) flags |= 0x02; else flags &= ~0x02; }
+    inline void set_stop(bool v) { if (v) flags |= 0x04; else flags &= ~0x04; }
+    inline void set_stop_market(bool v) { if (v) flags |= 0x08; else flags &= ~0x08; }
+    inline void set_reserve(bool v) { if (v) flags |= 0x10; else flags &= ~0x10; }
 };
 static_assert(sizeof(Order) == 64, "Order must be exactly 64 bytes");
 
+// Split layout (Policy::SPLIT_ORDERS): what a level walk reads sits in a
+// 32-byte hot record, two per cache line, indexed in parallel with a cold
+// record holding price and the iceberg reserve. The maker's id stays hot
+// because every fill reports it; has_reserve() tells a depleted order to
+// look at the cold part. The per-user links are only walked by a mass
+// cancel, so they are cold too. Order remains the checkpoint record either
+// way.
+struct alignas(32) OrderHot {
+    int64_t quantity;
+    uint64_t order_id;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t user_id_low;
+    uint8_t flags;
+    uint8_t _pad[3];
+
+    inline bool is_buy() const { return flags & 0x01; }
+    inline bool is_aon() const { return flags & 0x02; }
+    inline bool is_stop() const { return flags & 0x04; }
+    inline bool is_stop_market() const { return flags & 0x08; }
+    inline bool has_reserve() const { return flags & 0x10; }
+    inline void set_buy(bool v) { if (v) flags |= 0x01; else flags &= ~0x01; }
+    inline void set_aon(bool v) { if (v) flags |= 0x02; else flags &= ~0x02; }
+    inline void set_stop(bool v) { if (v) flags |= 0x04; else flags &= ~0x04; }
+    inline void set_stop_market(bool v) { if (v) flags |= 0x08; else flags &= ~0x08; }
+    inline void set_reserve(bool v) { if (v) flags |= 0x10; else flags &= ~0x10; }
+};
+static_assert(sizeof(OrderHot) == 32, "OrderHot must be half a cache line");
+
+struct OrderCold {
+    int64_t price;
+    int64_t hidden_quantity;
+    int64_t peak_size;
+    uint32_t user_next;
+    uint32_t user_prev;
+};
+static_assert(sizeof(OrderCold) == 32, "OrderCold must be 32 bytes");
+
+// Regular orders queue FIFO from head; AON orders sit in their own list
+// from aon_head, ordered by size (ascending, FIFO among equal sizes), and
+// trade after the regular queue so a fill never has to walk past them.
 struct PriceLevel {
     uint32_t head = NULL_INDEX;
     uint32_t tail = NULL_INDEX;
+    uint32_t aon_head = NULL_INDEX;
+    uint32_t aon_tail = NULL_INDEX;
     uint32_t count = 0;
     int64_t total_volume = 0;
     int64_t total_visible_volume = 0;
     int64_t total_aon_volume = 0;
     int64_t total_non_aon_volume = 0;
     
-    inline bool empty() const { return head == NULL_INDEX; }
+    inline bool empty() const { return head == NULL_INDEX && aon_head == NULL_INDEX; }
     inline void reset() {
-        head = tail = NULL_INDEX;
+        head = tail = aon_head = aon_tail = NULL_INDEX;
         count = 0;
         total_volume = total_visible_volume = total_aon_volume = total_non_aon_volume = 0;
     }
 };
 
+// DIRECT indexes orders by id in a flat vector (fastest, but memory grows
+// with the largest id seen). HASHED uses an open-addressing table sized by
+// live orders, for sparse or 64-bit venue ids.
+enum class OrderIndexMode : uint8_t {
+    DIRECT,
+    HASHED,
+};
+
+struct DepthLevel {
+    int64_t price;
+    int64_t volume;
+    uint32_t order_count;
+};
+
+// BBO and counters as of the last completed input message. best_bid is -1
+// and best_ask INT64_MAX when that side is empty.
+struct TopOfBook {
+    int64_t best_bid;
+    int64_t best_bid_volume;
+    int64_t best_ask;
+    int64_t best_ask_volume;
+    uint64_t order_count;
+    uint64_t bid_levels;
+    uint64_t ask_levels;
+    uint64_t messages_processed;
+    uint64_t trades_executed;
+    uint64_t messages_dropped;
+};
+static_assert(sizeof(TopOfBook) % sizeof(uint64_t) == 0, "TopOfBook must be whole words");
+
+// Checkpoint file: header, then one CheckpointLevel per non-empty level,
+// each followed by its orders as raw Order records in queue order. Pool
+// links and the id index are rebuilt on restore, so the file does not
+// depend on pool layout or index mode.
+#pragma pack(push, 1)
+struct CheckpointHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t order_size;
+    uint64_t sequence;
+    uint64_t timestamp;
+    int64_t price_offset;
+    int64_t last_trade_price;
+    uint64_t level_count;
+    uint64_t order_count;
+    uint64_t messages_processed;
+    uint64_t trades_executed;
+    uint64_t reserved[4];
+    
+    static constexpr uint64_t MAGIC = 0x54504B434E415449ULL;
+    static constexpr uint32_t VERSION = 2;
+    
+    bool is_valid() const {
+        return magic == MAGIC && version == VERSION && order_size == sizeof(Order);
+    }
+};
+
+struct CheckpointLevel {
+    int64_t price;
+    uint32_t order_count;
+    uint8_t kind;
+    uint8_t _pad[3];
+    
+    static constexpr uint8_t BID = 0;
+    static constexpr uint8_t ASK = 1;
+    static constexpr uint8_t BUY_STOP = 2;
+    static constexpr uint8_t SELL_STOP = 3;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CheckpointHeader) == 112, "CheckpointHeader must be 112 bytes");
+static_assert(sizeof(CheckpointLevel) == 16, "CheckpointLevel must be 16 bytes");
+
+// Single-writer seqlock. The writer bumps seq to odd, stores the words and
+// bumps it back to even; readers retry until they see the same even seq on
+// both sides. Readers never write, so they never pull the line away from
+// the writer and never block it.
+class alignas(CACHE_LINE_SIZE) SeqlockTop {
+    static constexpr size_t WORDS = sizeof(TopOfBook) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> words_[WORDS] = {};
+
+public:
+    inline void store(const TopOfBook& top) noexcept {
+        uint64_t raw[WORDS];
+        std::memcpy(raw, &top, sizeof(top));
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i) {
+            words_[i].store(raw[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    inline TopOfBook load() const noexcept {
+        uint64_t raw[WORDS];
+        uint64_t before, after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; ++i) {
+                raw[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        TopOfBook top;
+        std::memcpy(&top, raw, sizeof(top));
+        return top;
+    }
+};
+
 struct Trade {
     uint64_t buy_order_id;
     uint64_t sell_order_id;
@@ -86,74 +269,311 @@ struct Trade {
     int64_t quantity;
 };
 
-inline int64_t bitmap_find_highest(const uint64_t* bitmap, size_t num_words, int64_t start_word) {
-    for (int64_t w = start_word; w >= 0; --w) {
-        if (bitmap[w] != 0) {
+// Three-level occupancy bitmap: one bit per level in words, one bit per
+// non-empty word in summary, one bit per non-empty summary word in top.
+// Any next-price search is a fixed number of clz/ctz steps.
+struct LevelBitmap {
+    static constexpr size_t SUMMARY_WORDS = (BITMAP_WORDS + 63) / 64;
+    static_assert(SUMMARY_WORDS <= 64, "LevelBitmap supports at most 64^3 levels");
 
-            int bit_in_word = 63 - __builtin_clzll(bitmap[w]);
-            return w * 64 + bit_in_word;
-        }
+    uint64_t words[BITMAP_WORDS];
+    uint64_t summary[SUMMARY_WORDS];
+    uint64_t top;
+};
+
+inline uint64_t bits_at_or_below(size_t bit) { return ~0ULL >> (63 - bit); }
+inline uint64_t bits_below(size_t bit) { return (1ULL << bit) - 1; }
+inline uint64_t bits_at_or_above(size_t bit) { return ~0ULL << bit; }
+inline uint64_t bits_above(size_t bit) { return bit == 63 ? 0 : ~0ULL << (bit + 1); }
+inline size_t highest_bit(uint64_t word) { return 63 - __builtin_clzll(word); }
+inline size_t lowest_bit(uint64_t word) { return __builtin_ctzll(word); }
+
+// Highest set index <= from_idx, or -1.
+inline int64_t bitmap_find_highest(const LevelBitmap* bitmap, int64_t from_idx) {
+    if (from_idx < 0) return -1;
+    size_t w0 = static_cast<size_t>(from_idx) / 64;
+    uint64_t word = bitmap->words[w0] & bits_at_or_below(from_idx % 64);
+    if (word != 0) {
+        return static_cast<int64_t>(w0 * 64 + highest_bit(word));
     }
-    return -1;
+
+    size_t w1 = w0 / 64;
+    uint64_t sum = bitmap->summary[w1] & bits_below(w0 % 64);
+    if (sum == 0) {
+        uint64_t top = bitmap->top & bits_below(w1);
+        if (top == 0) return -1;
+        w1 = highest_bit(top);
+        sum = bitmap->summary[w1];
+    }
+    w0 = w1 * 64 + highest_bit(sum);
+    return static_cast<int64_t>(w0 * 64 + highest_bit(bitmap->words[w0]));
+}
+
+// Lowest set index >= from_idx, or -1.
+inline int64_t bitmap_find_lowest(const LevelBitmap* bitmap, int64_t from_idx) {
+    size_t w0 = static_cast<size_t>(from_idx) / 64;
+    if (w0 >= BITMAP_WORDS) return -1;
+    uint64_t word = bitmap->words[w0] & bits_at_or_above(from_idx % 64);
+    if (word != 0) {
+        return static_cast<int64_t>(w0 * 64 + lowest_bit(word));
+    }
+
+    size_t w1 = w0 / 64;
+    uint64_t sum = bitmap->summary[w1] & bits_above(w0 % 64);
+    if (sum == 0) {
+        uint64_t top = bitmap->top & bits_above(w1);
+        if (top == 0) return -1;
+        w1 = lowest_bit(top);
+        sum = bitmap->summary[w1];
+    }
+    w0 = w1 * 64 + lowest_bit(sum);
+    return static_cast<int64_t>(w0 * 64 + lowest_bit(bitmap->words[w0]));
 }
 
-inline int64_t bitmap_find_lowest(const uint64_t* bitmap, size_t num_words, int64_t start_word) {
-    for (size_t w = start_word; w < num_words; ++w) {
-        if (bitmap[w] != 0) {
+inline void bitmap_set(LevelBitmap* bitmap, size_t idx) {
+    size_t w0 = idx / 64;
+    size_t w1 = w0 / 64;
+    bitmap->words[w0] |= (1ULL << (idx % 64));
+    bitmap->summary[w1] |= (1ULL << (w0 % 64));
+    bitmap->top |= (1ULL << w1);
+}
 
-            int bit_in_word = __builtin_ctzll(bitmap[w]);
-            return w * 64 + bit_in_word;
+inline void bitmap_clear(LevelBitmap* bitmap, size_t idx) {
+    size_t w0 = idx / 64;
+    bitmap->words[w0] &= ~(1ULL << (idx % 64));
+    if (bitmap->words[w0] == 0) {
+        size_t w1 = w0 / 64;
+        bitmap->summary[w1] &= ~(1ULL << (w0 % 64));
+        if (bitmap->summary[w1] == 0) {
+            bitmap->top &= ~(1ULL << w1);
         }
     }
-    return -1;
 }
 
-inline void bitmap_set(uint64_t* bitmap, size_t idx) {
-    bitmap[idx / 64] |= (1ULL << (idx % 64));
+inline bool bitmap_test(const LevelBitmap* bitmap, size_t idx) {
+    return (bitmap->words[idx / 64] & (1ULL << (idx % 64))) != 0;
 }
 
-inline void bitmap_clear(uint64_t* bitmap, size_t idx) {
-    bitmap[idx / 64] &= ~(1ULL << (idx % 64));
+inline void bitmap_reset(LevelBitmap* bitmap) {
+    std::memset(bitmap, 0, sizeof(LevelBitmap));
 }
 
-inline bool bitmap_test(const uint64_t* bitmap, size_t idx) {
-    return (bitmap[idx / 64] & (1ULL << (idx % 64))) != 0;
+// Calls fn(idx) for every set index in ascending order, then clears the
+// bitmap. Only words the summary marks are read or written.
+template<typename Fn>
+inline void bitmap_drain(LevelBitmap* bitmap, Fn&& fn) {
+    for (uint64_t top = bitmap->top; top != 0; top &= top - 1) {
+        size_t w1 = lowest_bit(top);
+        for (uint64_t sum = bitmap->summary[w1]; sum != 0; sum &= sum - 1) {
+            size_t w0 = w1 * 64 + lowest_bit(sum);
+            for (uint64_t word = bitmap->words[w0]; word != 0; word &= word - 1) {
+                fn(w0 * 64 + lowest_bit(word));
+            }
+            bitmap->words[w0] = 0;
+        }
+        bitmap->summary[w1] = 0;
+    }
+    bitmap->top = 0;
 }
 
-class OptimizedOrderBook {
-private:
+// Compile-time feature set of a book. A disabled feature is compiled out
+// with if constexpr rather than tested per message:
+//   LOCKING     - the locking API takes a shared_mutex; without it the locks
+//                 are no-ops and the book must be owned by one thread.
+//   OUTPUT      - engine output ring. Without it the book owns no ring and
+//                 get_output_buffer() must not be called.
+//   EMIT_*      - which messages go to the ring; the runtime set_emit_*
+//                 switches only apply to kinds compiled in.
+//   ICEBERG, AON, STOPS - order types. Messages of a disabled type are
+//                 counted and ignored, and restore() rejects checkpoints
+//                 holding them.
+//   TELEMETRY   - EngineTelemetry sampling.
+//   CROSS_CHECK - crossed-book diagnostic after every resting add.
+//   SPLIT_ORDERS - OrderHot/OrderCold pool instead of one 64-byte Order per
+//                 slot: level walks touch fewer lines, but a cancel or
+//                 modify touches two records instead of one.
+//   MASS_CANCEL - per-user order lists. Without them no user links are
+//                 kept and MASS_CANCEL messages are counted and ignored.
+struct DefaultBookPolicy {
+    static constexpr bool LOCKING = true;
+    static constexpr bool OUTPUT = true;
+    static constexpr bool EMIT_ACCEPTS = true;
+    static constexpr bool EMIT_CANCELS = true;
+    static constexpr bool EMIT_BOOK_UPDATES = true;
+    static constexpr bool ICEBERG = true;
+    static constexpr bool AON = true;
+    static constexpr bool STOPS = true;
+    static constexpr bool TELEMETRY = TELEMETRY_ENABLED;
+    static constexpr bool CROSS_CHECK = true;
+    static constexpr bool SPLIT_ORDERS = false;
+    static constexpr bool MASS_CANCEL = true;
+};
+
+// One thread owns the book and nothing else calls the locking API: file
+// replay, or one book per shard worker. Readers on other threads use the
+// seqlocked top_of_book() and the output ring only.
+struct SingleThreadBookPolicy : DefaultBookPolicy {
+    static constexpr bool LOCKING = false;
+};
+
+// Matching alone: no lock, no output ring, no diagnostics. Trades are
+// still counted in the top of book.
+struct BenchmarkBookPolicy : SingleThreadBookPolicy {
+    static constexpr bool OUTPUT = false;
+    static constexpr bool EMIT_ACCEPTS = false;
+    static constexpr bool EMIT_CANCELS = false;
+    static constexpr bool EMIT_BOOK_UPDATES = false;
+    static constexpr bool CROSS_CHECK = false;
+};
+
+// Stands in for std::shared_mutex when a policy disables locking.
+struct NullSharedMutex {
+    void lock() noexcept {}
+    void unlock() noexcept {}
+    bool try_lock() noexcept { return true; }
+    void lock_shared() noexcept {}
+    void unlock_shared() noexcept {}
+    bool try_lock_shared() noexcept { return true; }
+};
 
-    std::unique_ptr<PriceLevel[]> bid_levels_;
-    std::unique_ptr<PriceLevel[]> ask_levels_;
+template<typename Policy = DefaultBookPolicy>
+class BasicOrderBook {
+private:
 
-    std::unique_ptr<uint64_t[]> bid_bitmap_;
-    std::unique_ptr<uint64_t[]> ask_bitmap_;
+    // Windowed ladder: LADDER_LEVELS slots per side starting at price_offset_.
+    // Levels outside the window live in the overflow maps until a recentre
+    // pulls them back in.
+    using OverflowLevels = std::map<int64_t, PriceLevel>;
+
+    // Ladders, bitmaps, pool and indexes live in arena mappings (see
+    // arena.h); everything but the ladders starts as kernel-zeroed pages.
+    ArenaArray<PriceLevel> bid_levels_;
+    ArenaArray<PriceLevel> ask_levels_;
+
+    ArenaArray<LevelBitmap> bid_bitmap_;
+    ArenaArray<LevelBitmap> ask_bitmap_;
+
+    OverflowLevels bid_overflow_;
+    OverflowLevels ask_overflow_;
+
+    // Pending stops, keyed by trigger price in the same window and overflow
+    // layout as the book. A pending stop is a pooled Order with the stop
+    // flag set, price = trigger and peak_size = limit price. Ladders are
+    // allocated on the first stop for that side.
+    struct StopLadder {
+        std::unique_ptr<PriceLevel[]> levels = std::make_unique<PriceLevel[]>(LADDER_LEVELS);
+        std::unique_ptr<LevelBitmap> bitmap = std::make_unique<LevelBitmap>();
+        OverflowLevels overflow;
+    };
+    struct TriggeredStop {
+        uint64_t order_id;
+        int64_t limit_price;
+        int64_t quantity;
+        uint32_t user_id;
+        bool is_buy;
+        bool is_market;
+    };
+    std::unique_ptr<StopLadder> buy_stops_;
+    std::unique_ptr<StopLadder> sell_stops_;
+    std::vector<TriggeredStop> triggered_stops_;
+    int64_t min_buy_trigger_ = INT64_MAX;
+    int64_t max_sell_trigger_ = -1;
+    int64_t stop_print_high_ = -1;
+    int64_t stop_print_low_ = INT64_MAX;
+    int64_t last_trade_price_ = -1;
+    size_t stop_count_ = 0;
+    bool stops_pending_ = false;
+
+    int64_t price_offset_ = PRICE_OFFSET;
+    uint64_t recentre_count_ = 0;
 
     int64_t best_bid_ = -1;
     int64_t best_ask_ = INT64_MAX;
-
-    int64_t best_bid_word_ = -1;
-    int64_t best_ask_word_ = 0;
     
     uint32_t bid_level_count_ = 0;
     uint32_t ask_level_count_ = 0;
 
-    ObjectPool<Order> order_pool_;
+    using OrderPool = std::conditional_t<Policy::SPLIT_ORDERS,
+                                         SplitObjectPool<OrderHot, OrderCold>, ObjectPool<Order>>;
+    OrderPool order_pool_;
+
+    // Field access for either layout. Quantity, links, id, user and flags
+    // are read through hot(); price, hidden quantity and peak through
+    // cold(). In the packed layout both return the same Order.
+    inline auto& hot(uint32_t idx) {
+        if constexpr (Policy::SPLIT_ORDERS) return order_pool_.hot(idx);
+        else return order_pool_[idx];
+    }
+    inline const auto& hot(uint32_t idx) const {
+        if constexpr (Policy::SPLIT_ORDERS) return order_pool_.hot(idx);
+        else return order_pool_[idx];
+    }
+    inline auto& cold(uint32_t idx) {
+        if constexpr (Policy::SPLIT_ORDERS) return order_pool_.cold(idx);
+        else return order_pool_[idx];
+    }
+    inline const auto& cold(uint32_t idx) const {
+        if constexpr (Policy::SPLIT_ORDERS) return order_pool_.cold(idx);
+        else return order_pool_[idx];
+    }
+
+    inline Order order_record(uint32_t idx) const {
+        if constexpr (Policy::SPLIT_ORDERS) {
+            const OrderHot& h = hot(idx);
+            const OrderCold& c = cold(idx);
+            Order record{};
+            record.order_id = h.order_id;
+            record.price = c.price;
+            record.quantity = h.quantity;
+            record.hidden_quantity = c.hidden_quantity;
+            record.peak_size = c.peak_size;
+            record.next = h.next;
+            record.prev = h.prev;
+            record.user_next = c.user_next;
+            record.user_prev = c.user_prev;
+            record.user_id_low = h.user_id_low;
+            record.flags = h.flags;
+            return record;
+        } else {
+            return order_pool_[idx];
+        }
+    }
+
+    inline void store_order_record(uint32_t idx, const Order& record) {
+        if constexpr (Policy::SPLIT_ORDERS) {
+            OrderHot& h = hot(idx);
+            OrderCold& c = cold(idx);
+            h.quantity = record.quantity;
+            h.order_id = record.order_id;
+            h.next = record.next;
+            h.prev = record.prev;
+            h.user_id_low = record.user_id_low;
+            h.flags = record.flags;
+            c.price = record.price;
+            c.hidden_quantity = record.hidden_quantity;
+            c.peak_size = record.peak_size;
+            c.user_next = record.user_next;
+            c.user_prev = record.user_prev;
+        } else {
+            order_pool_[idx] = record;
+        }
+    }
 
+    // Price and side live in the Order itself; the index only maps an id
+    // to its pool slot. An entry is live only while it carries the current
+    // index_epoch_, so a reset drops every entry by bumping the epoch.
     struct OrderLocation {
-        int64_t price;
         uint32_t pool_idx;
-        uint8_t flags;
-        uint8_t _pad[3];
-        
-        inline bool is_buy() const { return flags & 0x01; }
-        inline bool is_active() const { return flags & 0x02; }
-        inline void set_buy(bool v) { if (v) flags |= 0x01; else flags &= ~0x01; }
-        inline void set_active(bool v) { if (v) flags |= 0x02; else flags &= ~0x02; }
+        uint32_t epoch;
     };
-    std::vector<OrderLocation> order_index_;
+    OrderIndexMode index_mode_;
+    ArenaArray<OrderLocation> order_index_;
+    uint32_t index_epoch_ = 1;
+    OrderIdMap order_map_;
+    // Each user's resting orders and pending stops, newest first, threaded
+    // through user_next/user_prev; the map holds the head slot.
+    OrderIdMap user_heads_;
     size_t active_order_count_ = 0;
-    size_t max_order_id_ = 0;
 
     static constexpr size_t INITIAL_ORDER_CAPACITY = 5'000'000;
     
@@ -161,39 +581,293 @@ private:
         if (order_id >= order_index_.size()) [[unlikely]] {
             order_index_.resize(std::max(order_id + 1, order_index_.size() * 2));
         }
-        if (order_id > max_order_id_) max_order_id_ = order_id;
+    }
+
+    // Pool slot of a resting order, or NULL_INDEX.
+    inline uint32_t lookup_order(uint64_t order_id) const {
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] {
+            if (order_id >= order_index_.size() || order_index_[order_id].epoch != index_epoch_) {
+                return NULL_INDEX;
+            }
+            return order_index_[order_id].pool_idx;
+        }
+        return order_map_.find(order_id);
+    }
+
+    inline void prefetch_index(uint64_t order_id) const {
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] {
+            if (order_id < order_index_.size()) __builtin_prefetch(&order_index_[order_id]);
+            return;
+        }
+        order_map_.prefetch(order_id);
+    }
+
+    inline void index_order(uint64_t order_id, uint32_t pool_idx) {
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] {
+            ensure_capacity(order_id);
+            order_index_[order_id].pool_idx = pool_idx;
+            order_index_[order_id].epoch = index_epoch_;
+        } else {
+            order_map_.insert_or_assign(order_id, pool_idx);
+        }
+    }
+
+    inline void unindex_order(uint64_t order_id) {
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] {
+            order_index_[order_id].epoch = 0;
+        } else {
+            order_map_.erase(order_id);
+        }
+    }
+
+    inline void user_list_push(uint32_t& head, uint32_t idx) {
+        auto& node = cold(idx);
+        node.user_prev = NULL_INDEX;
+        node.user_next = head;
+        if (head != NULL_INDEX) cold(head).user_prev = idx;
+        head = idx;
+    }
+
+    inline void user_list_remove(uint32_t& head, uint32_t idx) {
+        auto& node = cold(idx);
+        if (node.user_prev != NULL_INDEX) {
+            cold(node.user_prev).user_next = node.user_next;
+        } else {
+            head = node.user_next;
+        }
+        if (node.user_next != NULL_INDEX) cold(node.user_next).user_prev = node.user_prev;
+    }
+
+    // Links a newly pooled order into its user's list.
+    inline void track_user(uint32_t idx) {
+        if constexpr (!Policy::MASS_CANCEL) return;
+        const uint32_t user_id = hot(idx).user_id_low;
+        uint32_t head = user_heads_.find(user_id);
+        user_list_push(head, idx);
+        user_heads_.insert_or_assign(user_id, head);
+    }
+
+    // Unlinks an order from its user's list before its slot is freed. Only
+    // removing the newest order of a user touches the map.
+    inline void untrack_user(uint32_t idx) {
+        if constexpr (!Policy::MASS_CANCEL) return;
+        if (cold(idx).user_prev != NULL_INDEX) [[likely]] {
+            uint32_t head = NULL_INDEX;
+            user_list_remove(head, idx);
+            return;
+        }
+        const uint32_t user_id = hot(idx).user_id_low;
+        uint32_t head = idx;
+        user_list_remove(head, idx);
+        if (head != NULL_INDEX) {
+            user_heads_.insert_or_assign(user_id, head);
+        } else {
+            user_heads_.erase(user_id);
+        }
+    }
+
+    // The hashed index has already lost the ids of every queued order
+    // (see clear_ladder); the sweep only runs if something was left over.
+    inline void clear_order_index() {
+        if (index_mode_ == OrderIndexMode::DIRECT) {
+            if (++index_epoch_ == 0) [[unlikely]] {
+                for (size_t i = 0; i < order_index_.size(); ++i) order_index_[i].epoch = 0;
+                index_epoch_ = 1;
+            }
+        } else if (order_map_.size() != 0) {
+            order_map_.clear();
+        }
     }
     
-    static inline size_t price_to_index(int64_t price) {
-        return static_cast<size_t>(price - PRICE_OFFSET);
+    inline size_t price_to_index(int64_t price) const {
+        return static_cast<size_t>(price - price_offset_);
     }
     
-    static inline int64_t index_to_price(size_t idx) {
-        return static_cast<int64_t>(idx) + PRICE_OFFSET;
+    inline int64_t index_to_price(size_t idx) const {
+        return static_cast<int64_t>(idx) + price_offset_;
+    }
+
+    static inline bool valid_price(int64_t price) {
+        return price >= 0 && price < MAX_BOOK_PRICE;
+    }
+
+    inline PriceLevel* find_level(bool is_buy, int64_t price) {
+        size_t idx = price_to_index(price);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            return &(is_buy ? bid_levels_ : ask_levels_)[idx];
+        }
+        OverflowLevels& overflow = is_buy ? bid_overflow_ : ask_overflow_;
+        auto it = overflow.find(price);
+        return it != overflow.end() ? &it->second : nullptr;
+    }
+
+    inline const PriceLevel* find_level(bool is_buy, int64_t price) const {
+        return const_cast<BasicOrderBook*>(this)->find_level(is_buy, price);
     }
 
-    OutputBuffer output_buffer_;
+    inline PriceLevel& level_for_insert(bool is_buy, int64_t price) {
+        size_t idx = price_to_index(price);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            return (is_buy ? bid_levels_ : ask_levels_)[idx];
+        }
+        return (is_buy ? bid_overflow_ : ask_overflow_)[price];
+    }
+
+    inline int64_t find_bid_at_or_below(int64_t price) const {
+        int64_t found = -1;
+        if (price >= price_offset_) {
+            int64_t from = std::min<int64_t>(price - price_offset_, LADDER_LEVELS - 1);
+            int64_t idx = bitmap_find_highest(bid_bitmap_.get(), from);
+            if (idx >= 0) found = index_to_price(idx);
+        }
+        if (!bid_overflow_.empty()) [[unlikely]] {
+            auto it = bid_overflow_.upper_bound(price);
+            if (it != bid_overflow_.begin()) found = std::max(found, std::prev(it)->first);
+        }
+        return found;
+    }
+
+    inline int64_t find_ask_at_or_above(int64_t price) const {
+        int64_t found = INT64_MAX;
+        if (price < price_offset_ + static_cast<int64_t>(LADDER_LEVELS)) {
+            int64_t from = std::max<int64_t>(price - price_offset_, 0);
+            int64_t idx = bitmap_find_lowest(ask_bitmap_.get(), from);
+            if (idx >= 0) found = index_to_price(idx);
+        }
+        if (!ask_overflow_.empty()) [[unlikely]] {
+            auto it = ask_overflow_.lower_bound(price);
+            if (it != ask_overflow_.end()) found = std::min(found, it->first);
+        }
+        return found;
+    }
+
+    void spill_window(PriceLevel* levels, LevelBitmap* bitmap, OverflowLevels& overflow) {
+        for (int64_t idx = bitmap_find_lowest(bitmap, 0); idx >= 0;
+             idx = bitmap_find_lowest(bitmap, idx + 1)) {
+            overflow.emplace(index_to_price(idx), levels[idx]);
+            levels[idx].reset();
+        }
+        bitmap_reset(bitmap);
+    }
+
+    void absorb_overflow(PriceLevel* levels, LevelBitmap* bitmap, OverflowLevels& overflow) {
+        auto first = overflow.lower_bound(price_offset_);
+        auto last = overflow.lower_bound(price_offset_ + static_cast<int64_t>(LADDER_LEVELS));
+        for (auto it = first; it != last; ++it) {
+            size_t idx = price_to_index(it->first);
+            levels[idx] = it->second;
+            bitmap_set(bitmap, idx);
+        }
+        overflow.erase(first, last);
+    }
+
+    void recentre(int64_t anchor) {
+        int64_t new_offset = std::clamp<int64_t>(anchor - static_cast<int64_t>(LADDER_LEVELS / 2),
+                                                 0, MAX_BOOK_PRICE) & ~int64_t{63};
+        if (new_offset == price_offset_) return;
+
+        spill_window(bid_levels_.get(), bid_bitmap_.get(), bid_overflow_);
+        spill_window(ask_levels_.get(), ask_bitmap_.get(), ask_overflow_);
+        for (StopLadder* stops : {buy_stops_.get(), sell_stops_.get()}) {
+            if (stops) spill_window(stops->levels.get(), stops->bitmap.get(), stops->overflow);
+        }
+        price_offset_ = new_offset;
+        absorb_overflow(bid_levels_.get(), bid_bitmap_.get(), bid_overflow_);
+        absorb_overflow(ask_levels_.get(), ask_bitmap_.get(), ask_overflow_);
+        for (StopLadder* stops : {buy_stops_.get(), sell_stops_.get()}) {
+            if (stops) absorb_overflow(stops->levels.get(), stops->bitmap.get(), stops->overflow);
+        }
+        recentre_count_++;
+    }
+
+    // Called between messages only: a recentre moves levels between the
+    // window and the overflow maps, so no PriceLevel reference may be live.
+    inline void maybe_recentre() {
+        int64_t anchor;
+        if (best_bid_ >= 0 && best_ask_ != INT64_MAX) {
+            anchor = best_bid_ + (best_ask_ - best_bid_) / 2;
+        } else if (best_bid_ >= 0) {
+            anchor = best_bid_;
+        } else if (best_ask_ != INT64_MAX) {
+            anchor = best_ask_;
+        } else {
+            return;
+        }
+
+        if (anchor >= price_offset_ + RECENTRE_MARGIN &&
+            anchor < price_offset_ + static_cast<int64_t>(LADDER_LEVELS) - RECENTRE_MARGIN) [[likely]] {
+            return;
+        }
+        recentre(anchor);
+    }
+
+    // Books owned by a shard publish into the shard's ring instead of
+    // allocating their own (64 MB each at OUTPUT_BUFFER_SIZE).
+    std::unique_ptr<OutputBuffer> owned_output_;
+    OutputBuffer* output_buffer_;
+    uint16_t symbol_id_ = 0;
     bool use_ring_buffer_ = true;
     bool emit_accepts_ = true;
     bool emit_cancels_ = true;
+    bool emit_book_updates_ = true;
     
     alignas(64) OutputMsg batch_buffer_[BATCH_SIZE];
     uint8_t batch_count_ = 0;
 
+    // Levels touched by the current input message; one BOOK_UPDATE per
+    // level is emitted with its final state when the message completes.
+    struct DirtyLevel {
+        int64_t price;
+        bool is_buy;
+    };
+    DirtyLevel dirty_levels_[MAX_DIRTY_LEVELS];
+    uint32_t dirty_count_ = 0;
+    // Levels a mass cancel emptied, settled once the walk is done.
+    std::vector<DirtyLevel> emptied_levels_;
+
     uint64_t current_timestamp_ = 0;
     uint64_t messages_processed_ = 0;
     uint64_t trades_executed_ = 0;
     uint64_t messages_dropped_ = 0;
 
-    mutable std::shared_mutex book_mutex_;
+    // Heap-allocated so its counters never share a line with book state.
+    std::unique_ptr<EngineTelemetry> telemetry_;
+
+    using BookMutex = std::conditional_t<Policy::LOCKING, std::shared_mutex, NullSharedMutex>;
+    mutable BookMutex book_mutex_;
+
+    SeqlockTop published_top_;
+
+    // Last member, so its thread is joined before any table is unmapped.
+    std::unique_ptr<ArenaPrefaulter> prefaulter_;
+
+    // Hottest first: the prefaulter works through them in order.
+    std::vector<ArenaRange> arena_ranges() const {
+        std::vector<ArenaRange> ranges;
+        if (index_mode_ == OrderIndexMode::DIRECT) {
+            ranges.push_back(order_index_.range());
+        } else {
+            ranges.push_back(order_map_.range());
+        }
+        ranges.push_back(bid_bitmap_.range());
+        ranges.push_back(ask_bitmap_.range());
+        ranges.push_back(bid_levels_.range());
+        ranges.push_back(ask_levels_.range());
+        order_pool_.append_ranges(ranges);
+        return ranges;
+    }
 
     inline void list_push_back(PriceLevel& level, uint32_t idx) {
-        Order& node = order_pool_[idx];
+        auto& node = hot(idx);
+        if (Policy::AON && node.is_aon()) [[unlikely]] {
+            aon_list_insert(level, idx);
+            return;
+        }
         node.next = NULL_INDEX;
         node.prev = level.tail;
         
         if (level.tail != NULL_INDEX) {
-            order_pool_[level.tail].next = idx;
+            hot(level.tail).next = idx;
         } else {
             level.head = idx;
         }
@@ -201,27 +875,59 @@ private:
         level.count++;
     }
     
+    // Inserts after the last AON order of the same or smaller size. The walk
+    // starts at the tail, so the common case of sizes arriving in roughly
+    // ascending order is short. AON orders never carry hidden quantity, so
+    // their size is the hot quantity.
+    inline void aon_list_insert(PriceLevel& level, uint32_t idx) {
+        auto& node = hot(idx);
+        const int64_t size = node.quantity;
+        uint32_t after = level.aon_tail;
+        while (after != NULL_INDEX && hot(after).quantity > size) {
+            after = hot(after).prev;
+        }
+        
+        node.prev = after;
+        node.next = (after != NULL_INDEX) ? hot(after).next : level.aon_head;
+        if (node.next != NULL_INDEX) {
+            hot(node.next).prev = idx;
+        } else {
+            level.aon_tail = idx;
+        }
+        if (after != NULL_INDEX) {
+            hot(after).next = idx;
+        } else {
+            level.aon_head = idx;
+        }
+        level.count++;
+    }
+    
     inline void list_remove(PriceLevel& level, uint32_t idx) {
-        Order& node = order_pool_[idx];
+        auto& node = hot(idx);
+        const bool aon = Policy::AON && node.is_aon();
         
         if (node.prev != NULL_INDEX) {
-            order_pool_[node.prev].next = node.next;
+            hot(node.prev).next = node.next;
         } else {
-            level.head = node.next;
+            (aon ? level.aon_head : level.head) = node.next;
         }
         
         if (node.next != NULL_INDEX) {
-            order_pool_[node.next].prev = node.prev;
+            hot(node.next).prev = node.prev;
         } else {
-            level.tail = node.prev;
+            (aon ? level.aon_tail : level.tail) = node.prev;
         }
         
         node.prev = node.next = NULL_INDEX;
         level.count--;
     }
 
-    inline void add_to_level_volume(PriceLevel& level, const Order& order) {
-        int64_t total = order.quantity + order.hidden_quantity;
+    // `price` is the level's price, passed in so a fill never reads the
+    // cold record.
+    inline void add_to_level_volume(PriceLevel& level, uint32_t idx, int64_t price) {
+        const auto& order = hot(idx);
+        note_level_change(order.is_buy(), price);
+        int64_t total = order.quantity + cold(idx).hidden_quantity;
         level.total_volume += total;
         level.total_visible_volume += order.quantity;
         if (order.is_aon()) {
@@ -231,8 +937,10 @@ private:
         }
     }
     
-    inline void remove_from_level_volume(PriceLevel& level, const Order& order) {
-        int64_t total = order.quantity + order.hidden_quantity;
+    inline void remove_from_level_volume(PriceLevel& level, uint32_t idx, int64_t price) {
+        const auto& order = hot(idx);
+        note_level_change(order.is_buy(), price);
+        int64_t total = order.quantity + cold(idx).hidden_quantity;
         level.total_volume -= total;
         level.total_visible_volume -= order.quantity;
         if (order.is_aon()) {
@@ -242,8 +950,11 @@ private:
         }
     }
     
-    inline void adjust_level_volume(PriceLevel& level, int64_t visible_delta, 
-                                    int64_t hidden_delta, bool is_aon) {
+    inline void adjust_level_volume(PriceLevel& level, uint32_t idx, int64_t price,
+                                    int64_t visible_delta, int64_t hidden_delta) {
+        const auto& order = hot(idx);
+        note_level_change(order.is_buy(), price);
+        bool is_aon = order.is_aon();
         level.total_volume += visible_delta + hidden_delta;
         level.total_visible_volume += visible_delta;
         if (is_aon) {
@@ -255,65 +966,74 @@ private:
 
     inline void update_best_bid_after_add(int64_t price) {
         size_t idx = price_to_index(price);
-        bitmap_set(bid_bitmap_.get(), idx);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            bitmap_set(bid_bitmap_.get(), idx);
+        }
         if (best_bid_ < 0 || price > best_bid_) {
             best_bid_ = price;
-            best_bid_word_ = idx / 64;
         }
     }
     
     inline void update_best_ask_after_add(int64_t price) {
         size_t idx = price_to_index(price);
-        bitmap_set(ask_bitmap_.get(), idx);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            bitmap_set(ask_bitmap_.get(), idx);
+        }
 
         if (best_ask_ == INT64_MAX || price < best_ask_) {
             best_ask_ = price;
-            best_ask_word_ = idx / 64;
         }
     }
     
     inline void update_best_bid_after_remove(int64_t removed_price) {
         size_t idx = price_to_index(removed_price);
-        if (bid_levels_[idx].empty()) {
-            bitmap_clear(bid_bitmap_.get(), idx);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            if (bid_levels_[idx].empty()) {
+                bitmap_clear(bid_bitmap_.get(), idx);
+            }
+        } else {
+            auto it = bid_overflow_.find(removed_price);
+            if (it != bid_overflow_.end() && it->second.empty()) {
+                bid_overflow_.erase(it);
+            }
         }
         
         if (removed_price == best_bid_) {
-
-            int64_t new_best = bitmap_find_highest(bid_bitmap_.get(), BITMAP_WORDS, best_bid_word_);
-            if (new_best >= 0) {
-                best_bid_ = index_to_price(new_best);
-                best_bid_word_ = new_best / 64;
-            } else {
-                best_bid_ = -1;
-                best_bid_word_ = -1;
+            best_bid_ = find_bid_at_or_below(removed_price);
+            if constexpr (Policy::TELEMETRY) {
+                if (best_bid_ >= 0) telemetry_->note_rescan(removed_price - best_bid_);
             }
         }
     }
     
     inline void update_best_ask_after_remove(int64_t removed_price) {
         size_t idx = price_to_index(removed_price);
-        if (ask_levels_[idx].empty()) {
-            bitmap_clear(ask_bitmap_.get(), idx);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            if (ask_levels_[idx].empty()) {
+                bitmap_clear(ask_bitmap_.get(), idx);
+            }
+        } else {
+            auto it = ask_overflow_.find(removed_price);
+            if (it != ask_overflow_.end() && it->second.empty()) {
+                ask_overflow_.erase(it);
+            }
         }
         
         if (removed_price == best_ask_) {
-
-            int64_t new_best = bitmap_find_lowest(ask_bitmap_.get(), BITMAP_WORDS, best_ask_word_);
-            if (new_best >= 0) {
-                best_ask_ = index_to_price(new_best);
-                best_ask_word_ = new_best / 64;
-            } else {
-
-                best_ask_ = INT64_MAX;
-                best_ask_word_ = 0;
+            best_ask_ = find_ask_at_or_above(removed_price);
+            if constexpr (Policy::TELEMETRY) {
+                if (best_ask_ != INT64_MAX) telemetry_->note_rescan(best_ask_ - removed_price);
             }
         }
     }
 
     inline void flush_batch() {
+        if constexpr (!Policy::OUTPUT) return;
         if (batch_count_ > 0) {
-            size_t pushed = output_buffer_.push_batch(batch_buffer_, batch_count_);
+            for (uint8_t i = 0; i < batch_count_; ++i) {
+                batch_buffer_[i].symbol_id = symbol_id_;
+            }
+            size_t pushed = output_buffer_->push_batch(batch_buffer_, batch_count_);
             if (pushed < batch_count_) [[unlikely]] {
                 messages_dropped_ += (batch_count_ - pushed);
             }
@@ -323,14 +1043,19 @@ private:
     
     inline void emit_trade(uint64_t buy_id, uint64_t sell_id, int64_t price, int64_t qty) {
         ++trades_executed_;
-        if (use_ring_buffer_) [[likely]] {
-            batch_buffer_[batch_count_++] = 
-                OutputMsg::make_trade(current_timestamp_, buy_id, sell_id, price, qty);
-            if (batch_count_ >= BATCH_SIZE) [[unlikely]] flush_batch();
+        last_trade_price_ = price;
+        if constexpr (Policy::STOPS) note_print_for_stops(price);
+        if constexpr (Policy::OUTPUT) {
+            if (use_ring_buffer_) [[likely]] {
+                batch_buffer_[batch_count_++] = 
+                    OutputMsg::make_trade(current_timestamp_, buy_id, sell_id, price, qty);
+                if (batch_count_ >= BATCH_SIZE) [[unlikely]] flush_batch();
+            }
         }
     }
     
     inline void emit_order_accepted(uint64_t order_id, Side side, int64_t price, int64_t qty) {
+        if constexpr (!Policy::OUTPUT || !Policy::EMIT_ACCEPTS) return;
         if (!emit_accepts_) return;
         if (use_ring_buffer_) [[likely]] {
             batch_buffer_[batch_count_++] = 
@@ -339,7 +1064,70 @@ private:
         }
     }
     
+    inline void note_level_change(bool is_buy, int64_t price) {
+        if constexpr (!Policy::OUTPUT || !Policy::EMIT_BOOK_UPDATES) return;
+        if (!emit_book_updates_) return;
+        for (uint32_t i = dirty_count_; i > 0; --i) {
+            if (dirty_levels_[i - 1].price == price && dirty_levels_[i - 1].is_buy == is_buy) return;
+        }
+        if (dirty_count_ == MAX_DIRTY_LEVELS) [[unlikely]] flush_book_updates();
+        dirty_levels_[dirty_count_++] = DirtyLevel{price, is_buy};
+    }
+
+    inline void flush_book_updates() {
+        for (uint32_t i = 0; i < dirty_count_; ++i) {
+            const DirtyLevel& dirty = dirty_levels_[i];
+            const PriceLevel* level = find_level(dirty.is_buy, dirty.price);
+            int64_t visible = level ? level->total_visible_volume : 0;
+            uint32_t count = level ? level->count : 0;
+            if (use_ring_buffer_) [[likely]] {
+                batch_buffer_[batch_count_++] = OutputMsg::make_book_update(
+                    current_timestamp_, bool_to_side(dirty.is_buy), dirty.price, visible, count);
+                if (batch_count_ >= BATCH_SIZE) [[unlikely]] flush_batch();
+            }
+        }
+        dirty_count_ = 0;
+    }
+
+    inline void publish_top() {
+        const PriceLevel* bid = best_bid_ >= 0 ? find_level(true, best_bid_) : nullptr;
+        const PriceLevel* ask = best_ask_ != INT64_MAX ? find_level(false, best_ask_) : nullptr;
+        published_top_.store(TopOfBook{
+            best_bid_, bid ? bid->total_visible_volume : 0,
+            best_ask_, ask ? ask->total_visible_volume : 0,
+            active_order_count_, bid_level_count_, ask_level_count_,
+            messages_processed_, trades_executed_, messages_dropped_});
+    }
+
+    // Runs once per input message, before any book mutation.
+    inline void begin_message(BookOp op) {
+        ++messages_processed_;
+        if constexpr (Policy::TELEMETRY) telemetry_->begin(op);
+    }
+
+    // Runs once per input message, after all book mutations.
+    inline void end_message() {
+        if constexpr (Policy::STOPS) {
+            if (stops_pending_) [[unlikely]] release_stops();
+        }
+        if (dirty_count_ > 0) flush_book_updates();
+        maybe_recentre();
+        publish_top();
+        if constexpr (Policy::TELEMETRY) {
+            if (telemetry_->sampling()) [[unlikely]] finish_sample();
+        }
+    }
+
+    // Gauges are only refreshed on sampled messages; reading the output
+    // ring's consumer index every message would pull its line across cores.
+    inline void finish_sample() {
+        telemetry_->end_sample();
+        telemetry_->note_pool(order_pool_.used_count(), order_pool_.capacity());
+        if constexpr (Policy::OUTPUT) telemetry_->note_output_ring(output_buffer_->size_approx());
+    }
+
     inline void emit_order_cancelled(uint64_t order_id, int64_t cancelled_qty) {
+        if constexpr (!Policy::OUTPUT || !Policy::EMIT_CANCELS) return;
         if (!emit_cancels_) return;
         if (use_ring_buffer_) [[likely]] {
             batch_buffer_[batch_count_++] = 
@@ -350,22 +1138,21 @@ private:
 
     inline void add_order_internal(uint64_t order_id, bool is_buy, int64_t price, 
                                    int64_t quantity, uint32_t user_id) {
-        size_t price_idx = price_to_index(price);
-        if (price_idx >= MAX_PRICE_LEVELS) [[unlikely]] return;
+        if (!valid_price(price)) [[unlikely]] return;
         
-        PriceLevel* levels = is_buy ? bid_levels_.get() : ask_levels_.get();
-        PriceLevel& level = levels[price_idx];
+        PriceLevel& level = level_for_insert(is_buy, price);
         bool was_empty = level.empty();
         
         uint32_t idx = order_pool_.allocate();
-        Order& order = order_pool_[idx];
+        auto& order = hot(idx);
+        auto& extra = cold(idx);
         
         order.order_id = order_id;
         order.user_id_low = user_id;
-        order.price = price;
+        extra.price = price;
         order.quantity = quantity;
-        order.hidden_quantity = 0;
-        order.peak_size = 0;
+        extra.hidden_quantity = 0;
+        extra.peak_size = 0;
         order.flags = 0;
         order.set_buy(is_buy);
         order.set_aon(false);
@@ -373,7 +1160,7 @@ private:
         order.prev = NULL_INDEX;
         
         list_push_back(level, idx);
-        add_to_level_volume(level, order);
+        add_to_level_volume(level, idx, price);
         
         if (was_empty) {
             if (is_buy) {
@@ -385,52 +1172,54 @@ private:
             }
         }
         
-        ensure_capacity(order_id);
-        order_index_[order_id].price = price;
-        order_index_[order_id].pool_idx = idx;
-        order_index_[order_id].flags = 0;
-        order_index_[order_id].set_buy(is_buy);
-        order_index_[order_id].set_active(true);
+        index_order(order_id, idx);
+        track_user(idx);
         active_order_count_++;
         
         emit_order_accepted(order_id, bool_to_side(is_buy), price, quantity);
 
-        if (best_bid_ >= 0 && best_ask_ != INT64_MAX && best_bid_ >= best_ask_) {
-            std::cerr << "[CRITICAL] CROSS DETECTED! Bid: " << best_bid_ 
-                      << " Ask: " << best_ask_ << std::endl;
+        // Unfillable all-or-none orders may legitimately rest through the
+        // spread; only a cross between regular liquidity is a bug.
+        if constexpr (Policy::CROSS_CHECK) {
+            if (best_bid_ >= 0 && best_ask_ != INT64_MAX && best_bid_ >= best_ask_ &&
+                find_level(true, best_bid_)->total_non_aon_volume > 0 &&
+                find_level(false, best_ask_)->total_non_aon_volume > 0) [[unlikely]] {
+                std::cerr << "[CRITICAL] CROSS DETECTED! Bid: " << best_bid_ 
+                          << " Ask: " << best_ask_ << std::endl;
+            }
         }
     }
     
     inline void add_iceberg_internal(uint64_t order_id, bool is_buy, int64_t price,
                                      int64_t total_quantity, int64_t visible_quantity,
                                      uint32_t user_id) {
-        size_t price_idx = price_to_index(price);
-        if (price_idx >= MAX_PRICE_LEVELS) [[unlikely]] return;
+        if (!valid_price(price)) [[unlikely]] return;
         
-        PriceLevel* levels = is_buy ? bid_levels_.get() : ask_levels_.get();
-        PriceLevel& level = levels[price_idx];
+        PriceLevel& level = level_for_insert(is_buy, price);
         bool was_empty = level.empty();
         
         int64_t display_qty = std::min(visible_quantity, total_quantity);
         int64_t hidden_qty = total_quantity - display_qty;
         
         uint32_t idx = order_pool_.allocate();
-        Order& order = order_pool_[idx];
+        auto& order = hot(idx);
+        auto& extra = cold(idx);
         
         order.order_id = order_id;
         order.user_id_low = user_id;
-        order.price = price;
+        extra.price = price;
         order.quantity = display_qty;
-        order.hidden_quantity = hidden_qty;
-        order.peak_size = visible_quantity;
+        extra.hidden_quantity = hidden_qty;
+        extra.peak_size = visible_quantity;
         order.flags = 0;
         order.set_buy(is_buy);
         order.set_aon(false);
+        order.set_reserve(visible_quantity > 0 || hidden_qty > 0);
         order.next = NULL_INDEX;
         order.prev = NULL_INDEX;
         
         list_push_back(level, idx);
-        add_to_level_volume(level, order);
+        add_to_level_volume(level, idx, price);
         
         if (was_empty) {
             if (is_buy) {
@@ -442,12 +1231,8 @@ private:
             }
         }
         
-        ensure_capacity(order_id);
-        order_index_[order_id].price = price;
-        order_index_[order_id].pool_idx = idx;
-        order_index_[order_id].flags = 0;
-        order_index_[order_id].set_buy(is_buy);
-        order_index_[order_id].set_active(true);
+        index_order(order_id, idx);
+        track_user(idx);
         active_order_count_++;
         
         emit_order_accepted(order_id, bool_to_side(is_buy), price, display_qty);
@@ -455,22 +1240,21 @@ private:
     
     inline void add_aon_internal(uint64_t order_id, bool is_buy, int64_t price,
                                  int64_t quantity, uint32_t user_id) {
-        size_t price_idx = price_to_index(price);
-        if (price_idx >= MAX_PRICE_LEVELS) [[unlikely]] return;
+        if (!valid_price(price)) [[unlikely]] return;
         
-        PriceLevel* levels = is_buy ? bid_levels_.get() : ask_levels_.get();
-        PriceLevel& level = levels[price_idx];
+        PriceLevel& level = level_for_insert(is_buy, price);
         bool was_empty = level.empty();
         
         uint32_t idx = order_pool_.allocate();
-        Order& order = order_pool_[idx];
+        auto& order = hot(idx);
+        auto& extra = cold(idx);
         
         order.order_id = order_id;
         order.user_id_low = user_id;
-        order.price = price;
+        extra.price = price;
         order.quantity = quantity;
-        order.hidden_quantity = 0;
-        order.peak_size = 0;
+        extra.hidden_quantity = 0;
+        extra.peak_size = 0;
         order.flags = 0;
         order.set_buy(is_buy);
         order.set_aon(true);
@@ -478,7 +1262,7 @@ private:
         order.prev = NULL_INDEX;
         
         list_push_back(level, idx);
-        add_to_level_volume(level, order);
+        add_to_level_volume(level, idx, price);
         
         if (was_empty) {
             if (is_buy) {
@@ -490,159 +1274,465 @@ private:
             }
         }
         
-        ensure_capacity(order_id);
-        order_index_[order_id].price = price;
-        order_index_[order_id].pool_idx = idx;
-        order_index_[order_id].flags = 0;
-        order_index_[order_id].set_buy(is_buy);
-        order_index_[order_id].set_active(true);
+        index_order(order_id, idx);
+        track_user(idx);
         active_order_count_++;
         
         emit_order_accepted(order_id, bool_to_side(is_buy), price, quantity);
     }
     
     inline void cancel_order_internal(uint64_t order_id) {
-        if (order_id >= order_index_.size() || !order_index_[order_id].is_active()) [[unlikely]] {
+        uint32_t idx = lookup_order(order_id);
+        if (idx == NULL_INDEX) [[unlikely]] {
             return;
         }
         
-        OrderLocation& loc = order_index_[order_id];
-        size_t price_idx = price_to_index(loc.price);
-        if (price_idx >= MAX_PRICE_LEVELS) [[unlikely]] return;
-        
-        PriceLevel* levels = loc.is_buy() ? bid_levels_.get() : ask_levels_.get();
-        PriceLevel& level = levels[price_idx];
+        const auto& order = hot(idx);
+        if (Policy::STOPS && order.is_stop()) [[unlikely]] {
+            int64_t cancelled_qty = order.quantity;
+            unlink_stop(idx);
+            untrack_user(idx);
+            order_pool_.free(idx);
+            unindex_order(order_id);
+            --stop_count_;
+            emit_order_cancelled(order_id, cancelled_qty);
+            return;
+        }
+        const bool is_buy = order.is_buy();
+        const int64_t price = cold(idx).price;
+        PriceLevel* level_ptr = find_level(is_buy, price);
+        if (level_ptr == nullptr) [[unlikely]] return;
+        PriceLevel& level = *level_ptr;
         
-        Order& order = order_pool_[loc.pool_idx];
-        int64_t cancelled_qty = order.quantity + order.hidden_quantity;
+        int64_t cancelled_qty = order.quantity + cold(idx).hidden_quantity;
         
-        remove_from_level_volume(level, order);
-        list_remove(level, loc.pool_idx);
-        order_pool_.free(loc.pool_idx);
+        remove_from_level_volume(level, idx, price);
+        list_remove(level, idx);
+        untrack_user(idx);
+        order_pool_.free(idx);
         
         if (level.empty()) {
-            if (loc.is_buy()) {
+            if (is_buy) {
                 bid_level_count_--;
-                update_best_bid_after_remove(loc.price);
+                update_best_bid_after_remove(price);
             } else {
                 ask_level_count_--;
-                update_best_ask_after_remove(loc.price);
+                update_best_ask_after_remove(price);
             }
         }
         
-        loc.set_active(false);
+        unindex_order(order_id);
         active_order_count_--;
         
         emit_order_cancelled(order_id, cancelled_qty);
     }
     
-    inline void modify_order_internal(uint64_t order_id, int64_t new_price, int64_t new_quantity) {
-        if (order_id >= order_index_.size() || !order_index_[order_id].is_active()) [[unlikely]] {
-            return;
+    // Clears the occupancy of a level that a mass cancel emptied; the
+    // caller settles the BBO afterwards.
+    inline void drop_empty_level(bool is_buy, int64_t price) {
+        size_t idx = price_to_index(price);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            bitmap_clear((is_buy ? bid_bitmap_ : ask_bitmap_).get(), idx);
+        } else {
+            (is_buy ? bid_overflow_ : ask_overflow_).erase(price);
         }
-        
-        OrderLocation& loc = order_index_[order_id];
-        size_t price_idx = price_to_index(loc.price);
-        if (price_idx >= MAX_PRICE_LEVELS) [[unlikely]] return;
-        
-        PriceLevel* levels = loc.is_buy() ? bid_levels_.get() : ask_levels_.get();
-        PriceLevel& level = levels[price_idx];
-        Order& order = order_pool_[loc.pool_idx];
-        
-        if (new_price == loc.price && new_quantity <= order.quantity) {
-            int64_t delta = new_quantity - order.quantity;
-            adjust_level_volume(level, delta, 0, order.is_aon());
-            order.quantity = new_quantity;
+        if (is_buy) {
+            bid_level_count_--;
         } else {
-            bool is_buy = loc.is_buy();
-            cancel_order_internal(order_id);
-            add_order_internal(order_id, is_buy, new_price, new_quantity, 0);
+            ask_level_count_--;
         }
     }
-    
-    inline int64_t calculate_available_quantity(bool is_buy, int64_t limit_price, 
-                                                int64_t incoming_qty) const {
-        const PriceLevel* levels = is_buy ? ask_levels_.get() : bid_levels_.get();
-        int64_t best = is_buy ? best_ask_ : best_bid_;
 
-        if (is_buy && best == INT64_MAX) return 0;
-        if (!is_buy && best < 0) return 0;
-        
-        int64_t available = 0;
-        int64_t remaining = incoming_qty;
+    // One walk of the user's list. Each selected order leaves its queue as
+    // it is reached; levels it empties are collected, and their bitmap bits,
+    // the level counts, the BBO and the user's map entry are settled once
+    // after the walk.
+    inline size_t mass_cancel_internal(uint32_t user_id, uint8_t side,
+                                       int64_t min_price, int64_t max_price) {
+        const uint32_t first = user_heads_.find(user_id);
+        if (first == NULL_INDEX) return 0;
         
-        if (is_buy) {
-            for (int64_t p = best; p <= limit_price && remaining > 0; ++p) {
-                size_t idx = price_to_index(p);
-                if (idx >= MAX_PRICE_LEVELS) break;
-                
-                const PriceLevel& level = levels[idx];
-                if (level.empty()) continue;
-                
-                if (level.total_aon_volume == 0) {
-                    int64_t fillable = std::min(remaining, level.total_volume);
-                    available += fillable;
-                    remaining -= fillable;
-                } else {
-                    uint32_t curr = level.head;
-                    while (curr != NULL_INDEX && remaining > 0) {
-                        const Order& order = order_pool_[curr];
-                        int64_t order_total = order.quantity + order.hidden_quantity;
-                        
-                        if (order.is_aon()) {
-                            if (remaining >= order_total) {
-                                available += order_total;
-                                remaining -= order_total;
-                            }
-                        } else {
-                            int64_t fillable = std::min(remaining, order_total);
-                            available += fillable;
-                            remaining -= fillable;
-                        }
-                        curr = order.next;
-                    }
-                }
+        uint32_t head = first;
+        size_t cancelled = 0;
+        emptied_levels_.clear();
+        for (uint32_t curr = first; curr != NULL_INDEX; ) {
+            const auto& order = hot(curr);
+            const auto& extra = cold(curr);
+            const uint32_t next_idx = extra.user_next;
+            const bool is_buy = order.is_buy();
+            const int64_t price = extra.price;
+            if ((side != MASS_CANCEL_BOTH_SIDES && side != static_cast<uint8_t>(bool_to_side(is_buy))) ||
+                price < min_price || price > max_price) {
+                curr = next_idx;
+                continue;
             }
-        } else {
-            for (int64_t p = best; p >= limit_price && remaining > 0; --p) {
-                size_t idx = price_to_index(p);
-                if (idx >= MAX_PRICE_LEVELS) continue;
-                
-                const PriceLevel& level = levels[idx];
-                if (level.empty()) continue;
-                
-                if (level.total_aon_volume == 0) {
-                    int64_t fillable = std::min(remaining, level.total_volume);
-                    available += fillable;
-                    remaining -= fillable;
-                } else {
-                    uint32_t curr = level.head;
-                    while (curr != NULL_INDEX && remaining > 0) {
-                        const Order& order = order_pool_[curr];
-                        int64_t order_total = order.quantity + order.hidden_quantity;
-                        
-                        if (order.is_aon()) {
-                            if (remaining >= order_total) {
-                                available += order_total;
-                                remaining -= order_total;
-                            }
-                        } else {
-                            int64_t fillable = std::min(remaining, order_total);
-                            available += fillable;
-                            remaining -= fillable;
-                        }
-                        curr = order.next;
-                    }
+            
+            const uint64_t order_id = order.order_id;
+            const int64_t cancelled_qty = order.quantity + extra.hidden_quantity;
+            if (Policy::STOPS && order.is_stop()) [[unlikely]] {
+                unlink_stop(curr);
+                --stop_count_;
+            } else {
+                PriceLevel* level_ptr = find_level(is_buy, price);
+                if (level_ptr == nullptr) [[unlikely]] {
+                    curr = next_idx;
+                    continue;
                 }
+                remove_from_level_volume(*level_ptr, curr, price);
+                list_remove(*level_ptr, curr);
+                if (level_ptr->empty()) emptied_levels_.push_back(DirtyLevel{price, is_buy});
+                active_order_count_--;
             }
+            user_list_remove(head, curr);
+            order_pool_.free(curr);
+            unindex_order(order_id);
+            emit_order_cancelled(order_id, cancelled_qty);
+            ++cancelled;
+            curr = next_idx;
         }
         
-        return available;
+        if (!emptied_levels_.empty()) {
+            for (const DirtyLevel& emptied : emptied_levels_) {
+                drop_empty_level(emptied.is_buy, emptied.price);
+            }
+            best_bid_ = find_bid_at_or_below(best_bid_);
+            best_ask_ = find_ask_at_or_above(best_ask_);
+        }
+        if (head != first) {
+            if (head != NULL_INDEX) {
+                user_heads_.insert_or_assign(user_id, head);
+            } else {
+                user_heads_.erase(user_id);
+            }
+        }
+        return cancelled;
+    }
+    
+    inline void modify_order_internal(uint64_t order_id, int64_t new_price, int64_t new_quantity) {
+        uint32_t idx = lookup_order(order_id);
+        if (idx == NULL_INDEX) [[unlikely]] {
+            return;
+        }
+        
+        if (new_quantity <= 0 || !valid_price(new_price)) [[unlikely]] {
+            cancel_order_internal(order_id);
+            return;
+        }
+        
+        auto& order = hot(idx);
+        auto& extra = cold(idx);
+        if (Policy::STOPS && order.is_stop()) [[unlikely]] {
+            // For a pending stop the modify price is the new trigger.
+            unlink_stop(idx);
+            extra.price = new_price;
+            order.quantity = new_quantity;
+            link_stop(idx);
+            return;
+        }
+        const bool is_buy = order.is_buy();
+        const int64_t old_price = extra.price;
+        PriceLevel* level_ptr = find_level(is_buy, old_price);
+        if (level_ptr == nullptr) [[unlikely]] return;
+        PriceLevel& level = *level_ptr;
+        const int64_t open_qty = order.quantity + extra.hidden_quantity;
+        
+        // Quantity down at the same price: shrink in place and keep queue
+        // position. Hidden iceberg quantity is cut before the display.
+        if (new_price == old_price && new_quantity <= open_qty) {
+            int64_t reduce = open_qty - new_quantity;
+            int64_t hidden_cut = std::min(reduce, extra.hidden_quantity);
+            int64_t visible_cut = reduce - hidden_cut;
+            adjust_level_volume(level, idx, old_price, -visible_cut, -hidden_cut);
+            if (Policy::AON && order.is_aon() && reduce > 0) {
+                // The AON list is ordered by size, so a smaller order moves.
+                list_remove(level, idx);
+                order.quantity -= visible_cut;
+                aon_list_insert(level, idx);
+            } else {
+                order.quantity -= visible_cut;
+                extra.hidden_quantity -= hidden_cut;
+            }
+            if (reduce > 0) emit_order_cancelled(order_id, reduce);
+            return;
+        }
+        
+        // A reprice through the opposite side trades like a new order with
+        // the same attributes: an AON order still fills whole or rests, and
+        // an iceberg rests its remainder behind the same peak.
+        bool crosses = is_buy 
+            ? (best_ask_ != INT64_MAX && new_price >= best_ask_)
+            : (best_bid_ >= 0 && new_price <= best_bid_);
+        if (crosses) {
+            const uint32_t user_id = order.user_id_low;
+            const TimeInForce tif = order.is_aon() ? TimeInForce::AON : TimeInForce::GTC;
+            const int64_t peak_size = extra.peak_size;
+            cancel_order_internal(order_id);
+            match_internal(order_id, is_buy, new_price, new_quantity, tif, user_id, peak_size);
+            return;
+        }
+        
+        // Otherwise move the order to the tail of its new level in the same
+        // pool slot; the id index already points at it.
+        remove_from_level_volume(level, idx, old_price);
+        list_remove(level, idx);
+        if (level.empty()) {
+            if (is_buy) {
+                bid_level_count_--;
+                update_best_bid_after_remove(old_price);
+            } else {
+                ask_level_count_--;
+                update_best_ask_after_remove(old_price);
+            }
+        }
+        
+        extra.price = new_price;
+        if (extra.peak_size > 0) {
+            order.quantity = std::min(extra.peak_size, new_quantity);
+            extra.hidden_quantity = new_quantity - order.quantity;
+        } else {
+            order.quantity = new_quantity;
+        }
+        
+        PriceLevel& target = level_for_insert(is_buy, new_price);
+        bool was_empty = target.empty();
+        list_push_back(target, idx);
+        add_to_level_volume(target, idx, new_price);
+        
+        if (was_empty) {
+            if (is_buy) {
+                bid_level_count_++;
+                update_best_bid_after_add(new_price);
+            } else {
+                ask_level_count_++;
+                update_best_ask_after_add(new_price);
+            }
+        }
+        
+        emit_order_accepted(order_id, bool_to_side(is_buy), new_price, new_quantity);
+    }
+    
+    inline PriceLevel* find_stop_level(bool is_buy, int64_t trigger) {
+        StopLadder* stops = (is_buy ? buy_stops_ : sell_stops_).get();
+        if (stops == nullptr) return nullptr;
+        size_t idx = price_to_index(trigger);
+        if (idx < LADDER_LEVELS) [[likely]] {
+            return &stops->levels[idx];
+        }
+        auto it = stops->overflow.find(trigger);
+        return it != stops->overflow.end() ? &it->second : nullptr;
+    }
+
+    inline int64_t lowest_trigger(const StopLadder* stops) const {
+        if (stops == nullptr) return INT64_MAX;
+        int64_t found = INT64_MAX;
+        int64_t idx = bitmap_find_lowest(stops->bitmap.get(), 0);
+        if (idx >= 0) found = index_to_price(idx);
+        if (!stops->overflow.empty()) found = std::min(found, stops->overflow.begin()->first);
+        return found;
+    }
+
+    inline int64_t highest_trigger(const StopLadder* stops) const {
+        if (stops == nullptr) return -1;
+        int64_t found = -1;
+        int64_t idx = bitmap_find_highest(stops->bitmap.get(), LADDER_LEVELS - 1);
+        if (idx >= 0) found = index_to_price(idx);
+        if (!stops->overflow.empty()) found = std::max(found, stops->overflow.rbegin()->first);
+        return found;
+    }
+
+    // Appends a pooled stop to the level at its trigger price.
+    inline void link_stop(uint32_t idx) {
+        const auto& order = hot(idx);
+        const int64_t trigger = cold(idx).price;
+        bool is_buy = order.is_buy();
+        std::unique_ptr<StopLadder>& stops = is_buy ? buy_stops_ : sell_stops_;
+        if (!stops) [[unlikely]] stops = std::make_unique<StopLadder>();
+
+        size_t slot = price_to_index(trigger);
+        PriceLevel* level;
+        if (slot < LADDER_LEVELS) [[likely]] {
+            level = &stops->levels[slot];
+            bitmap_set(stops->bitmap.get(), slot);
+        } else {
+            level = &stops->overflow[trigger];
+        }
+        list_push_back(*level, idx);
+        level->total_volume += order.quantity;
+
+        if (is_buy) {
+            min_buy_trigger_ = std::min(min_buy_trigger_, trigger);
+        } else {
+            max_sell_trigger_ = std::max(max_sell_trigger_, trigger);
+        }
+        // A stop whose trigger the last print already went through fires
+        // at the end of this message.
+        if (last_trade_price_ >= 0) note_print_for_stops(last_trade_price_);
+    }
+
+    inline void clear_stop_level(bool is_buy, int64_t trigger) {
+        StopLadder& stops = *(is_buy ? buy_stops_ : sell_stops_);
+        size_t slot = price_to_index(trigger);
+        if (slot < LADDER_LEVELS) [[likely]] {
+            stops.levels[slot].reset();
+            bitmap_clear(stops.bitmap.get(), slot);
+        } else {
+            stops.overflow.erase(trigger);
+        }
+        if (is_buy) {
+            min_buy_trigger_ = lowest_trigger(buy_stops_.get());
+        } else {
+            max_sell_trigger_ = highest_trigger(sell_stops_.get());
+        }
+    }
+
+    inline void unlink_stop(uint32_t idx) {
+        const auto& order = hot(idx);
+        bool is_buy = order.is_buy();
+        int64_t trigger = cold(idx).price;
+        PriceLevel* level = find_stop_level(is_buy, trigger);
+        level->total_volume -= order.quantity;
+        list_remove(*level, idx);
+        if (level->empty()) clear_stop_level(is_buy, trigger);
+    }
+
+    inline void add_stop_internal(uint64_t order_id, bool is_buy, int64_t trigger_price,
+                                  int64_t limit_price, int64_t quantity, bool is_market,
+                                  uint32_t user_id) {
+        if (!valid_price(trigger_price) || quantity <= 0) [[unlikely]] return;
+        if (!is_market && !valid_price(limit_price)) [[unlikely]] return;
+
+        uint32_t idx = order_pool_.allocate();
+        auto& order = hot(idx);
+        auto& extra = cold(idx);
+        
+        order.order_id = order_id;
+        order.user_id_low = user_id;
+        extra.price = trigger_price;
+        order.quantity = quantity;
+        extra.hidden_quantity = 0;
+        extra.peak_size = is_market ? 0 : limit_price;
+        order.flags = 0;
+        order.set_buy(is_buy);
+        order.set_stop(true);
+        order.set_stop_market(is_market);
+        order.next = NULL_INDEX;
+        order.prev = NULL_INDEX;
+        
+        link_stop(idx);
+        index_order(order_id, idx);
+        track_user(idx);
+        ++stop_count_;
+    }
+
+    // O(1) per trade: compares against the cached extreme trigger on each
+    // side. The print range is kept so a whole run of trades is handled by
+    // one release pass.
+    inline void note_print_for_stops(int64_t price) {
+        if (price >= min_buy_trigger_ || price <= max_sell_trigger_) [[unlikely]] {
+            stops_pending_ = true;
+            stop_print_high_ = std::max(stop_print_high_, price);
+            stop_print_low_ = std::min(stop_print_low_, price);
+        }
+    }
+
+    // Moves every stop on the level at `trigger` into triggered_stops_ in
+    // time priority and frees its pool slot.
+    inline void take_stop_level(bool is_buy, int64_t trigger) {
+        PriceLevel* level = find_stop_level(is_buy, trigger);
+        for (uint32_t curr = level->head; curr != NULL_INDEX; ) {
+            const auto& order = hot(curr);
+            uint32_t next_idx = order.next;
+            triggered_stops_.push_back(TriggeredStop{
+                order.order_id, cold(curr).peak_size, order.quantity, order.user_id_low,
+                is_buy, order.is_stop_market()});
+            unindex_order(order.order_id);
+            untrack_user(curr);
+            order_pool_.free(curr);
+            --stop_count_;
+            curr = next_idx;
+        }
+        clear_stop_level(is_buy, trigger);
+    }
+
+    // Releases every stop whose trigger was printed through: buy stops from
+    // the lowest trigger up, then sell stops from the highest down, whole
+    // levels at a time. Released stops trade through match_internal and may
+    // print through further triggers; the loop runs until the cascade ends.
+    inline void release_stops() {
+        while (stops_pending_) {
+            stops_pending_ = false;
+            int64_t high = stop_print_high_;
+            int64_t low = stop_print_low_;
+            stop_print_high_ = -1;
+            stop_print_low_ = INT64_MAX;
+
+            triggered_stops_.clear();
+            while (min_buy_trigger_ <= high) take_stop_level(true, min_buy_trigger_);
+            while (max_sell_trigger_ >= 0 && max_sell_trigger_ >= low) take_stop_level(false, max_sell_trigger_);
+
+            for (const TriggeredStop& stop : triggered_stops_) {
+                if (stop.is_market) {
+                    match_internal(stop.order_id, stop.is_buy, stop.is_buy ? INT64_MAX : 0,
+                                   stop.quantity, TimeInForce::IOC, stop.user_id);
+                } else {
+                    match_internal(stop.order_id, stop.is_buy, stop.limit_price,
+                                   stop.quantity, TimeInForce::GTC, stop.user_id);
+                }
+            }
+        }
+    }
+
+    // What a taker of `qty` could fill against one level, the same way
+    // match_internal will: the whole regular queue first, then AON orders
+    // smallest first while each still fits.
+    inline int64_t level_fillable(const PriceLevel& level, int64_t qty) const {
+        if (level.total_non_aon_volume >= qty) return qty;
+        int64_t remaining = qty - level.total_non_aon_volume;
+        for (uint32_t curr = level.aon_head; curr != NULL_INDEX; ) {
+            const auto& order = hot(curr);
+            int64_t order_total = order.quantity;
+            if (order_total > remaining) break;
+            remaining -= order_total;
+            curr = order.next;
+        }
+        return qty - remaining;
+    }
+
+    // Stops as soon as the requested quantity is covered; levels without
+    // AON orders cost one comparison.
+    inline int64_t calculate_available_quantity(bool is_buy, int64_t limit_price, 
+                                                int64_t incoming_qty) const {
+        int64_t best = is_buy ? best_ask_ : best_bid_;
+
+        if (is_buy && best == INT64_MAX) return 0;
+        if (!is_buy && best < 0) return 0;
+        
+        int64_t remaining = incoming_qty;
+        
+        if (is_buy) {
+            for (int64_t p = best; p != INT64_MAX && p <= limit_price && remaining > 0;
+                 p = find_ask_at_or_above(p + 1)) {
+                const PriceLevel* level_ptr = find_level(false, p);
+                if (level_ptr == nullptr || level_ptr->empty()) continue;
+                remaining -= level_fillable(*level_ptr, remaining);
+            }
+        } else {
+            for (int64_t p = best; p >= 0 && p >= limit_price && remaining > 0;
+                 p = find_bid_at_or_below(p - 1)) {
+                const PriceLevel* level_ptr = find_level(true, p);
+                if (level_ptr == nullptr || level_ptr->empty()) continue;
+                remaining -= level_fillable(*level_ptr, remaining);
+            }
+        }
+        
+        return incoming_qty - remaining;
     }
     
+    // A GTC remainder rests as an iceberg showing `peak_size` when that is
+    // set, as a plain limit order otherwise.
     inline size_t match_internal(uint64_t order_id, bool is_buy, int64_t price, 
-                                 int64_t quantity, TimeInForce tif) {
-        PriceLevel* levels = is_buy ? ask_levels_.get() : bid_levels_.get();
+                                 int64_t quantity, TimeInForce tif, uint32_t user_id,
+                                 int64_t peak_size = 0) {
         int64_t& best_price = is_buy ? best_ask_ : best_bid_;
 
         bool opposite_side_empty = is_buy ? (best_price == INT64_MAX) : (best_price < 0);
@@ -655,49 +1745,48 @@ private:
         }
 
         if (tif == TimeInForce::AON) {
+            if constexpr (!Policy::AON) return 0;
             int64_t available = calculate_available_quantity(is_buy, price, quantity);
             if (available < quantity) {
-                add_aon_internal(order_id, is_buy, price, quantity, 0);
+                add_aon_internal(order_id, is_buy, price, quantity, user_id);
                 return 0;
             }
         }
         
         int64_t remaining_qty = quantity;
         size_t trade_count = 0;
+        uint32_t levels_swept = 0;
+        // Usually tracks best_price; it only runs ahead of it when a level is
+        // left holding AON orders too large for what remains.
+        int64_t level_price = best_price;
 
         while (remaining_qty > 0 && !opposite_side_empty) {
 
-            if (is_buy && best_price > price) break;
-            if (!is_buy && best_price < price) break;
-            
-            size_t level_idx = price_to_index(best_price);
-            if (level_idx >= MAX_PRICE_LEVELS) break;
+            if (is_buy && level_price > price) break;
+            if (!is_buy && level_price < price) break;
             
-            PriceLevel& level = levels[level_idx];
-            if (level.empty()) {
+            PriceLevel* level_ptr = find_level(!is_buy, level_price);
+            if (level_ptr == nullptr || level_ptr->empty()) {
 
                 if (is_buy) {
-                    update_best_ask_after_remove(best_price);
+                    update_best_ask_after_remove(level_price);
+                    level_price = find_ask_at_or_above(level_price + 1);
+                    opposite_side_empty = level_price == INT64_MAX;
                 } else {
-                    update_best_bid_after_remove(best_price);
+                    update_best_bid_after_remove(level_price);
+                    level_price = find_bid_at_or_below(level_price - 1);
+                    opposite_side_empty = level_price < 0;
                 }
                 continue;
             }
             
-            int64_t current_best = best_price;
+            PriceLevel& level = *level_ptr;
+            int64_t current_best = level_price;
             uint32_t curr = level.head;
             
             while (curr != NULL_INDEX && remaining_qty > 0) {
-                Order& book_order = order_pool_[curr];
+                auto& book_order = hot(curr);
                 uint32_t next_idx = book_order.next;
-
-                if (book_order.is_aon()) {
-                    int64_t aon_total = book_order.quantity + book_order.hidden_quantity;
-                    if (remaining_qty < aon_total) {
-                        curr = next_idx;
-                        continue;
-                    }
-                }
                 
                 int64_t trade_qty = std::min(remaining_qty, book_order.quantity);
 
@@ -707,38 +1796,33 @@ private:
                 trade_count++;
                 
                 remaining_qty -= trade_qty;
-                adjust_level_volume(level, -trade_qty, 0, book_order.is_aon());
+                adjust_level_volume(level, curr, current_best, -trade_qty, 0);
                 book_order.quantity -= trade_qty;
                 
                 if (book_order.quantity == 0) {
-                    if (book_order.hidden_quantity > 0) {
-
+                    if (Policy::ICEBERG && book_order.has_reserve() && cold(curr).hidden_quantity > 0) {
+                        auto& reserve = cold(curr);
                         int64_t replenish = std::min(
-                            book_order.peak_size > 0 ? book_order.peak_size : book_order.hidden_quantity,
-                            book_order.hidden_quantity
+                            reserve.peak_size > 0 ? reserve.peak_size : reserve.hidden_quantity,
+                            reserve.hidden_quantity
                         );
                         
-                        remove_from_level_volume(level, book_order);
+                        remove_from_level_volume(level, curr, current_best);
                         list_remove(level, curr);
                         
                         book_order.quantity = replenish;
-                        book_order.hidden_quantity -= replenish;
+                        reserve.hidden_quantity -= replenish;
                         
                         list_push_back(level, curr);
-                        add_to_level_volume(level, book_order);
-                        
-                        if (book_order.order_id < order_index_.size()) {
-                            order_index_[book_order.order_id].pool_idx = curr;
-                        }
+                        add_to_level_volume(level, curr, current_best);
                     } else {
 
                         list_remove(level, curr);
                         
-                        if (book_order.order_id < order_index_.size()) {
-                            order_index_[book_order.order_id].set_active(false);
-                            active_order_count_--;
-                        }
+                        unindex_order(book_order.order_id);
+                        active_order_count_--;
                         
+                        untrack_user(curr);
                         order_pool_.free(curr);
                     }
                 }
@@ -746,7 +1830,40 @@ private:
                 curr = next_idx;
             }
 
-            if (level.empty()) {
+            // AON orders fill whole, smallest first, once the regular queue
+            // is gone; the first one that does not fit ends the walk.
+            if constexpr (Policy::AON) {
+                if (level.head == NULL_INDEX) {
+                    curr = level.aon_head;
+                    while (curr != NULL_INDEX && remaining_qty > 0) {
+                        auto& book_order = hot(curr);
+                        if (book_order.quantity > remaining_qty) break;
+                        uint32_t next_idx = book_order.next;
+                        
+                        int64_t trade_qty = book_order.quantity;
+                        uint64_t buy_id = is_buy ? order_id : book_order.order_id;
+                        uint64_t sell_id = is_buy ? book_order.order_id : order_id;
+                        emit_trade(buy_id, sell_id, current_best, trade_qty);
+                        trade_count++;
+                        
+                        remaining_qty -= trade_qty;
+                        adjust_level_volume(level, curr, current_best, -trade_qty, 0);
+                        list_remove(level, curr);
+                        unindex_order(book_order.order_id);
+                        active_order_count_--;
+                        untrack_user(curr);
+                        order_pool_.free(curr);
+                        
+                        curr = next_idx;
+                    }
+                }
+            }
+
+            // An emptied overflow level is erased below, so read it first.
+            const bool level_done = level.empty();
+            const bool level_blocked = !level_done && remaining_qty > 0 && level.head == NULL_INDEX;
+            if (level_done) {
+                levels_swept++;
                 if (is_buy) {
                     ask_level_count_--;
                     update_best_ask_after_remove(current_best);
@@ -755,17 +1872,26 @@ private:
                     update_best_bid_after_remove(current_best);
                 }
             }
+            
+            if (level_done || level_blocked) {
+                level_price = is_buy ? find_ask_at_or_above(current_best + 1)
+                                     : find_bid_at_or_below(current_best - 1);
+            }
 
-            opposite_side_empty = is_buy ? (best_price == INT64_MAX) : (best_price < 0);
+            opposite_side_empty = is_buy ? (level_price == INT64_MAX) : (level_price < 0);
         }
 
         if (remaining_qty > 0) {
             switch (tif) {
                 case TimeInForce::GTC:
-                    add_order_internal(order_id, is_buy, price, remaining_qty, 0);
+                    if (peak_size > 0) {
+                        add_iceberg_internal(order_id, is_buy, price, remaining_qty, peak_size, user_id);
+                    } else {
+                        add_order_internal(order_id, is_buy, price, remaining_qty, user_id);
+                    }
                     break;
                 case TimeInForce::AON:
-                    add_aon_internal(order_id, is_buy, price, remaining_qty, 0);
+                    add_aon_internal(order_id, is_buy, price, remaining_qty, user_id);
                     break;
                 case TimeInForce::IOC:
                 case TimeInForce::FOK:
@@ -773,128 +1899,701 @@ private:
             }
         }
         
+        if constexpr (Policy::TELEMETRY) telemetry_->note_match(levels_swept);
         return trade_count;
     }
     
-    inline void reset_internal() {
+    inline void unindex_level(const PriceLevel& level) {
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] return;
+        for (uint32_t head : {level.head, level.aon_head}) {
+            for (uint32_t curr = head; curr != NULL_INDEX; curr = hot(curr).next) {
+                order_map_.erase(hot(curr).order_id);
+            }
+        }
+    }
 
-        for (size_t i = 0; i < MAX_PRICE_LEVELS; ++i) {
-            bid_levels_[i].reset();
-            ask_levels_[i].reset();
+    // Empties every occupied level of one ladder, visiting only what the
+    // bitmap and the overflow map hold. With `announce`, a BOOK_UPDATE with
+    // no volume goes out for each level so downstream images clear too.
+    void clear_ladder(PriceLevel* levels, LevelBitmap* bitmap, OverflowLevels& overflow,
+                      bool is_buy, bool announce) {
+        auto clear = [&](int64_t price, PriceLevel& level) {
+            unindex_level(level);
+            level.reset();
+            if (announce) emit_level_cleared(is_buy, price);
+        };
+        bitmap_drain(bitmap, [&](size_t idx) { clear(index_to_price(idx), levels[idx]); });
+        for (auto& [price, level] : overflow) clear(price, level);
+        overflow.clear();
+    }
+
+    inline void emit_level_cleared(bool is_buy, int64_t price) {
+        if constexpr (!Policy::OUTPUT || !Policy::EMIT_BOOK_UPDATES) return;
+        if (!emit_book_updates_) return;
+        if (use_ring_buffer_) [[likely]] {
+            batch_buffer_[batch_count_++] = OutputMsg::make_book_update(
+                current_timestamp_, bool_to_side(is_buy), price, 0, 0);
+            if (batch_count_ >= BATCH_SIZE) [[unlikely]] flush_batch();
         }
+    }
 
-        std::memset(bid_bitmap_.get(), 0, BITMAP_WORDS * sizeof(uint64_t));
-        std::memset(ask_bitmap_.get(), 0, BITMAP_WORDS * sizeof(uint64_t));
+    // Costs O(occupied levels), plus O(resting orders) with a hashed index:
+    // empty slots are never visited and the direct index is dropped with an
+    // epoch bump. Counters, the ladder window and stop ladder storage are
+    // kept.
+    inline void reset_internal(bool announce = false) {
+        dirty_count_ = 0;
+        clear_ladder(bid_levels_.get(), bid_bitmap_.get(), bid_overflow_, true, announce);
+        clear_ladder(ask_levels_.get(), ask_bitmap_.get(), ask_overflow_, false, announce);
+
+        for (StopLadder* stops : {buy_stops_.get(), sell_stops_.get()}) {
+            if (stops) clear_ladder(stops->levels.get(), stops->bitmap.get(), stops->overflow, false, false);
+        }
+        min_buy_trigger_ = INT64_MAX;
+        max_sell_trigger_ = -1;
+        stop_print_high_ = -1;
+        stop_print_low_ = INT64_MAX;
+        last_trade_price_ = -1;
+        stop_count_ = 0;
+        stops_pending_ = false;
         
         best_bid_ = -1;
         best_ask_ = INT64_MAX;
-        best_bid_word_ = -1;
-        best_ask_word_ = 0;
         bid_level_count_ = 0;
         ask_level_count_ = 0;
         active_order_count_ = 0;
         order_pool_.reset();
-        for (size_t i = 0; i <= max_order_id_ && i < order_index_.size(); ++i) {
-            order_index_[i].set_active(false);
+        clear_order_index();
+        user_heads_.clear();
+        publish_top();
+    }
+
+    template<typename Fn>
+    static void for_each_level(const PriceLevel* levels, const LevelBitmap* bitmap,
+                               const OverflowLevels& overflow, int64_t offset, Fn&& fn) {
+        for (int64_t idx = bitmap_find_lowest(bitmap, 0); idx >= 0;
+             idx = bitmap_find_lowest(bitmap, idx + 1)) {
+            fn(idx + offset, levels[idx]);
         }
+        for (const auto& [price, level] : overflow) fn(price, level);
     }
 
-public:
+    template<typename Fn>
+    void for_each_checkpoint_level(Fn&& fn) const {
+        auto visit = [&](uint8_t kind) {
+            return [&fn, kind](int64_t price, const PriceLevel& level) {
+                if (!level.empty()) fn(kind, price, level);
+            };
+        };
+        for_each_level(bid_levels_.get(), bid_bitmap_.get(), bid_overflow_, price_offset_,
+                       visit(CheckpointLevel::BID));
+        for_each_level(ask_levels_.get(), ask_bitmap_.get(), ask_overflow_, price_offset_,
+                       visit(CheckpointLevel::ASK));
+        if (buy_stops_) {
+            for_each_level(buy_stops_->levels.get(), buy_stops_->bitmap.get(), buy_stops_->overflow,
+                           price_offset_, visit(CheckpointLevel::BUY_STOP));
+        }
+        if (sell_stops_) {
+            for_each_level(sell_stops_->levels.get(), sell_stops_->bitmap.get(), sell_stops_->overflow,
+                           price_offset_, visit(CheckpointLevel::SELL_STOP));
+        }
+    }
 
-    OptimizedOrderBook(size_t order_capacity = 1'000'000)
-        : bid_levels_(std::make_unique<PriceLevel[]>(MAX_PRICE_LEVELS)),
-          ask_levels_(std::make_unique<PriceLevel[]>(MAX_PRICE_LEVELS)),
-          bid_bitmap_(std::make_unique<uint64_t[]>(BITMAP_WORDS)),
-          ask_bitmap_(std::make_unique<uint64_t[]>(BITMAP_WORDS)),
-          order_pool_(order_capacity)
-    {
+    // Links a restored order into the book or stop ladder it belongs to.
+    // Queue order is the file order; AON orders arrive sorted, so their
+    // insert lands at the tail straight away.
+    inline void restore_order(const Order& saved) {
+        uint32_t idx = order_pool_.allocate();
+        Order record = saved;
+        record.next = NULL_INDEX;
+        record.prev = NULL_INDEX;
+        record.set_reserve(!record.is_stop() && (record.peak_size > 0 || record.hidden_quantity > 0));
+        store_order_record(idx, record);
+        
+        index_order(record.order_id, idx);
+        track_user(idx);
+        if (record.is_stop()) {
+            link_stop(idx);
+            ++stop_count_;
+            return;
+        }
+        
+        const bool is_buy = record.is_buy();
+        PriceLevel& level = level_for_insert(is_buy, record.price);
+        bool was_empty = level.empty();
+        list_push_back(level, idx);
+        add_to_level_volume(level, idx, record.price);
+        if (was_empty) {
+            if (is_buy) {
+                bid_level_count_++;
+                update_best_bid_after_add(record.price);
+            } else {
+                ask_level_count_++;
+                update_best_ask_after_add(record.price);
+            }
+        }
+        active_order_count_++;
+    }
 
-        order_index_.resize(INITIAL_ORDER_CAPACITY);
+    bool write_checkpoint(const char* path, uint64_t sequence) const {
+        std::string tmp_path = std::string(path) + ".tmp";
+        std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+        if (file == nullptr) {
+            std::cerr << "[Checkpoint] Cannot open " << tmp_path << std::endl;
+            return false;
+        }
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        
+        CheckpointHeader header{};
+        header.magic = CheckpointHeader::MAGIC;
+        header.version = CheckpointHeader::VERSION;
+        header.order_size = sizeof(Order);
+        header.sequence = sequence;
+        header.timestamp = current_timestamp_;
+        header.price_offset = price_offset_;
+        header.last_trade_price = last_trade_price_;
+        header.messages_processed = messages_processed_;
+        header.trades_executed = trades_executed_;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        
+        for_each_checkpoint_level([&](uint8_t kind, int64_t price, const PriceLevel& level) {
+            CheckpointLevel record{};
+            record.price = price;
+            record.order_count = level.count;
+            record.kind = kind;
+            ok = ok && std::fwrite(&record, sizeof(record), 1, file) == 1;
+            for (uint32_t head : {level.head, level.aon_head}) {
+                for (uint32_t curr = head; curr != NULL_INDEX; curr = hot(curr).next) {
+                    Order order = order_record(curr);
+                    ok = ok && std::fwrite(&order, sizeof(Order), 1, file) == 1;
+                }
+            }
+            header.level_count++;
+            header.order_count += level.count;
+        });
+        
+        // Counts are only known after the walk; patch them into the header.
+        ok = ok && std::fseek(file, 0, SEEK_SET) == 0
+                && std::fwrite(&header, sizeof(header), 1, file) == 1
+                && std::fflush(file) == 0
+                && ::fsync(::fileno(file)) == 0;
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok || std::rename(tmp_path.c_str(), path) != 0) {
+            std::cerr << "[Checkpoint] Write failed for " << path << std::endl;
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static bool type_enabled(const Order& order) {
+        if (!Policy::STOPS && order.is_stop()) return false;
+        if (!Policy::AON && order.is_aon()) return false;
+        // A pending stop keeps its limit price in peak_size.
+        if (!Policy::ICEBERG && !order.is_stop() && order.is_iceberg()) return false;
+        return true;
+    }
 
-        std::memset(bid_bitmap_.get(), 0, BITMAP_WORDS * sizeof(uint64_t));
-        std::memset(ask_bitmap_.get(), 0, BITMAP_WORDS * sizeof(uint64_t));
+    bool load_checkpoint(const uint8_t* data, size_t size, uint64_t* sequence) {
+        if (size < sizeof(CheckpointHeader)) return false;
+        CheckpointHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (!header.is_valid()) return false;
+        if (header.order_count > size / sizeof(Order)) return false;
+        
+        reset_internal();
+        price_offset_ = std::clamp<int64_t>(header.price_offset, 0, MAX_BOOK_PRICE) & ~int64_t{63};
+        order_pool_.reserve(header.order_count);
+        
+        size_t pos = sizeof(CheckpointHeader);
+        uint64_t orders_seen = 0;
+        for (uint64_t l = 0; l < header.level_count; ++l) {
+            if (size - pos < sizeof(CheckpointLevel)) return false;
+            CheckpointLevel record;
+            std::memcpy(&record, data + pos, sizeof(record));
+            pos += sizeof(record);
+            if (record.kind > CheckpointLevel::SELL_STOP) return false;
+            if ((size - pos) / sizeof(Order) < record.order_count) return false;
+            
+            const bool stop = record.kind >= CheckpointLevel::BUY_STOP;
+            const bool buy = record.kind == CheckpointLevel::BID || record.kind == CheckpointLevel::BUY_STOP;
+            for (uint32_t i = 0; i < record.order_count; ++i) {
+                Order order;
+                std::memcpy(&order, data + pos, sizeof(Order));
+                pos += sizeof(Order);
+                if (order.price != record.price || order.is_buy() != buy || order.is_stop() != stop ||
+                    !valid_price(order.price) || !type_enabled(order) ||
+                    (order.is_aon() && order.hidden_quantity != 0) ||
+                    lookup_order(order.order_id) != NULL_INDEX) {
+                    return false;
+                }
+                restore_order(order);
+            }
+            orders_seen += record.order_count;
+        }
+        if (orders_seen != header.order_count || pos != size) return false;
+        
+        // Set after the stops are linked so none of them fires on restore.
+        last_trade_price_ = header.last_trade_price;
+        stops_pending_ = false;
+        messages_processed_ = header.messages_processed;
+        trades_executed_ = header.trades_executed;
+        current_timestamp_ = header.timestamp;
+        dirty_count_ = 0;
+        if (sequence) *sequence = header.sequence;
+        return true;
+    }
+
+    // Batched input prefetches each upcoming message in two stages,
+    // PREFETCH_STAGE_GAP messages apart: first the index slot of the order
+    // id it carries, then, once that line has landed, the pool slot the
+    // index points at. Every order message carries its id right after the
+    // header, so neither stage switches on the type again (with a random
+    // type mix that branch mispredicts often enough to cost what the
+    // prefetch saves). Unknown ids resolve to slot 0 by conditional move.
+    // Both stages are hints only; each message still runs in order.
+    inline void prefetch_early(const MsgHeader* header) const {
+        if (header->length < sizeof(MsgCancel)) [[unlikely]] return;
+        prefetch_index(msg_cast<MsgCancel>(header)->order_id);
+    }
+
+    inline void prefetch_late(const MsgHeader* header) const {
+        if (header->length < sizeof(MsgCancel) || active_order_count_ == 0) [[unlikely]] return;
+        uint64_t order_id = msg_cast<MsgCancel>(header)->order_id;
+        uint32_t idx;
+        if (index_mode_ == OrderIndexMode::DIRECT) [[likely]] {
+            const OrderLocation& loc = order_index_[order_id < order_index_.size() ? order_id : 0];
+            idx = loc.epoch == index_epoch_ ? loc.pool_idx : 0;
+        } else {
+            idx = order_map_.find(order_id);
+            idx = idx == NULL_INDEX ? 0 : idx;
+        }
+        __builtin_prefetch(&hot(idx), 1);
+        if constexpr (Policy::SPLIT_ORDERS) __builtin_prefetch(&cold(idx), 1);
+    }
 
-        for (size_t i = 0; i < MAX_PRICE_LEVELS; ++i) {
-            bid_levels_[i].reset();
-            ask_levels_[i].reset();
+    template<typename HeaderAt>
+    inline void apply_prefetched(size_t count, HeaderAt header_at) {
+        constexpr size_t EARLY = 2 * PREFETCH_STAGE_GAP;
+        constexpr size_t LATE = PREFETCH_STAGE_GAP;
+        for (size_t i = 0; i < std::min(count, EARLY); ++i) {
+            prefetch_early(header_at(i));
         }
+        for (size_t i = 0; i < count; ++i) {
+            if (i + EARLY < count) prefetch_early(header_at(i + EARLY));
+            if (i + LATE < count) prefetch_late(header_at(i + LATE));
+            process_message_no_lock(header_at(i));
+        }
+    }
+
+    // Complete, well-formed message at `offset`, or nullptr.
+    static inline const MsgHeader* frame_at(const uint8_t* buf, size_t len, size_t offset) {
+        if (offset + sizeof(MsgHeader) > len) return nullptr;
+        const MsgHeader* header = reinterpret_cast<const MsgHeader*>(buf + offset);
+        if (header->length < sizeof(MsgHeader) || header->length > len - offset) return nullptr;
+        if (header->length < message_size(header->type)) return nullptr;
+        return header;
+    }
+
+public:
+    using policy_type = Policy;
+
+    // `arena` places the book's tables: pass the NUMA node of the core
+    // that will run matching (numa_node_of_core) to keep them local to it.
+    BasicOrderBook(size_t order_capacity = 1'000'000, int64_t price_anchor = PRICE_OFFSET,
+                   OutputBuffer* shared_output = nullptr,
+                   OrderIndexMode index_mode = OrderIndexMode::DIRECT,
+                   const ArenaConfig& arena = {})
+        : bid_levels_(LADDER_LEVELS, arena),
+          ask_levels_(LADDER_LEVELS, arena),
+          bid_bitmap_(1, arena),
+          ask_bitmap_(1, arena),
+          price_offset_(std::clamp<int64_t>(price_anchor, 0, MAX_BOOK_PRICE) & ~int64_t{63}),
+          order_pool_(order_capacity, arena),
+          index_mode_(index_mode),
+          order_index_(index_mode == OrderIndexMode::DIRECT
+                           ? std::min(INITIAL_ORDER_CAPACITY, order_capacity) : 0, arena),
+          order_map_(index_mode == OrderIndexMode::HASHED ? order_capacity : 0, arena),
+          owned_output_(shared_output || !Policy::OUTPUT ? nullptr : new OutputBuffer),
+          output_buffer_(shared_output ? shared_output : owned_output_.get()),
+          telemetry_(std::make_unique<EngineTelemetry>())
+    {
+        publish_top();
     }
 
     inline void add_order(uint64_t order_id, bool is_buy, int64_t price, 
                           int64_t quantity, uint32_t user_id = 0) {
         std::unique_lock lock(book_mutex_);
+        begin_message(BookOp::ADD);
 
         bool is_aggressive = is_buy 
             ? (best_ask_ != INT64_MAX && price >= best_ask_)
             : (best_bid_ >= 0 && price <= best_bid_);
         
         if (is_aggressive) {
-            match_internal(order_id, is_buy, price, quantity, TimeInForce::GTC);
+            match_internal(order_id, is_buy, price, quantity, TimeInForce::GTC, user_id);
         } else {
             add_order_internal(order_id, is_buy, price, quantity, user_id);
         }
+        end_message();
     }
 
     inline void add_order_no_lock(uint64_t order_id, bool is_buy, int64_t price, 
                                   int64_t quantity, uint32_t user_id = 0) {
+        begin_message(BookOp::ADD);
 
         bool is_aggressive = is_buy 
             ? (best_ask_ != INT64_MAX && price >= best_ask_)
             : (best_bid_ >= 0 && price <= best_bid_);
         
         if (is_aggressive) {
-            match_internal(order_id, is_buy, price, quantity, TimeInForce::GTC);
+            match_internal(order_id, is_buy, price, quantity, TimeInForce::GTC, user_id);
         } else {
             add_order_internal(order_id, is_buy, price, quantity, user_id);
         }
+        end_message();
     }
     
+    // A marketable iceberg matches its full size first; any remainder then
+    // rests as an iceberg showing visible_quantity.
+    inline void add_iceberg_order_no_lock(uint64_t order_id, bool is_buy, int64_t price,
+                                          int64_t total_quantity, int64_t visible_quantity,
+                                          uint32_t user_id = 0) {
+        begin_message(BookOp::ADD_ICEBERG);
+        if constexpr (Policy::ICEBERG) {
+            bool is_aggressive = is_buy 
+                ? (best_ask_ != INT64_MAX && price >= best_ask_)
+                : (best_bid_ >= 0 && price <= best_bid_);
+            
+            if (is_aggressive) {
+                match_internal(order_id, is_buy, price, total_quantity, TimeInForce::GTC, user_id,
+                               visible_quantity);
+            } else {
+                add_iceberg_internal(order_id, is_buy, price, total_quantity, visible_quantity, user_id);
+            }
+        }
+        end_message();
+    }
+
     inline void cancel_order_no_lock(uint64_t order_id) {
+        begin_message(BookOp::CANCEL);
         cancel_order_internal(order_id);
+        end_message();
+    }
+
+    // Stop-limit (is_market = false) rests as a GTC limit at limit_price once
+    // a trade prints at or through trigger_price; stop-market sweeps as IOC.
+    inline void add_stop_order_no_lock(uint64_t order_id, bool is_buy, int64_t trigger_price,
+                                       int64_t limit_price, int64_t quantity, bool is_market,
+                                       uint32_t user_id = 0) {
+        begin_message(BookOp::ADD_STOP);
+        if constexpr (Policy::STOPS) {
+            add_stop_internal(order_id, is_buy, trigger_price, limit_price, quantity, is_market, user_id);
+        }
+        end_message();
+    }
+
+    inline void modify_order_no_lock(uint64_t order_id, int64_t new_price, int64_t new_quantity) {
+        begin_message(BookOp::MODIFY);
+        modify_order_internal(order_id, new_price, new_quantity);
+        end_message();
+    }
+
+    // Cancels every resting order and pending stop of `user_id` on `side`
+    // (Side::BUY, Side::SELL or MASS_CANCEL_BOTH_SIDES) whose price lies in
+    // [min_price, max_price]; a pending stop is selected by its trigger.
+    // Emits one ORDER_CANCELLED per order and returns how many there were.
+    inline size_t mass_cancel_no_lock(uint32_t user_id, uint8_t side = MASS_CANCEL_BOTH_SIDES,
+                                      int64_t min_price = 0, int64_t max_price = INT64_MAX) {
+        begin_message(BookOp::MASS_CANCEL);
+        size_t cancelled = 0;
+        if constexpr (Policy::MASS_CANCEL) {
+            cancelled = mass_cancel_internal(user_id, side, min_price, max_price);
+        }
+        end_message();
+        return cancelled;
+    }
+
+    // Empties the book (RESET): for benchmark reruns and session rollover.
+    // Each cleared level is announced as a zero-volume BOOK_UPDATE.
+    inline void reset_no_lock() {
+        begin_message(BookOp::RESET);
+        reset_internal(true);
+        end_message();
+    }
+
+    inline void match_order_no_lock(uint64_t order_id, bool is_buy, int64_t price,
+                                    int64_t quantity, TimeInForce tif = TimeInForce::GTC,
+                                    uint32_t user_id = 0) {
+        begin_message(BookOp::MATCH);
+        match_internal(order_id, is_buy, price, quantity, tif, user_id);
+        end_message();
+    }
+
+    // Applies the framed messages in buf[0, len) strictly in order. Each
+    // pass decodes up to BATCH_DECODE messages first so index, pool and
+    // level lines are prefetched while earlier messages run. Stops at an
+    // incomplete or malformed message and returns the bytes consumed; the
+    // caller keeps the remainder.
+    inline size_t process_batch_no_lock(const uint8_t* buf, size_t len, size_t* messages = nullptr) {
+        const MsgHeader* frames[BATCH_DECODE];
+        size_t offset = 0;
+        size_t total = 0;
+        for (;;) {
+            size_t n = 0;
+            while (n < BATCH_DECODE) {
+                const MsgHeader* header = frame_at(buf, len, offset);
+                if (header == nullptr) break;
+                frames[n++] = header;
+                offset += header->length;
+            }
+            apply_prefetched(n, [&](size_t i) { return frames[i]; });
+            total += n;
+            if (n < BATCH_DECODE) break;
+        }
+        if (messages) *messages = total;
+        return offset;
+    }
+
+    inline size_t process_batch(const uint8_t* buf, size_t len, size_t* messages = nullptr) {
+        std::unique_lock lock(book_mutex_);
+        size_t consumed = process_batch_no_lock(buf, len, messages);
+        flush_output_buffer();
+        return consumed;
+    }
+
+    // Decodes one wire message and applies it without taking the book lock.
+    // For books owned by a single thread (one book per shard worker).
+    inline void process_message_no_lock(const MsgHeader* header) {
+        current_timestamp_ = header->timestamp;
+        switch (header->type) {
+            case MsgType::ADD_ORDER: {
+                const auto* msg = msg_cast<MsgAddOrder>(header);
+                add_order_no_lock(msg->order_id, side_to_bool(msg->side),
+                                  msg->price, msg->quantity,
+                                  static_cast<uint32_t>(msg->user_id));
+                break;
+            }
+
+            case MsgType::ADD_ICEBERG: {
+                const auto* msg = msg_cast<MsgAddIceberg>(header);
+                add_iceberg_order_no_lock(msg->order_id, side_to_bool(msg->side),
+                                          msg->price, msg->total_quantity, msg->visible_quantity,
+                                          static_cast<uint32_t>(msg->user_id));
+                break;
+            }
+
+            case MsgType::ADD_AON: {
+                const auto* msg = msg_cast<MsgAddAON>(header);
+                match_order_no_lock(msg->order_id, side_to_bool(msg->side),
+                                    msg->price, msg->quantity, TimeInForce::AON,
+                                    static_cast<uint32_t>(msg->user_id));
+                break;
+            }
+
+            case MsgType::CANCEL_ORDER:
+                cancel_order_no_lock(msg_cast<MsgCancel>(header)->order_id);
+                break;
+
+            case MsgType::MODIFY_ORDER: {
+                const auto* msg = msg_cast<MsgModify>(header);
+                modify_order_no_lock(msg->order_id, msg->new_price, msg->new_quantity);
+                break;
+            }
+
+            case MsgType::ADD_STOP:
+            case MsgType::ADD_STOP_MARKET: {
+                const auto* msg = msg_cast<MsgAddStop>(header);
+                add_stop_order_no_lock(msg->order_id, side_to_bool(msg->side),
+                                       msg->trigger_price, msg->limit_price, msg->quantity,
+                                       header->type == MsgType::ADD_STOP_MARKET || msg->is_market,
+                                       static_cast<uint32_t>(msg->user_id));
+                break;
+            }
+
+            case MsgType::EXECUTE: {
+                const auto* msg = msg_cast<MsgExecute>(header);
+                match_order_no_lock(msg->order_id, side_to_bool(msg->side),
+                                    msg->price, msg->quantity,
+                                    tif_from_protocol(msg->time_in_force),
+                                    static_cast<uint32_t>(msg->user_id));
+                break;
+            }
+
+            case MsgType::MASS_CANCEL: {
+                const auto* msg = msg_cast<MsgMassCancel>(header);
+                mass_cancel_no_lock(static_cast<uint32_t>(msg->user_id), msg->side,
+                                    msg->min_price, msg->max_price);
+                break;
+            }
+
+            case MsgType::RESET:
+                reset_no_lock();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // Applies a batch of framed messages under a single lock acquisition.
+    inline void process_messages(const InputSlot* slots, size_t count) {
+        std::unique_lock lock(book_mutex_);
+        apply_prefetched(count, [&](size_t i) { return slots[i].header(); });
+        flush_output_buffer();
     }
 
     inline void match_order(uint64_t order_id, bool is_buy, int64_t price,
-                            int64_t quantity, TimeInForce tif = TimeInForce::GTC) {
+                            int64_t quantity, TimeInForce tif = TimeInForce::GTC,
+                            uint32_t user_id = 0) {
         std::unique_lock lock(book_mutex_);
-        match_internal(order_id, is_buy, price, quantity, tif);
+        begin_message(BookOp::MATCH);
+        match_internal(order_id, is_buy, price, quantity, tif, user_id);
+        end_message();
     }
     
     inline void cancel_order(uint64_t order_id) {
         std::unique_lock lock(book_mutex_);
+        begin_message(BookOp::CANCEL);
         cancel_order_internal(order_id);
+        end_message();
+    }
+
+    inline void reset() {
+        std::unique_lock lock(book_mutex_);
+        reset_no_lock();
+    }
+
+    inline size_t mass_cancel(uint32_t user_id, uint8_t side = MASS_CANCEL_BOTH_SIDES,
+                              int64_t min_price = 0, int64_t max_price = INT64_MAX) {
+        std::unique_lock lock(book_mutex_);
+        return mass_cancel_no_lock(user_id, side, min_price, max_price);
+    }
+
+    inline void add_stop_order(uint64_t order_id, bool is_buy, int64_t trigger_price,
+                               int64_t limit_price, int64_t quantity, bool is_market,
+                               uint32_t user_id = 0) {
+        std::unique_lock lock(book_mutex_);
+        begin_message(BookOp::ADD_STOP);
+        if constexpr (Policy::STOPS) {
+            add_stop_internal(order_id, is_buy, trigger_price, limit_price, quantity, is_market, user_id);
+        }
+        end_message();
+    }
+
+    inline void modify_order(uint64_t order_id, int64_t new_price, int64_t new_quantity) {
+        std::unique_lock lock(book_mutex_);
+        begin_message(BookOp::MODIFY);
+        modify_order_internal(order_id, new_price, new_quantity);
+        end_message();
+    }
+
+    // Writes the resting book, pending stops and counters to `path` (via a
+    // temporary file and rename, so a crash never leaves a torn checkpoint).
+    // `sequence` is the caller's input sequence number, typically the last
+    // journal position applied; restore() hands it back so replay can
+    // resume from there.
+    inline bool checkpoint(const char* path, uint64_t sequence = 0) const {
+        std::shared_lock lock(book_mutex_);
+        return write_checkpoint(path, sequence);
+    }
+
+    // Replaces the book with the contents of a checkpoint. The file is
+    // mapped read-only and orders are relinked into fresh pool slots. On a
+    // missing or malformed file the book is left empty and false returned.
+    inline bool restore(const char* path, uint64_t* sequence = nullptr) {
+        std::unique_lock lock(book_mutex_);
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[Checkpoint] Cannot open " << path << std::endl;
+            return false;
+        }
+        struct stat st{};
+        bool ok = false;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_t size = static_cast<size_t>(st.st_size);
+            void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                ::madvise(map, size, MADV_SEQUENTIAL);
+                ok = load_checkpoint(static_cast<const uint8_t*>(map), size, sequence);
+                ::munmap(map, size);
+            }
+        }
+        ::close(fd);
+        if (!ok) {
+            std::cerr << "[Checkpoint] Invalid checkpoint " << path << std::endl;
+            reset_internal();
+            return false;
+        }
+        publish_top();
+        return true;
     }
 
     inline void use_ring_buffer_output(bool enable = true) { use_ring_buffer_ = enable; }
     inline void set_benchmark_mode(bool trades_only = true) {
         emit_accepts_ = !trades_only;
         emit_cancels_ = !trades_only;
+        emit_book_updates_ = !trades_only;
     }
     inline void set_emit_accepts(bool enable) { emit_accepts_ = enable; }
     inline void set_emit_cancels(bool enable) { emit_cancels_ = enable; }
-    inline void flush_output_buffer() { flush_batch(); }
+    inline void set_emit_book_updates(bool enable) { emit_book_updates_ = enable; }
+    inline void flush_output_buffer() {
+        flush_batch();
+        publish_top();
+    }
+
+    inline OutputBuffer& get_output_buffer() { return *output_buffer_; }
+    inline const OutputBuffer& get_output_buffer() const { return *output_buffer_; }
+
+    inline void set_symbol_id(uint16_t symbol_id) { symbol_id_ = symbol_id; }
+    inline uint16_t symbol_id() const { return symbol_id_; }
 
-    inline OutputBuffer& get_output_buffer() { return output_buffer_; }
-    inline const OutputBuffer& get_output_buffer() const { return output_buffer_; }
+    // Wait-free for the writer, lock-free for readers: safe to call from any
+    // thread while another thread matches, with or without the book lock.
+    inline TopOfBook top_of_book() const { return published_top_.load(); }
 
     inline int64_t get_best_bid() const { 
-        std::shared_lock lock(book_mutex_);
-        return best_bid_ >= 0 ? best_bid_ : 0; 
+        int64_t bid = published_top_.load().best_bid;
+        return bid >= 0 ? bid : 0; 
     }
     inline int64_t get_best_ask() const { 
-        std::shared_lock lock(book_mutex_);
-        return best_ask_;
+        return published_top_.load().best_ask;
     }
     
     inline int64_t get_best_bid_volume() const {
-        std::shared_lock lock(book_mutex_);
-        if (best_bid_ < 0) return 0;
-        return bid_levels_[price_to_index(best_bid_)].total_visible_volume;
+        return published_top_.load().best_bid_volume;
     }
     
     inline int64_t get_best_ask_volume() const {
+        return published_top_.load().best_ask_volume;
+    }
+
+    // Fills out[0..n) with the top n visible levels of one side, best first.
+    // Walks the occupancy bitmaps from the BBO; allocates nothing.
+    inline size_t get_depth(Side side, size_t n, DepthLevel* out) const {
         std::shared_lock lock(book_mutex_);
-        if (best_ask_ == INT64_MAX) return 0;
-        return ask_levels_[price_to_index(best_ask_)].total_visible_volume;
+        return get_depth_no_lock(side, n, out);
+    }
+
+    inline size_t get_depth_no_lock(Side side, size_t n, DepthLevel* out) const {
+        bool is_buy = side == Side::BUY;
+        size_t filled = 0;
+
+        if (is_buy) {
+            for (int64_t p = best_bid_; p >= 0 && filled < n; p = find_bid_at_or_below(p - 1)) {
+                const PriceLevel* level = find_level(true, p);
+                if (level == nullptr || level->total_visible_volume <= 0) continue;
+                out[filled++] = DepthLevel{p, level->total_visible_volume, level->count};
+            }
+        } else {
+            for (int64_t p = best_ask_; p != INT64_MAX && filled < n; p = find_ask_at_or_above(p + 1)) {
+                const PriceLevel* level = find_level(false, p);
+                if (level == nullptr || level->total_visible_volume <= 0) continue;
+                out[filled++] = DepthLevel{p, level->total_visible_volume, level->count};
+            }
+        }
+        return filled;
     }
 
     inline std::map<int64_t, int64_t, std::greater<int64_t>> get_bids_snapshot() const {
@@ -902,10 +2601,10 @@ public:
         
         std::map<int64_t, int64_t, std::greater<int64_t>> result;
         
-        for (size_t i = 0; i < MAX_PRICE_LEVELS; ++i) {
-            if (bid_levels_[i].total_visible_volume > 0) {
-                int64_t price = index_to_price(i);
-                result[price] = bid_levels_[i].total_visible_volume;
+        for (int64_t p = best_bid_; p >= 0; p = find_bid_at_or_below(p - 1)) {
+            const PriceLevel* level = find_level(true, p);
+            if (level != nullptr && level->total_visible_volume > 0) {
+                result.emplace_hint(result.end(), p, level->total_visible_volume);
             }
         }
         return result;
@@ -916,45 +2615,78 @@ public:
         
         std::map<int64_t, int64_t> result;
         
-        for (size_t i = 0; i < MAX_PRICE_LEVELS; ++i) {
-            if (ask_levels_[i].total_visible_volume > 0) {
-                int64_t price = index_to_price(i);
-                result[price] = ask_levels_[i].total_visible_volume;
+        for (int64_t p = best_ask_; p != INT64_MAX; p = find_ask_at_or_above(p + 1)) {
+            const PriceLevel* level = find_level(false, p);
+            if (level != nullptr && level->total_visible_volume > 0) {
+                result.emplace_hint(result.end(), p, level->total_visible_volume);
             }
         }
         return result;
     }
 
     inline uint64_t messages_processed() const { 
-        std::shared_lock lock(book_mutex_);
-        return messages_processed_; 
+        return published_top_.load().messages_processed; 
     }
     inline uint64_t trades_executed() const { 
-        std::shared_lock lock(book_mutex_);
-        return trades_executed_; 
+        return published_top_.load().trades_executed; 
     }
     inline uint64_t messages_dropped() const { 
-        std::shared_lock lock(book_mutex_);
-        return messages_dropped_; 
+        return published_top_.load().messages_dropped; 
     }
     inline size_t order_count() const { 
-        std::shared_lock lock(book_mutex_);
-        return active_order_count_; 
+        return published_top_.load().order_count; 
     }
     inline size_t bid_levels() const { 
-        std::shared_lock lock(book_mutex_);
-        return bid_level_count_; 
+        return published_top_.load().bid_levels; 
     }
     inline size_t ask_levels() const { 
+        return published_top_.load().ask_levels; 
+    }
+    inline int64_t price_anchor() const {
+        std::shared_lock lock(book_mutex_);
+        return price_offset_;
+    }
+    inline size_t overflow_levels() const {
         std::shared_lock lock(book_mutex_);
-        return ask_level_count_; 
+        return bid_overflow_.size() + ask_overflow_.size();
+    }
+    inline size_t stop_count() const {
+        std::shared_lock lock(book_mutex_);
+        return stop_count_;
+    }
+    inline int64_t last_trade_price() const {
+        std::shared_lock lock(book_mutex_);
+        return last_trade_price_;
+    }
+    inline uint64_t recentre_count() const {
+        std::shared_lock lock(book_mutex_);
+        return recentre_count_;
     }
     inline size_t pool_capacity() const { return order_pool_.capacity(); }
     inline size_t pool_used() const { 
         std::shared_lock lock(book_mutex_);
         return order_pool_.used_count(); 
     }
-    inline size_t output_buffer_size() const { return output_buffer_.size_approx(); }
+    inline size_t output_buffer_size() const { return output_buffer_->size_approx(); }
+
+    // Safe to read from any thread without the book lock.
+    inline const EngineTelemetry& telemetry() const { return *telemetry_; }
+
+    // Faults the book's tables in on a background thread, so the first
+    // orders after startup do not pay for it. Without this, pages are
+    // faulted in by whichever thread first touches them.
+    inline void prefault_async() {
+        std::unique_lock lock(book_mutex_);
+        if (!prefaulter_) prefaulter_ = std::make_unique<ArenaPrefaulter>(arena_ranges());
+    }
+    inline bool prefault_done() const { return prefaulter_ && prefaulter_->done(); }
+
+    inline ArenaUsage arena_usage() const {
+        std::shared_lock lock(book_mutex_);
+        return summarize_ranges(arena_ranges());
+    }
 };
 
+using OptimizedOrderBook = BasicOrderBook<>;
+
 #endif
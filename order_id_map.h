@@ -0,0 +1,142 @@
+#ifndef ORDER_ID_MAP_H
+#define ORDER_ID_MAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "object_pool.h"
+
+// Flat open-addressing map from 64-bit order id to pool index. Robin Hood
+// linear probing keeps probe lengths short at 7/8 load; erase shifts the
+// following run back by one instead of leaving tombstones, so lookups never
+// degrade under cancel-heavy flow. Each slot is 16 bytes; an all-zero slot
+// is empty, so the table is used straight from a fresh arena mapping.
+class OrderIdMap {
+private:
+    struct Slot {
+        uint64_t key;
+        uint32_t value;
+        uint32_t dist;  // probe distance + 1; 0 marks an empty slot
+    };
+    static_assert(sizeof(Slot) == 16, "Slot must be 16 bytes");
+
+    static constexpr size_t MIN_CAPACITY = 1024;
+
+    ArenaArray<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    ArenaConfig arena_;
+
+    static inline uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static inline size_t round_up_pow2(size_t n) {
+        size_t cap = MIN_CAPACITY;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    inline size_t find_slot(uint64_t key) const {
+        size_t i = hash(key) & mask_;
+        for (uint32_t dist = 1; ; ++dist) {
+            const Slot& slot = slots_[i];
+            if (slot.dist < dist) return SIZE_MAX;
+            if (slot.key == key) return i;
+            i = (i + 1) & mask_;
+        }
+    }
+
+    void allocate(size_t capacity) {
+        slots_ = ArenaArray<Slot>(capacity, arena_);
+        mask_ = capacity - 1;
+        size_ = 0;
+    }
+
+    void grow() {
+        ArenaArray<Slot> old = std::move(slots_);
+        size_t old_capacity = mask_ + 1;
+        allocate(old_capacity * 2);
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old[i].dist != 0) insert_or_assign(old[i].key, old[i].value);
+        }
+    }
+
+public:
+    explicit OrderIdMap(size_t expected = MIN_CAPACITY, const ArenaConfig& arena = {})
+        : arena_(arena) {
+        allocate(round_up_pow2(expected + expected / 7 + 1));
+    }
+
+    // Pulls the key's home slot towards L1 ahead of a find().
+    inline void prefetch(uint64_t key) const {
+        __builtin_prefetch(&slots_[hash(key) & mask_]);
+    }
+
+    inline uint32_t find(uint64_t key) const {
+        size_t i = find_slot(key);
+        return i == SIZE_MAX ? NULL_INDEX : slots_[i].value;
+    }
+
+    inline void insert_or_assign(uint64_t key, uint32_t value) {
+        if ((size_ + 1) * 8 > (mask_ + 1) * 7) [[unlikely]] grow();
+
+        Slot carry{key, value, 1};
+        bool displaced = false;
+        size_t i = hash(key) & mask_;
+        while (true) {
+            Slot& slot = slots_[i];
+            if (slot.dist == 0) {
+                slot = carry;
+                ++size_;
+                return;
+            }
+            if (!displaced && slot.key == key) {
+                slot.value = value;
+                return;
+            }
+            if (slot.dist < carry.dist) {
+                std::swap(slot, carry);
+                displaced = true;
+            }
+            ++carry.dist;
+            i = (i + 1) & mask_;
+        }
+    }
+
+    inline bool erase(uint64_t key) {
+        size_t i = find_slot(key);
+        if (i == SIZE_MAX) return false;
+
+        size_t next = (i + 1) & mask_;
+        while (slots_[next].dist > 1) {
+            slots_[i] = slots_[next];
+            --slots_[i].dist;
+            i = next;
+            next = (next + 1) & mask_;
+        }
+        slots_[i].dist = 0;
+        --size_;
+        return true;
+    }
+
+    void clear() {
+        for (size_t i = 0; i <= mask_; ++i) slots_[i].dist = 0;
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return mask_ + 1; }
+    size_t memory_bytes() const { return capacity() * sizeof(Slot); }
+    ArenaRange range() const { return slots_.range(); }
+};
+
+#endif
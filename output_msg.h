@@ -6,6 +6,7 @@
 
 struct OutputMsg {
     OutMsgType type;
+    uint16_t symbol_id;
     uint64_t timestamp;
     
     union {
@@ -28,6 +29,13 @@ struct OutputMsg {
             int64_t cancelled_qty;
         } cancelled;
         
+        struct {
+            Side side;
+            int64_t price;
+            int64_t visible_volume;
+            uint32_t order_count;
+        } book_update;
+        
         uint8_t _pad[48];
     };
     
@@ -63,6 +71,18 @@ struct OutputMsg {
         msg.cancelled.cancelled_qty = qty;
         return msg;
     }
+    
+    static OutputMsg make_book_update(uint64_t ts, Side side, int64_t price,
+                                      int64_t visible_volume, uint32_t order_count) {
+        OutputMsg msg{};
+        msg.type = OutMsgType::BOOK_UPDATE;
+        msg.timestamp = ts;
+        msg.book_update.side = side;
+        msg.book_update.price = price;
+        msg.book_update.visible_volume = visible_volume;
+        msg.book_update.order_count = order_count;
+        return msg;
+    }
 };
 
 static_assert(sizeof(OutputMsg) <= 64, "OutputMsg should fit in a cache line");
@@ -0,0 +1,209 @@
+#ifndef OUTPUT_PUBLISHER_H
+#define OUTPUT_PUBLISHER_H
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#include "order_book.h"
+#include "logger.h"
+#include "titan_ws_server.h"
+#include "thread_utils.h"
+
+// A consumer of engine output. Sinks run on the publisher thread, one
+// batch at a time, and must not block for long: a slow sink shows up as
+// publisher lag and, once the ring fills, as drops in the book.
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual void on_messages(const OutputMsg* msgs, size_t count) = 0;
+    // Called when the ring is empty; lets sinks flush partial work.
+    virtual void on_idle() {}
+};
+
+class LoggerSink : public OutputSink {
+    deepflow::BinaryLogger& logger_;
+
+public:
+    explicit LoggerSink(deepflow::BinaryLogger& logger) : logger_(logger) {}
+
+    void on_messages(const OutputMsg* msgs, size_t count) override {
+        logger_.log_batch(msgs, count);
+    }
+};
+
+// Collects trades and broadcasts them as one JSON frame at most every
+// interval_ms, so a burst of fills costs one frame rather than one each.
+// Only the newest MAX_TRADES_PER_FRAME trades of an interval are kept; the
+// older ones are overwritten and counted in trades_dropped().
+class WebSocketTradeSink : public OutputSink {
+    static constexpr size_t MAX_TRADES_PER_FRAME = 256;
+    static_assert((MAX_TRADES_PER_FRAME & (MAX_TRADES_PER_FRAME - 1)) == 0,
+                  "MAX_TRADES_PER_FRAME must be a power of 2");
+
+    TitanWebSocketServer& server_;
+    std::chrono::milliseconds interval_;
+    std::chrono::steady_clock::time_point last_send_{};
+    OutputMsg pending_[MAX_TRADES_PER_FRAME];
+    size_t pending_head_ = 0;
+    size_t pending_count_ = 0;
+    uint64_t trades_dropped_ = 0;
+    JsonBuilder json_;
+
+public:
+    explicit WebSocketTradeSink(TitanWebSocketServer& server, int interval_ms = 50)
+        : server_(server), interval_(interval_ms) {}
+
+    void on_messages(const OutputMsg* msgs, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            if (msgs[i].type != OutMsgType::TRADE) continue;
+            if (pending_count_ == MAX_TRADES_PER_FRAME) {
+                pending_[pending_head_] = msgs[i];
+                pending_head_ = (pending_head_ + 1) & (MAX_TRADES_PER_FRAME - 1);
+                ++trades_dropped_;
+            } else {
+                pending_[(pending_head_ + pending_count_++) & (MAX_TRADES_PER_FRAME - 1)] = msgs[i];
+            }
+        }
+        maybe_send();
+    }
+
+    void on_idle() override { maybe_send(); }
+
+    uint64_t trades_dropped() const { return trades_dropped_; }
+
+private:
+    void maybe_send() {
+        if (pending_count_ == 0) return;
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_send_ < interval_) return;
+        last_send_ = now;
+
+        json_.clear();
+        json_.begin_object();
+        json_.key("type").value("trades");
+        json_.key("trades").begin_array();
+        for (size_t i = 0; i < pending_count_; ++i) {
+            const OutputMsg& msg = pending_[(pending_head_ + i) & (MAX_TRADES_PER_FRAME - 1)];
+            json_.array_item().begin_array();
+            json_.array_item().value(msg.trade.price);
+            json_.array_item().value(msg.trade.quantity);
+            json_.array_item().value(msg.timestamp);
+            json_.end_array();
+        }
+        json_.end_array();
+        json_.end_object();
+        pending_head_ = 0;
+        pending_count_ = 0;
+        if (!json_.overflowed()) [[likely]] server_.broadcast(json_.view());
+    }
+};
+
+// Drains an engine output ring on its own thread and fans each batch out
+// to every registered sink, so the matching thread only pays for the ring
+// push. The ring is SPSC: one publisher per OutputBuffer.
+class OutputPublisher {
+public:
+    static constexpr size_t PUBLISH_BATCH = 256;
+
+private:
+    OutputBuffer& source_;
+    std::vector<OutputSink*> sinks_;
+    std::vector<std::function<uint64_t()>> producers_;
+    int core_;
+    unsigned idle_sleep_us_;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::atomic<uint64_t> messages_published_{0};
+    std::atomic<uint64_t> batches_published_{0};
+    std::atomic<uint64_t> max_lag_{0};
+
+public:
+    // idle_sleep_us = 0 busy-polls the ring; otherwise the thread sleeps
+    // that long whenever it finds the ring empty.
+    explicit OutputPublisher(OutputBuffer& source, int core = -1, unsigned idle_sleep_us = 0)
+        : source_(source), core_(core), idle_sleep_us_(idle_sleep_us) {}
+
+    template<typename Policy>
+    explicit OutputPublisher(BasicOrderBook<Policy>& book, int core = -1, unsigned idle_sleep_us = 0)
+        : OutputPublisher(book.get_output_buffer(), core, idle_sleep_us) {
+        add_producer(book);
+    }
+
+    ~OutputPublisher() { stop(); }
+
+    OutputPublisher(const OutputPublisher&) = delete;
+    OutputPublisher& operator=(const OutputPublisher&) = delete;
+
+    // Sinks and producers are registered before start().
+    void add_sink(OutputSink& sink) { sinks_.push_back(&sink); }
+    // Books writing into the ring; their drop counters are summed into
+    // messages_dropped().
+    template<typename Policy>
+    void add_producer(const BasicOrderBook<Policy>& book) {
+        producers_.push_back([&book] { return book.messages_dropped(); });
+    }
+
+    void start() {
+        if (running_.exchange(true)) return;
+        thread_ = std::thread(&OutputPublisher::run, this);
+    }
+
+    // Stops after draining whatever is already in the ring.
+    void stop() {
+        if (!running_.exchange(false)) return;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    uint64_t messages_published() const { return messages_published_.load(std::memory_order_relaxed); }
+    uint64_t batches_published() const { return batches_published_.load(std::memory_order_relaxed); }
+    // Messages pushed by the engine but not yet handed to the sinks.
+    uint64_t lag() const { return source_.size_approx(); }
+    uint64_t max_lag() const { return max_lag_.load(std::memory_order_relaxed); }
+    uint64_t messages_dropped() const {
+        uint64_t dropped = 0;
+        for (const auto& producer : producers_) dropped += producer();
+        return dropped;
+    }
+
+private:
+    size_t drain_once(OutputMsg* batch) {
+        uint64_t lag = source_.size_approx();
+        if (lag > max_lag_.load(std::memory_order_relaxed)) {
+            max_lag_.store(lag, std::memory_order_relaxed);
+        }
+        size_t n = source_.pop_batch(batch, PUBLISH_BATCH);
+        if (n == 0) return 0;
+        for (OutputSink* sink : sinks_) sink->on_messages(batch, n);
+        messages_published_.fetch_add(n, std::memory_order_relaxed);
+        batches_published_.fetch_add(1, std::memory_order_relaxed);
+        return n;
+    }
+
+    void run() {
+        if (core_ >= 0 && !pin_thread_to_core(core_)) {
+            std::cerr << "[Publisher] Failed to pin to core " << core_ << std::endl;
+        }
+        OutputMsg batch[PUBLISH_BATCH];
+        while (running_.load(std::memory_order_relaxed)) {
+            if (drain_once(batch) > 0) continue;
+            for (OutputSink* sink : sinks_) sink->on_idle();
+            if (idle_sleep_us_ > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(idle_sleep_us_));
+            } else {
+                cpu_relax();
+            }
+        }
+        while (drain_once(batch) > 0) {}
+        for (OutputSink* sink : sinks_) sink->on_idle();
+    }
+};
+
+#endif
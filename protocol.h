@@ -1,6 +1,7 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <array>
 #include <cstdint>
 #include <cstring>
 
@@ -18,6 +19,7 @@ enum class MsgType : uint8_t {
     HEARTBEAT       = 'H',
     RESET           = 'R',
     SNAPSHOT_REQ    = 'Q',
+    MASS_CANCEL     = 'K',
 };
 
 enum class Side : uint8_t {
@@ -36,8 +38,9 @@ struct MsgHeader {
     MsgType type;
     uint16_t length;
     uint64_t timestamp;
+    uint16_t symbol_id;
 };
-static_assert(sizeof(MsgHeader) == 11, "MsgHeader must be 11 bytes");
+static_assert(sizeof(MsgHeader) == 13, "MsgHeader must be 13 bytes");
 
 struct MsgAddOrder {
     MsgHeader header;
@@ -61,7 +64,7 @@ struct MsgAddOrder {
         return msg;
     }
 };
-static_assert(sizeof(MsgAddOrder) == 44, "MsgAddOrder must be 44 bytes");
+static_assert(sizeof(MsgAddOrder) == 46, "MsgAddOrder must be 46 bytes");
 
 struct MsgAddIceberg {
     MsgHeader header;
@@ -87,7 +90,7 @@ struct MsgAddIceberg {
         return msg;
     }
 };
-static_assert(sizeof(MsgAddIceberg) == 52, "MsgAddIceberg must be 52 bytes");
+static_assert(sizeof(MsgAddIceberg) == 54, "MsgAddIceberg must be 54 bytes");
 
 struct MsgAddAON {
     MsgHeader header;
@@ -111,7 +114,7 @@ struct MsgAddAON {
         return msg;
     }
 };
-static_assert(sizeof(MsgAddAON) == 44, "MsgAddAON must be 44 bytes");
+static_assert(sizeof(MsgAddAON) == 46, "MsgAddAON must be 46 bytes");
 
 struct MsgCancel {
     MsgHeader header;
@@ -126,7 +129,7 @@ struct MsgCancel {
         return msg;
     }
 };
-static_assert(sizeof(MsgCancel) == 19, "MsgCancel must be 19 bytes");
+static_assert(sizeof(MsgCancel) == 21, "MsgCancel must be 21 bytes");
 
 struct MsgModify {
     MsgHeader header;
@@ -145,7 +148,7 @@ struct MsgModify {
         return msg;
     }
 };
-static_assert(sizeof(MsgModify) == 35, "MsgModify must be 35 bytes");
+static_assert(sizeof(MsgModify) == 37, "MsgModify must be 37 bytes");
 
 struct MsgExecute {
     MsgHeader header;
@@ -179,7 +182,7 @@ struct MsgExecute {
         return create(ts, oid, uid, Side::SELL, 0, q, TIF::IOC);
     }
 };
-static_assert(sizeof(MsgExecute) == 45, "MsgExecute must be 45 bytes");
+static_assert(sizeof(MsgExecute) == 47, "MsgExecute must be 47 bytes");
 
 struct MsgAddStop {
     MsgHeader header;
@@ -207,7 +210,34 @@ struct MsgAddStop {
         return msg;
     }
 };
-static_assert(sizeof(MsgAddStop) == 53, "MsgAddStop must be 53 bytes");
+static_assert(sizeof(MsgAddStop) == 55, "MsgAddStop must be 55 bytes");
+
+// Cancels a user's resting orders and pending stops in one message. side is
+// Side::BUY, Side::SELL or MASS_CANCEL_BOTH_SIDES; the price range is
+// inclusive and selects a pending stop by its trigger price.
+constexpr uint8_t MASS_CANCEL_BOTH_SIDES = 0;
+
+struct MsgMassCancel {
+    MsgHeader header;
+    uint64_t user_id;
+    uint8_t side;
+    int64_t min_price;
+    int64_t max_price;
+    
+    static MsgMassCancel create(uint64_t ts, uint64_t uid, uint8_t side = MASS_CANCEL_BOTH_SIDES,
+                                int64_t min_p = 0, int64_t max_p = INT64_MAX) {
+        MsgMassCancel msg{};
+        msg.header.type = MsgType::MASS_CANCEL;
+        msg.header.length = sizeof(MsgMassCancel);
+        msg.header.timestamp = ts;
+        msg.user_id = uid;
+        msg.side = side;
+        msg.min_price = min_p;
+        msg.max_price = max_p;
+        return msg;
+    }
+};
+static_assert(sizeof(MsgMassCancel) == 38, "MsgMassCancel must be 38 bytes");
 
 struct MsgHeartbeat {
     MsgHeader header;
@@ -220,7 +250,7 @@ struct MsgHeartbeat {
         return msg;
     }
 };
-static_assert(sizeof(MsgHeartbeat) == 11, "MsgHeartbeat must be 11 bytes");
+static_assert(sizeof(MsgHeartbeat) == 13, "MsgHeartbeat must be 13 bytes");
 
 struct MsgReset {
     MsgHeader header;
@@ -233,7 +263,42 @@ struct MsgReset {
         return msg;
     }
 };
-static_assert(sizeof(MsgReset) == 11, "MsgReset must be 11 bytes");
+static_assert(sizeof(MsgReset) == 13, "MsgReset must be 13 bytes");
+
+// Fixed wire size of each input message type, 0 for types this build does
+// not know. A table rather than a switch: framing runs ahead of dispatch
+// over a random type mix, and a second mispredicted branch per message
+// costs more than the lookup.
+inline size_t message_size(MsgType type) {
+    static constexpr auto sizes = [] {
+        std::array<uint8_t, 256> t{};
+        t[static_cast<uint8_t>(MsgType::ADD_ORDER)]       = sizeof(MsgAddOrder);
+        t[static_cast<uint8_t>(MsgType::ADD_ICEBERG)]     = sizeof(MsgAddIceberg);
+        t[static_cast<uint8_t>(MsgType::ADD_AON)]         = sizeof(MsgAddAON);
+        t[static_cast<uint8_t>(MsgType::CANCEL_ORDER)]    = sizeof(MsgCancel);
+        t[static_cast<uint8_t>(MsgType::MODIFY_ORDER)]    = sizeof(MsgModify);
+        t[static_cast<uint8_t>(MsgType::EXECUTE)]         = sizeof(MsgExecute);
+        t[static_cast<uint8_t>(MsgType::ADD_STOP)]        = sizeof(MsgAddStop);
+        t[static_cast<uint8_t>(MsgType::ADD_STOP_MARKET)] = sizeof(MsgAddStop);
+        t[static_cast<uint8_t>(MsgType::HEARTBEAT)]       = sizeof(MsgHeartbeat);
+        t[static_cast<uint8_t>(MsgType::RESET)]           = sizeof(MsgReset);
+        t[static_cast<uint8_t>(MsgType::SNAPSHOT_REQ)]    = sizeof(MsgHeader);
+        t[static_cast<uint8_t>(MsgType::MASS_CANCEL)]     = sizeof(MsgMassCancel);
+        return t;
+    }();
+    return sizes[static_cast<uint8_t>(type)];
+}
+
+constexpr size_t MAX_INPUT_MSG_SIZE = 62;
+static_assert(sizeof(MsgAddStop) <= MAX_INPUT_MSG_SIZE, "Largest message must fit an InputSlot");
+
+struct InputSlot {
+    uint16_t length;
+    uint8_t data[MAX_INPUT_MSG_SIZE];
+    
+    const MsgHeader* header() const { return reinterpret_cast<const MsgHeader*>(data); }
+};
+static_assert(sizeof(InputSlot) == 64, "InputSlot must be 64 bytes");
 
 #pragma pack(pop)
 
@@ -279,6 +344,78 @@ struct OutOrderCancelled {
 };
 static_assert(sizeof(OutOrderCancelled) == 27, "OutOrderCancelled must be 27 bytes");
 
+struct OutBookUpdate {
+    OutMsgHeader header;
+    Side side;
+    int64_t price;
+    int64_t visible_volume;
+    uint32_t order_count;
+};
+static_assert(sizeof(OutBookUpdate) == 32, "OutBookUpdate must be 32 bytes");
+
+// Market-data feed packet: a FeedPacketHeader followed by message_count
+// packed Out* messages, each framed by its own OutMsgHeader. Messages are
+// numbered consecutively from `sequence`. The same packets are sent as
+// multicast datagrams and, length-delimited by `length`, over the TCP
+// recovery channel.
+enum class FeedPacketKind : uint8_t {
+    LIVE         = 'L',
+    RETRANSMIT   = 'R',
+    SNAPSHOT     = 'S',  // OutBookUpdate per level as of `sequence`
+    SNAPSHOT_END = 'E',  // last packet of a snapshot, no messages
+    HEARTBEAT    = 'H',  // no messages; `sequence` is the next to be sent
+    UNAVAILABLE  = 'X',  // retransmit range no longer held; `sequence` is the oldest held
+};
+
+struct FeedPacketHeader {
+    uint16_t length;
+    FeedPacketKind kind;
+    uint16_t message_count;
+    uint64_t sequence;
+};
+static_assert(sizeof(FeedPacketHeader) == 13, "FeedPacketHeader must be 13 bytes");
+
+// Sent by a client on the recovery channel. kind is RETRANSMIT (resend
+// `count` messages from first_sequence) or SNAPSHOT (fields ignored).
+struct FeedRequest {
+    FeedPacketKind kind;
+    uint64_t first_sequence;
+    uint32_t count;
+};
+static_assert(sizeof(FeedRequest) == 13, "FeedRequest must be 13 bytes");
+
+// Binary dashboard book frame (-DWS_BINARY_BOOK), little-endian: a header,
+// then bid_count bid levels and ask_count ask levels, best first. A SNAPSHOT
+// carries the whole displayed depth; a DELTA carries only the levels that
+// changed since frame sequence - 1, volume 0 meaning the level is gone.
+enum class DashFrameKind : uint8_t {
+    SNAPSHOT = 'S',
+    DELTA = 'D'
+};
+
+struct DashBookHeader {
+    DashFrameKind kind;
+    uint8_t reserved;
+    uint16_t bid_count;
+    uint16_t ask_count;
+    uint16_t reserved2;
+    uint64_t sequence;
+    int64_t timestamp_ms;
+    int64_t best_bid;
+    int64_t best_ask;
+    uint64_t order_count;
+    uint64_t bid_levels;
+    uint64_t ask_levels;
+    uint64_t trades_executed;
+};
+static_assert(sizeof(DashBookHeader) == 72, "DashBookHeader must be 72 bytes");
+
+struct DashLevel {
+    int64_t price;
+    int64_t volume;
+};
+static_assert(sizeof(DashLevel) == 16, "DashLevel must be 16 bytes");
+
 #pragma pack(pop)
 
 template<typename T>
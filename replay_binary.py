@@ -35,21 +35,21 @@ def replay_binary_file(filename, host='localhost', port=9000, speed_multiplier=1
             
             while True:
                 
-                header_data = f.read(11)
-                if len(header_data) < 11:
+                header_data = f.read(13)
+                if len(header_data) < 13:
                     break  
                 
                 
-                msg_type, msg_length, timestamp = struct.unpack('<BHQ', header_data)
+                msg_type, msg_length, timestamp, symbol_id = struct.unpack('<BHQH', header_data)
                 
                 
-                if msg_length < 11 or msg_length > 1024:
+                if msg_length < 13 or msg_length > 1024:
                     print(f"\nERROR: Invalid message length {msg_length} at message {message_count}")
                     print(f"Message type: {msg_type}, timestamp: {timestamp}")
                     break
                 
                 
-                remaining = msg_length - 11
+                remaining = msg_length - 13
                 if remaining > 0:
                     body_data = f.read(remaining)
                     
@@ -0,0 +1,93 @@
+#ifndef REPLAY_READER_H
+#define REPLAY_READER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "protocol.h"
+
+// Read-only view of a binary capture (.dat): the file is mapped once and
+// messages are handed out as MsgHeader pointers into the mapping, so a
+// multi-GB replay costs no copies and no per-message allocations.
+//
+// With build_index the constructor makes one validating pass and records
+// each message offset; message(i) is then O(1) and callers can split
+// warm-up and measured ranges by index. A truncated or corrupt tail ends
+// the capture at the last complete message.
+class ReplayReader {
+    const uint8_t* data_ = nullptr;
+    size_t mapped_size_ = 0;
+    size_t valid_size_ = 0;
+    std::vector<uint64_t> offsets_;
+
+public:
+    explicit ReplayReader(const char* path, bool build_index = true) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[Replay] Cannot open " << path << std::endl;
+            return;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            mapped_size_ = static_cast<size_t>(st.st_size);
+            void* map = ::mmap(nullptr, mapped_size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (map != MAP_FAILED) {
+                ::madvise(map, mapped_size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const uint8_t*>(map);
+            } else {
+                std::cerr << "[Replay] mmap failed for " << path << std::endl;
+                mapped_size_ = 0;
+            }
+        }
+        ::close(fd);
+        if (data_ == nullptr) return;
+
+        if (build_index) offsets_.reserve(mapped_size_ / sizeof(MsgAddOrder));
+        size_t offset = 0;
+        while (const MsgHeader* header = next(offset)) {
+            if (build_index) offsets_.push_back(offset);
+            offset += header->length;
+        }
+        valid_size_ = offset;
+        if (valid_size_ != mapped_size_) {
+            std::cerr << "[Replay] Ignoring " << (mapped_size_ - valid_size_)
+                      << " trailing bytes at offset " << valid_size_ << std::endl;
+        }
+    }
+
+    ~ReplayReader() {
+        if (data_ != nullptr) ::munmap(const_cast<uint8_t*>(data_), mapped_size_);
+    }
+
+    ReplayReader(const ReplayReader&) = delete;
+    ReplayReader& operator=(const ReplayReader&) = delete;
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return valid_size_; }
+
+    // Message starting at `offset`, or nullptr at the end of the capture or
+    // at a malformed message. Works with or without the index.
+    const MsgHeader* next(size_t offset) const {
+        size_t limit = valid_size_ ? valid_size_ : mapped_size_;
+        if (offset + sizeof(MsgHeader) > limit) return nullptr;
+        const MsgHeader* header = reinterpret_cast<const MsgHeader*>(data_ + offset);
+        if (header->length < sizeof(MsgHeader) || header->length > limit - offset ||
+            header->length < message_size(header->type)) return nullptr;
+        return header;
+    }
+
+    // Index access; only valid when constructed with build_index.
+    size_t message_count() const { return offsets_.size(); }
+    const MsgHeader* message(size_t i) const {
+        return reinterpret_cast<const MsgHeader*>(data_ + offsets_[i]);
+    }
+};
+
+#endif
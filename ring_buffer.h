@@ -6,6 +6,7 @@
 #include <cstring>
 #include <new>
 #include <type_traits>
+#include <algorithm>
 
 #ifndef CACHE_LINE_SIZE
 inline constexpr size_t CACHE_LINE_SIZE = 64;
@@ -183,4 +184,176 @@ public:
     }
 };
 
+// One producer, up to MaxConsumers independent readers that each see every
+// element. Each consumer owns a cursor on its own cache line; the producer
+// is held back only by the slowest active one and rescans the cursors only
+// when its cached minimum says the ring is full. Readers get spans that
+// point straight into the ring (peek/consume), so adding a consumer adds
+// no copies.
+//
+// add_consumer/remove_consumer may run while the producer is live but not
+// concurrently with each other. A new consumer starts at the current head.
+template<typename T, size_t Size, size_t MaxConsumers = 8>
+class BroadcastRing {
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of 2");
+    static_assert(Size > 0, "Size must be positive");
+    static_assert(MaxConsumers > 0, "Need at least one consumer slot");
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    static constexpr size_type capacity_value = Size;
+    static constexpr size_type mask = Size - 1;
+    static constexpr size_t max_consumers = MaxConsumers;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Cursor {
+        std::atomic<size_type> pos{0};
+        std::atomic<bool> active{false};
+    };
+
+    alignas(CACHE_LINE_SIZE) T buffer_[Size];
+    alignas(CACHE_LINE_SIZE) std::atomic<size_type> head_{0};
+    size_type cached_min_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> consumer_slots_{0};
+    Cursor cursors_[MaxConsumers];
+
+    size_type min_cursor(size_type head) const noexcept {
+        size_type min = head;
+        const size_t slots = consumer_slots_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < slots; ++i) {
+            if (cursors_[i].active.load(std::memory_order_acquire)) {
+                size_type pos = cursors_[i].pos.load(std::memory_order_acquire);
+                if (pos < min) min = pos;
+            }
+        }
+        return min;
+    }
+
+    size_type free_space(size_type head, size_t wanted) noexcept {
+        if (head - cached_min_ + wanted > capacity_value) {
+            cached_min_ = min_cursor(head);
+        }
+        return capacity_value - (head - cached_min_);
+    }
+
+public:
+    BroadcastRing() = default;
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+    BroadcastRing(BroadcastRing&&) = delete;
+    BroadcastRing& operator=(BroadcastRing&&) = delete;
+
+    // Returns the consumer id, or -1 when every slot is taken.
+    int add_consumer() noexcept {
+        size_t slots = consumer_slots_.load(std::memory_order_relaxed);
+        size_t id = 0;
+        while (id < slots && cursors_[id].active.load(std::memory_order_relaxed)) ++id;
+        if (id == MaxConsumers) return -1;
+
+        Cursor& cursor = cursors_[id];
+        cursor.pos.store(head_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        cursor.active.store(true, std::memory_order_seq_cst);
+        if (id == slots) consumer_slots_.store(slots + 1, std::memory_order_release);
+        // The producer may have advanced before it saw this cursor; start
+        // from wherever head is now so nothing unread can be overwritten.
+        cursor.pos.store(head_.load(std::memory_order_seq_cst), std::memory_order_release);
+        return static_cast<int>(id);
+    }
+
+    void remove_consumer(int id) noexcept {
+        cursors_[id].active.store(false, std::memory_order_release);
+    }
+
+    // Batched claim/publish: claim() returns a contiguous writable span of
+    // up to max_count slots (n is set to its length, 0 when full); publish()
+    // makes the first n of them visible to every consumer.
+    T* claim(size_t max_count, size_t& n) noexcept {
+        const size_type head = head_.load(std::memory_order_relaxed);
+        const size_type space = free_space(head, max_count);
+        const size_t contiguous = capacity_value - (head & mask);
+        n = std::min({max_count, static_cast<size_t>(space), contiguous});
+        return &buffer_[head & mask];
+    }
+
+    void publish(size_t n) noexcept {
+        head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    size_t push_batch(const T* batch_data, size_t count) noexcept {
+        size_t written = 0;
+        while (written < count) {
+            size_t n = 0;
+            T* dst = claim(count - written, n);
+            if (n == 0) break;
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                std::memcpy(dst, batch_data + written, n * sizeof(T));
+            } else {
+                for (size_t i = 0; i < n; ++i) dst[i] = batch_data[written + i];
+            }
+            publish(n);
+            written += n;
+        }
+        return written;
+    }
+
+    [[nodiscard]] bool try_push(const T& item) noexcept {
+        size_t n = 0;
+        T* dst = claim(1, n);
+        if (n == 0) return false;
+        *dst = item;
+        publish(1);
+        return true;
+    }
+
+    // Contiguous readable span for one consumer, valid until consume().
+    const T* peek(int id, size_t& n) const noexcept {
+        const size_type pos = cursors_[id].pos.load(std::memory_order_relaxed);
+        const size_type head = head_.load(std::memory_order_acquire);
+        const size_t contiguous = capacity_value - (pos & mask);
+        n = std::min(static_cast<size_t>(head - pos), contiguous);
+        return &buffer_[pos & mask];
+    }
+
+    void consume(int id, size_t n) noexcept {
+        Cursor& cursor = cursors_[id];
+        cursor.pos.store(cursor.pos.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    size_t pop_batch(int id, T* out, size_t max_count) noexcept {
+        size_t read = 0;
+        while (read < max_count) {
+            size_t n = 0;
+            const T* src = peek(id, n);
+            n = std::min(n, max_count - read);
+            if (n == 0) break;
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                std::memcpy(out + read, src, n * sizeof(T));
+            } else {
+                for (size_t i = 0; i < n; ++i) out[read + i] = src[i];
+            }
+            consume(id, n);
+            read += n;
+        }
+        return read;
+    }
+
+    // Elements published but not yet consumed by this consumer.
+    [[nodiscard]] size_type lag(int id) const noexcept {
+        return head_.load(std::memory_order_acquire) -
+               cursors_[id].pos.load(std::memory_order_relaxed);
+    }
+
+    // Lag of the slowest consumer, i.e. how full the ring is.
+    [[nodiscard]] size_type size_approx() const noexcept {
+        const size_type head = head_.load(std::memory_order_acquire);
+        return head - min_cursor(head);
+    }
+
+    [[nodiscard]] static constexpr size_type capacity() noexcept {
+        return Size;
+    }
+};
+
 #endif
@@ -0,0 +1,226 @@
+#ifndef SHARDED_ENGINE_H
+#define SHARDED_ENGINE_H
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "protocol.h"
+#include "ring_buffer.h"
+#include "order_book.h"
+#include "thread_utils.h"
+
+constexpr size_t SHARD_QUEUE_SIZE = 1 << 16;
+constexpr size_t SHARD_POP_BATCH = 64;
+constexpr size_t MAX_SYMBOLS = 1 << 16;
+
+using ShardQueue = RingBuffer<InputSlot, SHARD_QUEUE_SIZE>;
+
+// Each book is owned by exactly one shard worker, so it is built without
+// the book lock.
+using ShardBook = BasicOrderBook<SingleThreadBookPolicy>;
+
+// Owns one book per symbol and spreads symbols over N shards. Each shard is
+// a single matching thread pinned to its own core, fed by an SPSC queue of
+// raw input messages; its books never take the book lock and all publish
+// into the shard's output ring (OutputMsg::symbol_id tells them apart).
+//
+// submit() must be called from a single producer thread. Symbols must be
+// registered with add_symbol() before start().
+class ShardedEngine {
+private:
+    struct Shard {
+        ShardQueue input;
+        OutputBuffer output;
+        std::vector<ShardBook*> books;
+        std::thread worker;
+        int core = -1;
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> messages_processed{0};
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::unique_ptr<ShardBook>> books_;
+    std::atomic<bool> running_{false};
+
+    uint64_t messages_routed_ = 0;
+    uint64_t messages_rejected_ = 0;
+    uint64_t queue_full_spins_ = 0;
+
+    void worker_loop(Shard& shard) {
+        if (shard.core >= 0 && !pin_thread_to_core(shard.core)) {
+            std::cerr << "[Engine] Failed to pin shard worker to core " << shard.core << "\n";
+        }
+
+        InputSlot batch[SHARD_POP_BATCH];
+        ShardBook* touched[SHARD_POP_BATCH];
+        // Batch epoch each symbol was last queued for a flush in, so a book
+        // hit by several messages of one batch is flushed (and its top
+        // published) once.
+        std::vector<uint32_t> flush_epoch(MAX_SYMBOLS, 0);
+        uint32_t epoch = 0;
+
+        while (true) {
+            size_t n = shard.input.pop_batch(batch, SHARD_POP_BATCH);
+            if (n == 0) {
+                if (running_.load(std::memory_order_acquire)) {
+                    cpu_relax();
+                    continue;
+                }
+                // A message submitted before stop() can land between the
+                // empty pop and the flag load; it is visible now, so look
+                // once more before exiting.
+                n = shard.input.pop_batch(batch, SHARD_POP_BATCH);
+                if (n == 0) break;
+            }
+
+            if (++epoch == 0) [[unlikely]] {
+                std::fill(flush_epoch.begin(), flush_epoch.end(), 0);
+                epoch = 1;
+            }
+
+            size_t num_touched = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const MsgHeader* header = batch[i].header();
+                ShardBook* book = books_[header->symbol_id].get();
+                book->process_message_no_lock(header);
+                if (flush_epoch[header->symbol_id] != epoch) {
+                    flush_epoch[header->symbol_id] = epoch;
+                    touched[num_touched++] = book;
+                }
+            }
+            for (size_t i = 0; i < num_touched; ++i) {
+                touched[i]->flush_output_buffer();
+            }
+            shard.messages_processed.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    explicit ShardedEngine(size_t num_shards, int first_core = 0)
+        : books_(MAX_SYMBOLS)
+    {
+        if (num_shards == 0) num_shards = 1;
+        unsigned hw = std::thread::hardware_concurrency();
+
+        shards_.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i) {
+            auto shard = std::make_unique<Shard>();
+            if (first_core >= 0) {
+                shard->core = hw ? static_cast<int>((first_core + i) % hw)
+                                 : static_cast<int>(first_core + i);
+            }
+            shards_.push_back(std::move(shard));
+        }
+    }
+
+    ~ShardedEngine() { stop(); }
+
+    ShardedEngine(const ShardedEngine&) = delete;
+    ShardedEngine& operator=(const ShardedEngine&) = delete;
+
+    inline size_t shard_of(uint16_t symbol_id) const {
+        uint32_t h = static_cast<uint32_t>(symbol_id) * 0x9E3779B1u;
+        return static_cast<size_t>((static_cast<uint64_t>(h) * shards_.size()) >> 32);
+    }
+
+    // Books default to the hashed order index: order ids are usually global
+    // across instruments, which would make every direct index span them all.
+    ShardBook* add_symbol(uint16_t symbol_id, size_t order_capacity = 65536,
+                          int64_t price_anchor = PRICE_OFFSET,
+                          OrderIndexMode index_mode = OrderIndexMode::HASHED) {
+        if (running_.load(std::memory_order_relaxed)) {
+            std::cerr << "[Engine] add_symbol(" << symbol_id << ") after start ignored\n";
+            return nullptr;
+        }
+        if (books_[symbol_id]) return books_[symbol_id].get();
+
+        Shard& shard = *shards_[shard_of(symbol_id)];
+        ArenaConfig arena;
+        arena.numa_node = numa_node_of_core(shard.core);
+        books_[symbol_id] = std::make_unique<ShardBook>(
+            order_capacity, price_anchor, &shard.output, index_mode, arena);
+        books_[symbol_id]->set_symbol_id(symbol_id);
+        shard.books.push_back(books_[symbol_id].get());
+        return books_[symbol_id].get();
+    }
+
+    void start() {
+        if (running_.exchange(true)) return;
+        for (auto& shard : shards_) {
+            Shard* s = shard.get();
+            s->worker = std::thread([this, s]() { worker_loop(*s); });
+        }
+        std::cout << "[Engine] Started " << shards_.size() << " shard(s)\n";
+    }
+
+    // Drains every shard queue before the workers exit.
+    void stop() {
+        if (!running_.exchange(false)) return;
+        for (auto& shard : shards_) {
+            if (shard->worker.joinable()) {
+                shard->worker.join();
+            }
+        }
+    }
+
+    // Copies one wire message into its shard's queue. Spins while the queue
+    // is full so no message is ever dropped. Returns false for unknown
+    // symbols and malformed lengths.
+    bool submit(const uint8_t* data, size_t len) {
+        if (len < sizeof(MsgHeader) || len > MAX_INPUT_MSG_SIZE) [[unlikely]] {
+            ++messages_rejected_;
+            return false;
+        }
+        const auto* header = reinterpret_cast<const MsgHeader*>(data);
+        if (len < message_size(header->type) || !books_[header->symbol_id]) [[unlikely]] {
+            ++messages_rejected_;
+            return false;
+        }
+
+        InputSlot slot;
+        slot.length = static_cast<uint16_t>(len);
+        std::memcpy(slot.data, data, len);
+
+        ShardQueue& queue = shards_[shard_of(header->symbol_id)]->input;
+        while (!queue.try_push(slot)) {
+            ++queue_full_spins_;
+            cpu_relax();
+        }
+        ++messages_routed_;
+        return true;
+    }
+
+    // The book has no lock: while the workers run, only top_of_book() and
+    // other read-only calls on seqlocked or atomic state are safe on it.
+    // Anything that mutates the book or walks its levels races the shard
+    // worker; do that before start() or after stop().
+    inline ShardBook* book(uint16_t symbol_id) { return books_[symbol_id].get(); }
+    inline const ShardBook* book(uint16_t symbol_id) const { return books_[symbol_id].get(); }
+
+    inline size_t num_shards() const { return shards_.size(); }
+    inline OutputBuffer& shard_output(size_t shard) { return shards_[shard]->output; }
+    inline size_t shard_symbols(size_t shard) const { return shards_[shard]->books.size(); }
+    inline int shard_core(size_t shard) const { return shards_[shard]->core; }
+
+    inline uint64_t shard_messages_processed(size_t shard) const {
+        return shards_[shard]->messages_processed.load(std::memory_order_relaxed);
+    }
+    inline uint64_t messages_processed() const {
+        uint64_t total = 0;
+        for (const auto& shard : shards_) {
+            total += shard->messages_processed.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    inline uint64_t messages_routed() const { return messages_routed_; }
+    inline uint64_t messages_rejected() const { return messages_rejected_; }
+    inline uint64_t queue_full_spins() const { return queue_full_spins_; }
+};
+
+#endif
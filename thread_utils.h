@@ -0,0 +1,30 @@
+#ifndef THREAD_UTILS_H
+#define THREAD_UTILS_H
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__ ("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+// Pins the calling thread to one core. No-op (returns false) off Linux.
+inline bool pin_thread_to_core(int core) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+#endif
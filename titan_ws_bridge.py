@@ -69,12 +69,12 @@ SIDE_BUY = ord('B')
 SIDE_SELL = ord('S')
 
 
-HEADER_FMT = '<BHQ'  
-HEADER_SIZE = 11
+HEADER_FMT = '<BHQH'  
+HEADER_SIZE = 13
 
-ADD_ORDER_FMT = '<BHQ QQ B qq'  
-CANCEL_FMT = '<BHQ Q'  
-MODIFY_FMT = '<BHQ Q qq'  
+ADD_ORDER_FMT = '<BHQH QQ B qq'  
+CANCEL_FMT = '<BHQH Q'  
+MODIFY_FMT = '<BHQH Q qq'  
 
 
 OUT_TRADE_FMT = '<BQQQqq'  
@@ -217,11 +217,11 @@ def parse_message(data: bytes) -> Optional[dict]:
     if len(data) < HEADER_SIZE:
         return None
     
-    msg_type, msg_length, timestamp = struct.unpack(HEADER_FMT, data[:HEADER_SIZE])
+    msg_type, msg_length, timestamp, symbol_id = struct.unpack(HEADER_FMT, data[:HEADER_SIZE])
     
     if msg_type == MSG_ADD_ORDER:
-        if len(data) >= 44:
-            _, _, _, order_id, user_id, side, price, quantity = struct.unpack(ADD_ORDER_FMT, data[:44])
+        if len(data) >= 46:
+            _, _, _, _, order_id, user_id, side, price, quantity = struct.unpack(ADD_ORDER_FMT, data[:46])
             return {
                 'type': 'add',
                 'order_id': order_id,
@@ -232,8 +232,8 @@ def parse_message(data: bytes) -> Optional[dict]:
             }
     
     elif msg_type == MSG_CANCEL_ORDER:
-        if len(data) >= 19:
-            _, _, _, order_id = struct.unpack(CANCEL_FMT, data[:19])
+        if len(data) >= 21:
+            _, _, _, _, order_id = struct.unpack(CANCEL_FMT, data[:21])
             return {
                 'type': 'cancel',
                 'order_id': order_id,
@@ -241,8 +241,8 @@ def parse_message(data: bytes) -> Optional[dict]:
             }
     
     elif msg_type == MSG_MODIFY_ORDER:
-        if len(data) >= 35:
-            _, _, _, order_id, new_price, new_qty = struct.unpack(MODIFY_FMT, data[:35])
+        if len(data) >= 37:
+            _, _, _, _, order_id, new_price, new_qty = struct.unpack(MODIFY_FMT, data[:37])
             return {
                 'type': 'modify',
                 'order_id': order_id,
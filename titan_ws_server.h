@@ -2,18 +2,21 @@
 #define TITAN_WS_SERVER_H
 
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <string>
 #include <vector>
-#include <unordered_set>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <mutex>
 #include <thread>
 #include <atomic>
 #include <chrono>
 #include <functional>
 #include <algorithm>
-#include <sstream>
-#include <iomanip>
+#include <charconv>
+#include <string_view>
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -23,9 +26,11 @@
     #define INVALID_SOCKET_VAL INVALID_SOCKET
     #define CLOSE_SOCKET closesocket
     #define SOCKET_ERROR_VAL SOCKET_ERROR
+    #define MSG_NOSIGNAL 0
 #else
     #include <sys/socket.h>
     #include <sys/select.h>
+    #include <sys/uio.h>
     #include <netinet/in.h>
     #include <netinet/tcp.h>
     #include <arpa/inet.h>
@@ -36,6 +41,14 @@
     #define INVALID_SOCKET_VAL -1
     #define CLOSE_SOCKET close
     #define SOCKET_ERROR_VAL -1
+    #ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+    #endif
+#endif
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
 #endif
 
 namespace sha1 {
@@ -135,23 +148,84 @@ namespace base64 {
     }
 }
 
+// Frames a client may have queued before its oldest are dropped.
+#ifndef WS_CLIENT_QUEUE_FRAMES
+#define WS_CLIENT_QUEUE_FRAMES 256
+#endif
+
+// Single event-loop WebSocket server. One thread (epoll on Linux, select
+// elsewhere) owns every socket. broadcast() encodes the frame once into a
+// shared buffer and hands it to the loop under a short lock, so its cost does
+// not grow with the number of clients; the loop fans the buffer out into a
+// bounded queue per client and writes each queue without blocking. A client
+// that cannot keep up loses its oldest frames, and a queued frame is replaced
+// in place by a newer one carrying the same conflation key.
 class TitanWebSocketServer {
 public:
     using MessageCallback = std::function<void(socket_t, const std::string&)>;
-    
+    using Frame = std::shared_ptr<const std::string>;
+
+    static constexpr uint8_t NO_CONFLATION = 0;
+
 private:
+    static constexpr size_t CLIENT_QUEUE_FRAMES = WS_CLIENT_QUEUE_FRAMES;
+    static constexpr size_t MAX_PENDING_FRAMES = 4096;
+    static constexpr size_t MAX_HANDSHAKE_BYTES = 8192;
+    static constexpr size_t MAX_MESSAGE_BYTES = 1024 * 1024;
+    static constexpr size_t MAX_WRITE_FRAMES = 64;
+    static constexpr size_t RECV_CHUNK = 16 * 1024;
+    static constexpr size_t MAX_EVENTS = 64;
+#ifdef __linux__
+    static constexpr int POLL_TIMEOUT_MS = 100;
+#else
+    // No cross-thread wakeup without epoll, so the loop polls for broadcasts.
+    static constexpr int POLL_TIMEOUT_MS = 10;
+#endif
+
+    struct Outgoing {
+        Frame frame;
+        socket_t target;
+        uint8_t conflate_key;
+    };
+
+    struct Queued {
+        Frame frame;
+        uint8_t conflate_key;
+    };
+
+    // Owned by the loop thread. The head frame may be partly written
+    // (head_offset > 0); it is never dropped or replaced, or the stream
+    // would be cut mid-frame.
+    struct Client {
+        socket_t fd;
+        bool open = false;
+        bool want_write = false;
+        std::string rx;
+        std::deque<Queued> queue;
+        size_t head_offset = 0;
+        uint64_t dropped = 0;
+    };
+
     uint16_t port_;
-    socket_t listen_socket_ = INVALID_SOCKET_VAL;
     std::atomic<bool> running_{false};
     std::thread server_thread_;
-    
-    std::mutex clients_mutex_;
-    std::unordered_set<socket_t> clients_;
-    
+
+    std::unordered_map<socket_t, std::unique_ptr<Client>> clients_;
+    std::atomic<size_t> client_count_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+
+    std::mutex pending_mutex_;
+    std::deque<Outgoing> pending_;
+
+#ifdef __linux__
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+#endif
+
     MessageCallback on_message_;
-    
+
     static constexpr const char* WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-    
+
     bool set_non_blocking(socket_t sock) {
 #ifdef _WIN32
         u_long mode = 1;
@@ -161,35 +235,46 @@ private:
         return fcntl(sock, F_SETFL, flags | O_NONBLOCK) != -1;
 #endif
     }
-    
+
     void set_tcp_nodelay(socket_t sock) {
         int flag = 1;
         setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
     }
-    
+
+    static bool would_block() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
     std::string extract_header(const std::string& request, const std::string& name) {
         std::string search = name + ": ";
         size_t pos = request.find(search);
         if (pos == std::string::npos) return "";
-        
+
         size_t start = pos + search.length();
         size_t end = request.find("\r\n", start);
         if (end == std::string::npos) end = request.length();
-        
+
         return request.substr(start, end - start);
     }
-    
-    bool perform_handshake(socket_t client) {
-        char buffer[4096];
-        int n = recv(client, buffer, sizeof(buffer) - 1, 0);
-        if (n <= 0) return false;
-        buffer[n] = '\0';
-        
-        std::string request(buffer);
-        
+
+    // Replies go straight to the socket: they are the first bytes on an
+    // empty send buffer, so a short write means the peer is unusable.
+    bool send_all(socket_t sock, const std::string& data) {
+        int n = send(sock, data.data(), static_cast<int>(data.size()), MSG_NOSIGNAL);
+        return n == static_cast<int>(data.size());
+    }
+
+    bool perform_handshake(Client& client, size_t request_end) {
+        std::string request = client.rx.substr(0, request_end);
+        client.rx.erase(0, request_end);
+
         if (request.find("Upgrade: websocket") == std::string::npos &&
             request.find("Upgrade: WebSocket") == std::string::npos) {
-            std::string http_response = 
+            std::string http_response =
                 "HTTP/1.1 200 OK\r\n"
                 "Content-Type: text/html\r\n"
                 "Connection: close\r\n"
@@ -198,326 +283,581 @@ private:
                 "<h1>TitanLOB WebSocket Server</h1>"
                 "<p>Connect via WebSocket at ws://hostname:" + std::to_string(port_) + "</p>"
                 "</body></html>";
-            send(client, http_response.c_str(), http_response.length(), 0);
+            send_all(client.fd, http_response);
             return false;
         }
-        
+
         std::string key = extract_header(request, "Sec-WebSocket-Key");
         if (key.empty()) return false;
-        
+
         std::string combined = key + WS_GUID;
         uint8_t sha1_result[20];
         sha1::compute((const uint8_t*)combined.c_str(), combined.length(), sha1_result);
         std::string accept_key = base64::encode(sha1_result, 20);
-        
-        std::string response = 
+
+        std::string response =
             "HTTP/1.1 101 Switching Protocols\r\n"
             "Upgrade: websocket\r\n"
             "Connection: Upgrade\r\n"
             "Sec-WebSocket-Accept: " + accept_key + "\r\n"
             "\r\n";
-        
-        send(client, response.c_str(), response.length(), 0);
+
+        if (!send_all(client.fd, response)) return false;
+        client.open = true;
+        client_count_.fetch_add(1, std::memory_order_relaxed);
+        printf("[WS] Client connected (fd=%d)\n", (int)client.fd);
         return true;
     }
-    
-    std::vector<uint8_t> encode_frame(const std::string& message, uint8_t opcode = 0x01) {
-        std::vector<uint8_t> frame;
-        
-        frame.push_back(0x80 | opcode);
-        
+
+    static Frame encode_frame(std::string_view message, uint8_t opcode = 0x01) {
+        auto frame = std::make_shared<std::string>();
         size_t len = message.length();
+        frame->reserve(len + 10);
+
+        frame->push_back(static_cast<char>(0x80 | opcode));
         if (len <= 125) {
-            frame.push_back(static_cast<uint8_t>(len));
+            frame->push_back(static_cast<char>(len));
         } else if (len <= 65535) {
-            frame.push_back(126);
-            frame.push_back((len >> 8) & 0xFF);
-            frame.push_back(len & 0xFF);
+            frame->push_back(static_cast<char>(126));
+            frame->push_back(static_cast<char>((len >> 8) & 0xFF));
+            frame->push_back(static_cast<char>(len & 0xFF));
         } else {
-            frame.push_back(127);
+            frame->push_back(static_cast<char>(127));
             for (int i = 7; i >= 0; i--) {
-                frame.push_back((len >> (i * 8)) & 0xFF);
+                frame->push_back(static_cast<char>((len >> (i * 8)) & 0xFF));
             }
         }
-        
-        frame.insert(frame.end(), message.begin(), message.end());
-        
+
+        frame->append(message);
         return frame;
     }
-    
-    bool decode_frame(socket_t client, std::string& message) {
-        uint8_t header[2];
-        int n = recv(client, (char*)header, 2, 0);
-        if (n != 2) return false;
-        
-        bool fin = (header[0] & 0x80) != 0;
-        uint8_t opcode = header[0] & 0x0F;
-        bool masked = (header[1] & 0x80) != 0;
-        uint64_t payload_len = header[1] & 0x7F;
-        
-        if (opcode == 0x08) return false;
-        
-        if (payload_len == 126) {
-            uint8_t ext[2];
-            if (recv(client, (char*)ext, 2, 0) != 2) return false;
-            payload_len = (ext[0] << 8) | ext[1];
-        } else if (payload_len == 127) {
-            uint8_t ext[8];
-            if (recv(client, (char*)ext, 8, 0) != 8) return false;
-            payload_len = 0;
-            for (int i = 0; i < 8; i++) {
-                payload_len = (payload_len << 8) | ext[i];
+
+    // Dispatches every complete frame in rx. False on a close frame or a
+    // frame too large to accept.
+    bool decode_frames(Client& client) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(client.rx.data());
+        size_t size = client.rx.size();
+        size_t pos = 0;
+
+        while (size - pos >= 2) {
+            uint8_t opcode = data[pos] & 0x0F;
+            bool masked = (data[pos + 1] & 0x80) != 0;
+            uint64_t payload_len = data[pos + 1] & 0x7F;
+            size_t header_len = 2;
+
+            if (payload_len == 126) {
+                if (size - pos < 4) break;
+                payload_len = (data[pos + 2] << 8) | data[pos + 3];
+                header_len = 4;
+            } else if (payload_len == 127) {
+                if (size - pos < 10) break;
+                payload_len = 0;
+                for (int i = 0; i < 8; i++) {
+                    payload_len = (payload_len << 8) | data[pos + 2 + i];
+                }
+                header_len = 10;
+            }
+            if (payload_len > MAX_MESSAGE_BYTES) return false;
+
+            size_t mask_pos = pos + header_len;
+            if (masked) header_len += 4;
+            if (size - pos < header_len + payload_len) break;
+
+            if (opcode == 0x08) return false;
+
+            std::string message(reinterpret_cast<const char*>(data + pos + header_len), payload_len);
+            if (masked) {
+                for (size_t i = 0; i < payload_len; i++) {
+                    message[i] ^= data[mask_pos + (i % 4)];
+                }
+            }
+            pos += header_len + payload_len;
+
+            if (opcode == 0x09) {
+                enqueue(client, encode_frame(message, 0x0A), NO_CONFLATION);
+            } else if (on_message_ && !message.empty()) {
+                on_message_(client.fd, message);
             }
         }
-        
-        uint8_t mask[4] = {0};
-        if (masked) {
-            if (recv(client, (char*)mask, 4, 0) != 4) return false;
+
+        client.rx.erase(0, pos);
+        return true;
+    }
+
+    // Drains the socket until it would block; false if the peer went away.
+    bool read_available(Client& client) {
+        char buffer[RECV_CHUNK];
+        while (true) {
+            int n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                client.rx.append(buffer, n);
+                if (!client.open) {
+                    size_t end = client.rx.find("\r\n\r\n");
+                    if (end == std::string::npos) {
+                        if (client.rx.size() > MAX_HANDSHAKE_BYTES) return false;
+                        continue;
+                    }
+                    if (!perform_handshake(client, end + 4)) return false;
+                }
+                if (!decode_frames(client)) return false;
+                continue;
+            }
+            if (n < 0 && would_block()) return client.want_write || flush(client);
+            return false;
         }
-        
-        if (payload_len > 0 && payload_len < 1024 * 1024) {
-            std::vector<char> payload(payload_len);
-            size_t received = 0;
-            while (received < payload_len) {
-                n = recv(client, payload.data() + received, payload_len - received, 0);
-                if (n <= 0) return false;
-                received += n;
+    }
+
+    void enqueue(Client& client, const Frame& frame, uint8_t conflate_key) {
+        size_t first = client.head_offset > 0 ? 1 : 0;
+
+        if (conflate_key != NO_CONFLATION) {
+            for (size_t i = first; i < client.queue.size(); ++i) {
+                if (client.queue[i].conflate_key == conflate_key) {
+                    client.queue[i].frame = frame;
+                    return;
+                }
             }
-            
-            if (masked) {
-                for (size_t i = 0; i < payload_len; i++) {
-                    payload[i] ^= mask[i % 4];
+        }
+
+        if (client.queue.size() >= CLIENT_QUEUE_FRAMES) [[unlikely]] {
+            client.queue.erase(client.queue.begin() + first);
+            ++client.dropped;
+            frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        client.queue.push_back({frame, conflate_key});
+    }
+
+    // Writes queued frames until the queue empties or the socket would
+    // block; false on a write error.
+    bool flush(Client& client) {
+        while (!client.queue.empty()) {
+#ifdef _WIN32
+            const std::string& head = *client.queue.front().frame;
+            int sent = send(client.fd, head.data() + client.head_offset,
+                            static_cast<int>(head.size() - client.head_offset), 0);
+#else
+            iovec iov[MAX_WRITE_FRAMES];
+            size_t count = std::min(client.queue.size(), MAX_WRITE_FRAMES);
+            for (size_t i = 0; i < count; ++i) {
+                const std::string& frame = *client.queue[i].frame;
+                size_t offset = i == 0 ? client.head_offset : 0;
+                iov[i].iov_base = const_cast<char*>(frame.data() + offset);
+                iov[i].iov_len = frame.size() - offset;
+            }
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+#endif
+            if (sent < 0) {
+                if (would_block()) break;
+                return false;
+            }
+
+            size_t remaining = static_cast<size_t>(sent);
+            while (remaining > 0) {
+                size_t head_left = client.queue.front().frame->size() - client.head_offset;
+                if (remaining < head_left) {
+                    client.head_offset += remaining;
+                    break;
                 }
+                remaining -= head_left;
+                client.queue.pop_front();
+                client.head_offset = 0;
             }
-            
-            message.assign(payload.begin(), payload.end());
         }
-        
+
+        bool want_write = !client.queue.empty();
+        if (want_write != client.want_write) {
+            client.want_write = want_write;
+            watch(client);
+        }
         return true;
     }
-    
-    void handle_client(socket_t client) {
-        if (!perform_handshake(client)) {
-            CLOSE_SOCKET(client);
-            return;
+
+    // Hands queued broadcasts to the clients, then writes every client that
+    // has something queued. Runs once per loop iteration.
+    void drain_pending() {
+        std::deque<Outgoing> batch;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            batch.swap(pending_);
         }
-        
+        if (batch.empty()) return;
+
+        for (const Outgoing& out : batch) {
+            if (out.target != INVALID_SOCKET_VAL) {
+                auto it = clients_.find(out.target);
+                if (it != clients_.end() && it->second->open) {
+                    enqueue(*it->second, out.frame, out.conflate_key);
+                }
+                continue;
+            }
+            for (auto& [fd, client] : clients_) {
+                if (client->open) enqueue(*client, out.frame, out.conflate_key);
+            }
+        }
+
+        std::vector<socket_t> failed;
+        for (auto& [fd, client] : clients_) {
+            if (client->queue.empty() || client->want_write) continue;
+            if (!flush(*client)) failed.push_back(fd);
+        }
+        for (socket_t fd : failed) close_client(fd);
+    }
+
+    void post(Frame frame, socket_t target, uint8_t conflate_key) {
+        if (!running_.load(std::memory_order_relaxed)) return;
+
+        bool was_empty;
         {
-            std::lock_guard<std::mutex> lock(clients_mutex_);
-            clients_.insert(client);
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            was_empty = pending_.empty();
+            if (pending_.size() >= MAX_PENDING_FRAMES) [[unlikely]] {
+                pending_.pop_front();
+                frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            pending_.push_back({std::move(frame), target, conflate_key});
         }
-        
-        printf("[WS] Client connected (fd=%d)\n", (int)client);
-        
-        set_non_blocking(client);
-        
-        while (running_) {
+#ifdef __linux__
+        if (was_empty) {
+            uint64_t one = 1;
+            ssize_t n = write(wake_fd_, &one, sizeof(one));
+            (void)n;
+        }
+#else
+        (void)was_empty;
+#endif
+    }
+
+    void accept_pending(socket_t listen_socket) {
+        while (true) {
+            sockaddr_in client_addr;
+            socklen_t client_len = sizeof(client_addr);
+            socket_t fd = accept(listen_socket, (sockaddr*)&client_addr, &client_len);
+            if (fd == INVALID_SOCKET_VAL) return;
+
+            set_non_blocking(fd);
+            set_tcp_nodelay(fd);
+            auto client = std::make_unique<Client>();
+            client->fd = fd;
+            Client& ref = *client;
+            clients_[fd] = std::move(client);
+#ifdef __linux__
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.ptr = &ref;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+#else
+            (void)ref;
+#endif
+        }
+    }
+
+    void close_client(socket_t fd) {
+        auto it = clients_.find(fd);
+        if (it == clients_.end()) return;
+        Client& client = *it->second;
+
+#ifdef __linux__
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+        if (client.open) {
+            client_count_.fetch_sub(1, std::memory_order_relaxed);
+            if (client.dropped > 0) {
+                printf("[WS] Client disconnected (fd=%d, %llu frames dropped)\n",
+                       (int)fd, (unsigned long long)client.dropped);
+            } else {
+                printf("[WS] Client disconnected (fd=%d)\n", (int)fd);
+            }
+        }
+        CLOSE_SOCKET(fd);
+        clients_.erase(it);
+    }
+
+    void close_all_clients() {
+        Frame close_frame = encode_frame("", 0x08);
+        std::vector<socket_t> fds;
+        for (auto& [fd, client] : clients_) {
+            if (client->open) send_all(fd, *close_frame);
+            fds.push_back(fd);
+        }
+        for (socket_t fd : fds) close_client(fd);
+    }
+
+#ifdef __linux__
+    void watch(Client& client) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | (client.want_write ? uint32_t{EPOLLOUT} : 0u);
+        ev.data.ptr = &client;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client.fd, &ev);
+    }
+
+    void event_loop(socket_t listen_socket) {
+        epoll_fd_ = epoll_create1(0);
+        if (epoll_fd_ < 0) {
+            fprintf(stderr, "[WS] epoll_create1 failed\n");
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_socket, &ev);
+        ev.data.ptr = &wake_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+        epoll_event events[MAX_EVENTS];
+        while (running_.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, POLL_TIMEOUT_MS);
+            for (int i = 0; i < n; ++i) {
+                void* tag = events[i].data.ptr;
+                if (tag == nullptr) {
+                    accept_pending(listen_socket);
+                    continue;
+                }
+                if (tag == &wake_fd_) {
+                    uint64_t count;
+                    ssize_t r = read(wake_fd_, &count, sizeof(count));
+                    (void)r;
+                    continue;
+                }
+                Client& client = *static_cast<Client*>(tag);
+                bool ok = true;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    ok = read_available(client);
+                }
+                if (ok && (events[i].events & EPOLLOUT)) ok = flush(client);
+                if (!ok) close_client(client.fd);
+            }
+            drain_pending();
+        }
+
+        close_all_clients();
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+#else
+    void watch(Client&) {}
+
+    void event_loop(socket_t listen_socket) {
+        std::vector<socket_t> ready_read;
+        std::vector<socket_t> ready_write;
+        while (running_.load(std::memory_order_relaxed)) {
             fd_set read_fds;
+            fd_set write_fds;
             FD_ZERO(&read_fds);
-            FD_SET(client, &read_fds);
-            
-            struct timeval tv;
-            tv.tv_sec = 0;
-            tv.tv_usec = 100000;
-            
-            int result = select(client + 1, &read_fds, nullptr, nullptr, &tv);
-            
-            if (result > 0 && FD_ISSET(client, &read_fds)) {
-                std::string message;
-                if (!decode_frame(client, message)) {
-                    break;
+            FD_ZERO(&write_fds);
+            FD_SET(listen_socket, &read_fds);
+            socket_t max_fd = listen_socket;
+            for (auto& [fd, client] : clients_) {
+                FD_SET(fd, &read_fds);
+                if (client->want_write) FD_SET(fd, &write_fds);
+                if (fd > max_fd) max_fd = fd;
+            }
+
+            timeval tv{0, POLL_TIMEOUT_MS * 1000};
+            int ready = select(static_cast<int>(max_fd + 1), &read_fds, &write_fds, nullptr, &tv);
+            if (ready > 0) {
+                ready_read.clear();
+                ready_write.clear();
+                for (auto& [fd, client] : clients_) {
+                    if (FD_ISSET(fd, &read_fds)) ready_read.push_back(fd);
+                    if (FD_ISSET(fd, &write_fds)) ready_write.push_back(fd);
                 }
-                
-                if (on_message_ && !message.empty()) {
-                    on_message_(client, message);
+                for (socket_t fd : ready_read) {
+                    auto it = clients_.find(fd);
+                    if (it != clients_.end() && !read_available(*it->second)) close_client(fd);
+                }
+                for (socket_t fd : ready_write) {
+                    auto it = clients_.find(fd);
+                    if (it != clients_.end() && !flush(*it->second)) close_client(fd);
                 }
-            } else if (result < 0) {
-                break;
+                if (FD_ISSET(listen_socket, &read_fds)) accept_pending(listen_socket);
             }
+            drain_pending();
         }
-        
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex_);
-            clients_.erase(client);
-        }
-        
-        auto close_frame = encode_frame("", 0x08);
-        send(client, (const char*)close_frame.data(), close_frame.size(), 0);
-        
-        CLOSE_SOCKET(client);
-        printf("[WS] Client disconnected (fd=%d)\n", (int)client);
+
+        close_all_clients();
     }
-    
+#endif
+
     void server_loop() {
 #ifdef _WIN32
         WSADATA wsa_data;
         WSAStartup(MAKEWORD(2, 2), &wsa_data);
 #endif
-        
-        listen_socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        if (listen_socket_ == INVALID_SOCKET_VAL) {
+
+        socket_t listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listen_socket == INVALID_SOCKET_VAL) {
             fprintf(stderr, "[WS] Failed to create socket\n");
             return;
         }
-        
+
         int opt = 1;
-        setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
-        
+        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
         sockaddr_in addr;
         memset(&addr, 0, sizeof(addr));
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = INADDR_ANY;
         addr.sin_port = htons(port_);
-        
-        if (bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR_VAL) {
+
+        if (bind(listen_socket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR_VAL) {
             fprintf(stderr, "[WS] Failed to bind to port %d\n", port_);
-            CLOSE_SOCKET(listen_socket_);
+            CLOSE_SOCKET(listen_socket);
             return;
         }
-        
-        if (listen(listen_socket_, SOMAXCONN) == SOCKET_ERROR_VAL) {
+
+        if (listen(listen_socket, SOMAXCONN) == SOCKET_ERROR_VAL) {
             fprintf(stderr, "[WS] Failed to listen\n");
-            CLOSE_SOCKET(listen_socket_);
+            CLOSE_SOCKET(listen_socket);
             return;
         }
-        
+
+        set_non_blocking(listen_socket);
         printf("[WS] WebSocket server listening on port %d\n", port_);
-        
-        while (running_) {
-            fd_set read_fds;
-            FD_ZERO(&read_fds);
-            FD_SET(listen_socket_, &read_fds);
-            
-            struct timeval tv;
-            tv.tv_sec = 1;
-            tv.tv_usec = 0;
-            
-            int result = select(listen_socket_ + 1, &read_fds, nullptr, nullptr, &tv);
-            
-            if (result > 0 && FD_ISSET(listen_socket_, &read_fds)) {
-                sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                socket_t client = accept(listen_socket_, (sockaddr*)&client_addr, &client_len);
-                
-                if (client != INVALID_SOCKET_VAL) {
-                    set_tcp_nodelay(client);
-                    
-                    std::thread([this, client]() {
-                        this->handle_client(client);
-                    }).detach();
-                }
-            }
-        }
-        
-        CLOSE_SOCKET(listen_socket_);
-        
+
+        event_loop(listen_socket);
+
+        CLOSE_SOCKET(listen_socket);
+
 #ifdef _WIN32
         WSACleanup();
 #endif
     }
-    
+
 public:
     explicit TitanWebSocketServer(uint16_t port = 8080) : port_(port) {}
-    
+
     ~TitanWebSocketServer() {
         stop();
+#ifdef __linux__
+        if (wake_fd_ >= 0) close(wake_fd_);
+#endif
     }
-    
+
+    TitanWebSocketServer(const TitanWebSocketServer&) = delete;
+    TitanWebSocketServer& operator=(const TitanWebSocketServer&) = delete;
+
     void start() {
         if (running_) return;
-        
+
+#ifdef __linux__
+        if (wake_fd_ < 0) wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
         running_ = true;
         server_thread_ = std::thread(&TitanWebSocketServer::server_loop, this);
     }
-    
+
     void stop() {
         if (!running_) return;
-        
+
         running_ = false;
-        
-        {
-            std::lock_guard<std::mutex> lock(clients_mutex_);
-            for (socket_t client : clients_) {
-                CLOSE_SOCKET(client);
-            }
-            clients_.clear();
-        }
-        
         if (server_thread_.joinable()) {
             server_thread_.join();
         }
+
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.clear();
     }
-    
-    void broadcast(const std::string& message) {
-        auto frame = encode_frame(message);
-        
-        std::lock_guard<std::mutex> lock(clients_mutex_);
-        
-        std::vector<socket_t> to_remove;
-        
-        for (socket_t client : clients_) {
-            int sent = send(client, (const char*)frame.data(), frame.size(), 0);
-            if (sent <= 0) {
-                to_remove.push_back(client);
-            }
-        }
-        
-        for (socket_t client : to_remove) {
-            clients_.erase(client);
-            CLOSE_SOCKET(client);
-        }
+
+    // Safe from any thread. Frames sharing a non-zero conflation key (whole
+    // snapshots, say) supersede each other while still queued for a client;
+    // NO_CONFLATION frames are each delivered unless the queue overflows.
+    void broadcast(std::string_view message, uint8_t conflate_key = NO_CONFLATION) {
+        post(encode_frame(message), INVALID_SOCKET_VAL, conflate_key);
     }
-    
-    void send_to(socket_t client, const std::string& message) {
-        auto frame = encode_frame(message);
-        send(client, (const char*)frame.data(), frame.size(), 0);
+
+    // As broadcast(), but sent as a binary (opcode 0x2) frame.
+    void broadcast_binary(std::string_view data, uint8_t conflate_key = NO_CONFLATION) {
+        post(encode_frame(data, 0x02), INVALID_SOCKET_VAL, conflate_key);
     }
-    
+
+    void send_to(socket_t client, std::string_view message) {
+        post(encode_frame(message), client, NO_CONFLATION);
+    }
+
+    // Called on the server thread for every text or binary message.
     void set_message_callback(MessageCallback callback) {
         on_message_ = std::move(callback);
     }
-    
-    size_t client_count() const {
-        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(clients_mutex_));
-        return clients_.size();
-    }
-    
+
+    size_t client_count() const { return client_count_.load(std::memory_order_relaxed); }
+    uint64_t frames_dropped() const { return frames_dropped_.load(std::memory_order_relaxed); }
+
     bool is_running() const { return running_; }
     uint16_t get_port() const { return port_; }
 };
 
+// Writes JSON into a fixed inline buffer with std::to_chars, so a builder
+// kept across frames never allocates. Output that does not fit is dropped
+// and flagged; callers skip an overflowed frame rather than send it cut.
 class JsonBuilder {
-    std::ostringstream ss_;
+public:
+    static constexpr size_t CAPACITY = 32 * 1024;
+
+private:
+    char buffer_[CAPACITY];
+    size_t size_ = 0;
     bool first_ = true;
-    
+    bool overflowed_ = false;
+
+    void put(char c) {
+        if (size_ < CAPACITY) [[likely]] buffer_[size_++] = c;
+        else overflowed_ = true;
+    }
+
+    void put(std::string_view s) {
+        if (s.size() <= CAPACITY - size_) [[likely]] {
+            memcpy(buffer_ + size_, s.data(), s.size());
+            size_ += s.size();
+        } else {
+            overflowed_ = true;
+        }
+    }
+
+    template<typename... Args>
+    void put_number(Args... args) {
+        auto [end, ec] = std::to_chars(buffer_ + size_, buffer_ + CAPACITY, args...);
+        if (ec == std::errc()) [[likely]] size_ = end - buffer_;
+        else overflowed_ = true;
+    }
+
 public:
-    JsonBuilder& begin_object() { ss_ << "{"; first_ = true; return *this; }
-    JsonBuilder& end_object() { ss_ << "}"; return *this; }
-    JsonBuilder& begin_array() { ss_ << "["; first_ = true; return *this; }
-    JsonBuilder& end_array() { ss_ << "]"; return *this; }
-    
+    JsonBuilder& begin_object() { put('{'); first_ = true; return *this; }
+    // A closed container is a completed value, so whatever follows it needs
+    // a comma even when the container was empty.
+    JsonBuilder& end_object() { put('}'); first_ = false; return *this; }
+    JsonBuilder& begin_array() { put('['); first_ = true; return *this; }
+    JsonBuilder& end_array() { put(']'); first_ = false; return *this; }
+
     JsonBuilder& key(const char* k) {
-        if (!first_) ss_ << ",";
+        if (!first_) put(',');
         first_ = false;
-        ss_ << "\"" << k << "\":";
+        put('"');
+        put(std::string_view(k));
+        put("\":");
         return *this;
     }
-    
-    JsonBuilder& value(const char* v) { ss_ << "\"" << v << "\""; return *this; }
-    JsonBuilder& value(const std::string& v) { ss_ << "\"" << v << "\""; return *this; }
-    JsonBuilder& value(int64_t v) { ss_ << v; return *this; }
-    JsonBuilder& value(uint64_t v) { ss_ << v; return *this; }
-    JsonBuilder& value(double v) { ss_ << std::fixed << std::setprecision(2) << v; return *this; }
-    JsonBuilder& value(bool v) { ss_ << (v ? "true" : "false"); return *this; }
-    
+
+    JsonBuilder& value(const char* v) { put('"'); put(std::string_view(v)); put('"'); return *this; }
+    JsonBuilder& value(std::string_view v) { put('"'); put(v); put('"'); return *this; }
+    JsonBuilder& value(int64_t v) { put_number(v); return *this; }
+    JsonBuilder& value(uint64_t v) { put_number(v); return *this; }
+    JsonBuilder& value(double v) { put_number(v, std::chars_format::fixed, 2); return *this; }
+    JsonBuilder& value(bool v) { put(std::string_view(v ? "true" : "false")); return *this; }
+
     JsonBuilder& array_item() {
-        if (!first_) ss_ << ",";
+        if (!first_) put(',');
         first_ = false;
         return *this;
     }
-    
-    std::string str() const { return ss_.str(); }
-    void clear() { ss_.str(""); ss_.clear(); first_ = true; }
+
+    std::string_view view() const { return {buffer_, size_}; }
+    std::string str() const { return std::string(view()); }
+    bool overflowed() const { return overflowed_; }
+    void clear() { size_ = 0; first_ = true; overflowed_ = false; }
 };
 
 #endif
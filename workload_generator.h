@@ -0,0 +1,270 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "protocol.h"
+
+// Synthetic order flow for benchmark_harness. Each scenario produces an
+// in-memory capture in the same wire format as a .dat file, so it runs
+// through the same replay loop and can be written out for main.cpp's
+// REPLAY_MODE.
+//
+// Passive prices sit a Zipf-distributed number of ticks behind the touch
+// of a randomly drifting mid, which concentrates traffic near the top of
+// the book as real feeds do. Cancels and modifies target orders the
+// generator believes are live; ones that were filled in the meantime hit
+// the book as unknown ids, like late cancels on a real feed.
+
+enum class Scenario : uint8_t {
+    BALANCED,
+    DEEP_SWEEP,
+    ICEBERG_HEAVY,
+    AON_HEAVY,
+};
+
+inline const char* scenario_name(Scenario s) {
+    switch (s) {
+        case Scenario::BALANCED:      return "balanced";
+        case Scenario::DEEP_SWEEP:    return "sweep";
+        case Scenario::ICEBERG_HEAVY: return "iceberg";
+        case Scenario::AON_HEAVY:     return "aon";
+    }
+    return "unknown";
+}
+
+inline bool parse_scenario(const char* name, Scenario& out) {
+    for (Scenario s : {Scenario::BALANCED, Scenario::DEEP_SWEEP,
+                       Scenario::ICEBERG_HEAVY, Scenario::AON_HEAVY}) {
+        if (std::strcmp(name, scenario_name(s)) == 0) {
+            out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct WorkloadConfig {
+    Scenario scenario = Scenario::BALANCED;
+    uint64_t seed = 42;
+    size_t message_count = 2'000'000;
+
+    int64_t start_mid = 5'000'000;      // cents
+    int64_t half_spread = 1;            // ticks from mid to touch
+    uint32_t max_depth = 200;           // passive orders rest within this many ticks of touch
+    double zipf_exponent = 1.2;
+    double drift_prob = 0.002;          // chance per message that the mid moves one tick
+
+    // Message mix; whatever is left over after these becomes new orders.
+    double cancel_ratio = 0.40;
+    double modify_ratio = 0.10;
+    double aggress_ratio = 0.05;
+
+    // Share of new orders that are icebergs / all-or-none.
+    double iceberg_ratio = 0.0;
+    double aon_ratio = 0.0;
+
+    // Every sweep_interval messages, an IOC order sweeps sweep_depth ticks through the touch.
+    size_t sweep_interval = 0;
+    uint32_t sweep_depth = 0;
+
+    int64_t min_qty = 1;
+    int64_t max_qty = 100;
+    size_t max_live_orders = 200'000;
+    uint64_t ts_step_ns = 1000;
+
+    static WorkloadConfig preset(Scenario s) {
+        WorkloadConfig cfg;
+        cfg.scenario = s;
+        switch (s) {
+            case Scenario::BALANCED:
+                break;
+            case Scenario::DEEP_SWEEP:
+                cfg.aggress_ratio = 0.02;
+                cfg.sweep_interval = 500;
+                cfg.sweep_depth = 150;
+                break;
+            case Scenario::ICEBERG_HEAVY:
+                cfg.iceberg_ratio = 0.5;
+                cfg.aggress_ratio = 0.10;
+                break;
+            case Scenario::AON_HEAVY:
+                cfg.aon_ratio = 0.3;
+                cfg.aggress_ratio = 0.10;
+                break;
+        }
+        return cfg;
+    }
+};
+
+// Generated messages, contiguous and indexed like ReplayReader.
+class WorkloadCapture {
+    std::vector<uint8_t> bytes_;
+    std::vector<uint64_t> offsets_;
+
+public:
+    void reserve(size_t messages) {
+        offsets_.reserve(messages);
+        bytes_.reserve(messages * sizeof(MsgAddOrder));
+    }
+
+    template<typename Msg>
+    void append(const Msg& msg) {
+        offsets_.push_back(bytes_.size());
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&msg);
+        bytes_.insert(bytes_.end(), p, p + sizeof(Msg));
+    }
+
+    const uint8_t* data() const { return bytes_.data(); }
+    size_t size() const { return bytes_.size(); }
+    size_t message_count() const { return offsets_.size(); }
+    const MsgHeader* message(size_t i) const {
+        return reinterpret_cast<const MsgHeader*>(bytes_.data() + offsets_[i]);
+    }
+
+    bool write(const char* path) const {
+        FILE* file = std::fopen(path, "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(bytes_.data(), 1, bytes_.size(), file) == bytes_.size();
+        return std::fclose(file) == 0 && ok;
+    }
+};
+
+class WorkloadGenerator {
+    struct LiveOrder {
+        uint64_t order_id;
+        int64_t price;
+        bool is_buy;
+    };
+
+    WorkloadConfig cfg_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_{0.0, 1.0};
+    std::vector<double> zipf_cdf_;
+    std::vector<LiveOrder> live_;
+    int64_t mid_;
+    uint64_t next_order_id_ = 1;
+    uint64_t timestamp_ = 0;
+
+    uint32_t zipf_ticks() {
+        double u = unit_(rng_);
+        auto it = std::upper_bound(zipf_cdf_.begin(), zipf_cdf_.end(), u);
+        return static_cast<uint32_t>(std::min<size_t>(it - zipf_cdf_.begin(), zipf_cdf_.size() - 1));
+    }
+
+    int64_t random_qty() {
+        return std::uniform_int_distribution<int64_t>(cfg_.min_qty, cfg_.max_qty)(rng_);
+    }
+
+    uint64_t random_user() {
+        return std::uniform_int_distribution<uint64_t>(1, 1000)(rng_);
+    }
+
+    bool coin() { return (rng_() & 1) != 0; }
+
+    int64_t passive_price(bool is_buy, uint32_t ticks) const {
+        int64_t price = is_buy ? mid_ - cfg_.half_spread - ticks
+                               : mid_ + cfg_.half_spread + ticks;
+        return std::max<int64_t>(price, 1);
+    }
+
+    void drift() {
+        if (unit_(rng_) < cfg_.drift_prob) {
+            mid_ += coin() ? 1 : -1;
+            mid_ = std::max<int64_t>(mid_, cfg_.half_spread + cfg_.max_depth + 1);
+        }
+    }
+
+    void emit_add(WorkloadCapture& out) {
+        bool is_buy = coin();
+        int64_t price = passive_price(is_buy, zipf_ticks());
+        int64_t qty = random_qty();
+        uint64_t oid = next_order_id_++;
+        Side side = bool_to_side(is_buy);
+
+        double kind = unit_(rng_);
+        if (kind < cfg_.iceberg_ratio) {
+            out.append(MsgAddIceberg::create(timestamp_, oid, random_user(), side, price,
+                                             qty * 10, qty));
+        } else if (kind < cfg_.iceberg_ratio + cfg_.aon_ratio) {
+            out.append(MsgAddAON::create(timestamp_, oid, random_user(), side, price, qty));
+        } else {
+            out.append(MsgAddOrder::create(timestamp_, oid, random_user(), side, price, qty));
+        }
+
+        if (live_.size() < cfg_.max_live_orders) {
+            live_.push_back({oid, price, is_buy});
+        } else {
+            live_[rng_() % live_.size()] = {oid, price, is_buy};
+        }
+    }
+
+    void emit_cancel(WorkloadCapture& out) {
+        size_t i = rng_() % live_.size();
+        out.append(MsgCancel::create(timestamp_, live_[i].order_id));
+        live_[i] = live_.back();
+        live_.pop_back();
+    }
+
+    void emit_modify(WorkloadCapture& out) {
+        LiveOrder& order = live_[rng_() % live_.size()];
+        if (coin()) order.price = passive_price(order.is_buy, zipf_ticks());
+        out.append(MsgModify::create(timestamp_, order.order_id, order.price, random_qty()));
+    }
+
+    void emit_aggress(WorkloadCapture& out, uint32_t through_ticks, int64_t qty) {
+        bool is_buy = coin();
+        int64_t price = is_buy ? mid_ + cfg_.half_spread + through_ticks
+                               : std::max<int64_t>(mid_ - cfg_.half_spread - through_ticks, 1);
+        out.append(MsgExecute::create(timestamp_, next_order_id_++, random_user(),
+                                      bool_to_side(is_buy), price, qty, TIF::IOC));
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& cfg)
+        : cfg_(cfg), rng_(cfg.seed), mid_(cfg.start_mid) {
+        zipf_cdf_.resize(std::max<uint32_t>(cfg_.max_depth, 1));
+        double sum = 0.0;
+        for (size_t k = 0; k < zipf_cdf_.size(); ++k) {
+            sum += 1.0 / std::pow(static_cast<double>(k + 1), cfg_.zipf_exponent);
+            zipf_cdf_[k] = sum;
+        }
+        for (double& c : zipf_cdf_) c /= sum;
+        live_.reserve(cfg_.max_live_orders);
+    }
+
+    WorkloadCapture generate() {
+        WorkloadCapture out;
+        out.reserve(cfg_.message_count);
+
+        for (size_t i = 0; i < cfg_.message_count; ++i) {
+            timestamp_ += cfg_.ts_step_ns;
+            drift();
+
+            if (cfg_.sweep_interval && i % cfg_.sweep_interval == cfg_.sweep_interval - 1) {
+                emit_aggress(out, cfg_.sweep_depth, cfg_.max_qty * cfg_.sweep_depth);
+                continue;
+            }
+
+            double r = unit_(rng_);
+            if (!live_.empty() && r < cfg_.cancel_ratio) {
+                emit_cancel(out);
+            } else if (!live_.empty() && r < cfg_.cancel_ratio + cfg_.modify_ratio) {
+                emit_modify(out);
+            } else if (r < cfg_.cancel_ratio + cfg_.modify_ratio + cfg_.aggress_ratio) {
+                emit_aggress(out, zipf_ticks() % 4, random_qty());
+            } else {
+                emit_add(out);
+            }
+        }
+        return out;
+    }
+};
+
+#endif